@@ -7,6 +7,8 @@
 #include "utils/Util.hpp"
 #include "Frontend.hpp"
 #include "network/HTTPClient.hpp"
+#include "network/HTTPCache.hpp"
+#include "state/MessageStore.hpp"
 #include "config/DiscordClientConfig.hpp"
 
 #define DISCORD_WSS_DETAILS "?encoding=json&v=" DISCORD_API_VERSION
@@ -75,6 +77,7 @@ void DiscordInstance::OnFetchedChannels(Guild* pGld, const std::string& content)
 {
 	Json j = Json::parse(content);
 
+	m_entityDirectory.RemoveChannels(pGld);
 	pGld->m_channels.clear();
 
 	Snowflake chan = 0;
@@ -91,6 +94,7 @@ void DiscordInstance::OnFetchedChannels(Guild* pGld, const std::string& content)
 	pGld->m_channels.sort();
 	pGld->m_bChannelsLoaded = true;
 	pGld->m_currentChannel = chan;
+	m_entityDirectory.AddChannels(pGld);
 
 	GetFrontend()->UpdateSelectedGuild();
 }
@@ -198,34 +202,49 @@ void DiscordInstance::RequestPinnedMessages(Snowflake channel)
 
 void DiscordInstance::RequestGuildMembers(Snowflake guild, std::set<Snowflake> members, bool bLoadPresences)
 {
-	Json data;
-	Json guildIdArray, userIdsArray;
-	guildIdArray.push_back(guild);
+	m_memberRequestTracker.ExpireStale();
 
-	int i = 0;
+	// Skip the members that were already requested.
+	std::vector<Snowflake> users;
 	for (auto mem : members) {
-		if (mem != 0)
-			userIdsArray.push_back(std::to_string(mem));
+		if (mem != 0 && !m_memberRequestTracker.IsPending(guild, mem))
+			users.push_back(mem);
 	}
 
-	if (userIdsArray.empty())
-		return;
+	for (size_t i = 0; i < users.size(); i += C_MAX_MEMBER_REQUEST_USERS)
+	{
+		size_t end = std::min(users.size(), i + C_MAX_MEMBER_REQUEST_USERS);
+		std::vector<Snowflake> batch(users.begin() + i, users.begin() + end);
 
-	data["guild_id"] = guildIdArray;
-	data["user_ids"] = userIdsArray;
-	data["presences"] = bLoadPresences;
-	data["limit"] = nullptr;
-	data["query"] = nullptr;
+		Json data;
+		Json guildIdArray, userIdsArray;
+		guildIdArray.push_back(guild);
 
-	Json j;
-	j["op"] = int(GatewayOp::REQUEST_GUILD_MEMBERS);
-	j["d"] = data;
+		for (auto mem : batch)
+			userIdsArray.push_back(std::to_string(mem));
 
-	GetWebsocketClient()->SendMsg(m_gatewayConnId, j.dump());
+		data["guild_id"] = guildIdArray;
+		data["user_ids"] = userIdsArray;
+		data["presences"] = bLoadPresences;
+		data["limit"] = nullptr;
+		data["query"] = nullptr;
+		data["nonce"] = m_memberRequestTracker.AddRequest(guild, batch);
+
+		Json j;
+		j["op"] = int(GatewayOp::REQUEST_GUILD_MEMBERS);
+		j["d"] = data;
+
+		GetWebsocketClient()->SendMsg(m_gatewayConnId, j.dump());
+	}
 }
 
 void DiscordInstance::RequestGuildMembers(Snowflake guild, std::string query, bool bLoadPresences, int limit)
 {
+	m_memberRequestTracker.ExpireStale();
+
+	if (m_memberRequestTracker.IsQueryPending(guild, query))
+		return;
+
 	Json guildIdArray;
 	guildIdArray.push_back(guild);
 
@@ -235,6 +254,7 @@ void DiscordInstance::RequestGuildMembers(Snowflake guild, std::string query, bo
 	data["user_ids"] = nullptr;
 	data["guild_id"] = guildIdArray;
 	data["presences"] = bLoadPresences;
+	data["nonce"] = m_memberRequestTracker.AddQuery(guild, query);
 
 	Json j;
 	j["op"] = int(GatewayOp::REQUEST_GUILD_MEMBERS);
@@ -261,14 +281,9 @@ bool DiscordInstance::IsChannelMuted(Snowflake guildID, Snowflake channelID) con
 
 std::string DiscordInstance::LookupChannelNameGlobally(Snowflake sf)
 {
-	for (auto& gld : m_guilds)
-	{
-		for (auto& chan : gld.m_channels)
-		{
-			if (chan.m_snowflake == sf)
-				return chan.m_name;
-		}
-	}
+	Channel* pChan = m_entityDirectory.GetChannel(sf);
+	if (pChan)
+		return pChan->m_name;
 
 #ifdef _DEBUG
 	return "!! " + std::to_string(sf);
@@ -279,29 +294,19 @@ std::string DiscordInstance::LookupChannelNameGlobally(Snowflake sf)
 
 std::string DiscordInstance::LookupRoleName(Snowflake sf, Snowflake guildID)
 {
-	Guild* pGld = GetGuild(guildID);
-	if (pGld)
-	{
-		for (const auto& role : pGld->m_roles)
-		{
-			if (role.first == sf)
-				return role.second.m_name;
-		}
-	}
+	Guild* pGld = nullptr;
+	GuildRole* pRole = m_entityDirectory.GetRole(sf, &pGld);
+	if (pRole && pGld->m_snowflake == guildID)
+		return pRole->m_name;
 
 	return "deleted-role-" + std::to_string(sf);
 }
 
 std::string DiscordInstance::LookupRoleNameGlobally(Snowflake sf)
 {
-	for (const auto& gld : m_guilds)
-	{
-		for (const auto& role : gld.m_roles)
-		{
-			if (role.first == sf)
-				return role.second.m_name;
-		}
-	}
+	GuildRole* pRole = m_entityDirectory.GetRole(sf);
+	if (pRole)
+		return pRole->m_name;
 
 	return "deleted-role-" + std::to_string(sf);
 }
@@ -484,8 +489,28 @@ void DiscordInstance::OnSelectGuild(Snowflake sf, Snowflake chan)
 
 void OnUpdateAvatar(const std::string& resid);
 
+// Gets how long a rate limited request asks to wait before trying again.
+static uint64_t GetRetryAfterMs(const std::string& response)
+{
+	uint64_t retryAfterMs = 1000;
+	try
+	{
+		Json j = Json::parse(response);
+		if (j.contains("retry_after") && j["retry_after"].is_number())
+			retryAfterMs = uint64_t(double(j["retry_after"]) * 1000.0);
+	}
+	catch (Json::exception&)
+	{
+	}
+
+	return retryAfterMs;
+}
+
 void DiscordInstance::HandleRequest(NetRequest* pRequest)
 {
+	GetProfileCache()->TrimIfNeeded();
+	m_profileFetchScheduler.Pump();
+
 	if (pRequest->itype == DiscordRequest::UPLOAD_ATTACHMENT) {
 		OnUploadAttachmentFirst(pRequest);
 		return;
@@ -498,6 +523,16 @@ void DiscordInstance::HandleRequest(NetRequest* pRequest)
 
 	using namespace DiscordRequest;
 
+	if (pRequest->itype == PROFILE)
+	{
+		if (pRequest->result == HTTP_TOOMANYREQS) {
+			m_profileFetchScheduler.OnRateLimited(pRequest->key, GetRetryAfterMs(pRequest->response));
+			return;
+		}
+
+		m_profileFetchScheduler.OnRequestDone(pRequest->key);
+	}
+
 	// if we didn't get a 200, authentication is invalid and we should exit.
 	std::string str;
 	bool bExitAfterError = false, bShowMessageBox = false, bSendLoggedOutMessage = false, bJustExitMate = false;
@@ -556,15 +591,15 @@ void DiscordInstance::HandleRequest(NetRequest* pRequest)
 
 					GetFrontend()->OnFailedToSendMessage(m_CurrentChannel, nonce);
 
-					Message msg;
-					msg.m_type = MessageType::DEFAULT;
-					msg.m_snowflake = nonce + 1;
-					msg.m_author_snowflake = 1; // *1
-					msg.m_author = "Clyde";
-					msg.m_message = "Your message could not be delivered. This is usually because you don't share a server "
+					MessagePtr msg = MakeMessage();
+					msg->m_type = MessageType::DEFAULT;
+					msg->m_snowflake = nonce + 1;
+					msg->m_author_snowflake = 1; // *1
+					msg->m_author = "Clyde";
+					msg->m_message = "Your message could not be delivered. This is usually because you don't share a server "
 						"with the recipient or the recipient is only accepting direct messages from friends. You can see th"
 						"e full list of reasons here: https://support.discord.com/hc/en-us/articles/360060145013";
-					msg.SetTime(time(NULL));
+					msg->SetTime(time(NULL));
 
 					// *1 - I checked, the official Discord client also does that :)
 					GetFrontend()->OnAddMessage(m_CurrentChannel, msg);
@@ -735,7 +770,7 @@ void DiscordInstance::HandleRequest(NetRequest* pRequest)
 			case GUILDS:
 			{
 				// reload guild DB
-				m_guilds.clear();
+				ClearGuilds();
 				
 				for (auto& elem : j)
 					ParseAndAddGuild(elem);
@@ -1215,6 +1250,9 @@ void DiscordInstance::HandleGatewayMessage(const std::string& payload)
 {
 	DbgPrintF("Got Payload: %s [PAYLOAD ENDS HERE]", payload.c_str());
 
+	GetProfileCache()->TrimIfNeeded();
+	m_profileFetchScheduler.Pump();
+
 	Json j = Json::parse(payload);
 
 	int op = j["op"];
@@ -1434,6 +1472,46 @@ void DiscordInstance::Typing()
 	);
 }
 
+size_t DiscordInstance::SearchMessages(const SearchQuery& query, std::vector<SearchResult>& results)
+{
+	SearchIndex* pIndex = GetSearchIndex();
+
+	// Make sure the persisted messages in scope are indexed too.  Wider
+	// searches only read the stores that are open already, instead of opening
+	// every channel's.
+	if (query.m_channel)
+	{
+		Channel* pChan = GetChannelGlobally(query.m_channel);
+		pIndex->AddStoredChannel(query.m_channel, pChan ? pChan->m_parentGuild : query.m_guild);
+	}
+	else
+	{
+		std::vector<Guild*> guilds;
+		if (query.m_guild) {
+			Guild* pGld = GetGuild(query.m_guild);
+			if (pGld)
+				guilds.push_back(pGld);
+		}
+		else {
+			guilds.push_back(&m_dmGuild);
+			for (auto& gld : m_guilds)
+				guilds.push_back(&gld);
+		}
+
+		MessageStore* pStore = GetMessageStore();
+		for (Guild* pGld : guilds)
+		{
+			for (auto& chan : pGld->m_channels)
+			{
+				if (pStore->IsOpen(chan.m_snowflake))
+					pIndex->AddStoredChannel(chan.m_snowflake, pGld->m_snowflake);
+			}
+		}
+	}
+
+	return pIndex->Search(query, results);
+}
+
 void DiscordInstance::RequestAcknowledgeMessages(Snowflake channel, Snowflake message, bool manual)
 {
 	Channel* pChan = GetChannelGlobally(channel);
@@ -1545,6 +1623,8 @@ void DiscordInstance::RequestPinMessage(Snowflake chan, Snowflake msg)
 {
 	std::string url = GetDiscordAPI() + "channels/" + std::to_string(chan) + "/messages/pins/" + std::to_string(msg);
 
+	GetHTTPCache()->Invalidate(GetDiscordAPI() + "channels/" + std::to_string(chan) + "/pins", m_token);
+
 	GetHTTPClient()->PerformRequest(
 		true,
 		NetRequest::PUT,
@@ -1560,6 +1640,8 @@ void DiscordInstance::RequestUnpinMessage(Snowflake chan, Snowflake msg)
 {
 	std::string url = GetDiscordAPI() + "channels/" + std::to_string(chan) + "/messages/pins/" + std::to_string(msg);
 
+	GetHTTPCache()->Invalidate(GetDiscordAPI() + "channels/" + std::to_string(chan) + "/pins", m_token);
+
 	GetHTTPClient()->PerformRequest(
 		true,
 		NetRequest::DELETE_,
@@ -1571,7 +1653,7 @@ void DiscordInstance::RequestUnpinMessage(Snowflake chan, Snowflake msg)
 	);
 }
 
-void DiscordInstance::UpdateSubscriptions(Snowflake guildId, Snowflake channelId, bool typing, bool activities, bool threads, int rangeMembers)
+void DiscordInstance::UpdateSubscriptions(Snowflake guildId, Snowflake channelId, bool typing, bool activities, bool threads)
 {
 	Json j, data;
 
@@ -1586,12 +1668,24 @@ void DiscordInstance::UpdateSubscriptions(Snowflake guildId, Snowflake channelId
 	{
 		j["op"] = GatewayOp::SUBSCRIBE_GUILD;
 
-		Json subs, guild, channels, rangeParent, rangeChildren[1];
+		Json subs, guild, channels, rangeParent = Json::array();
 
-		// Amount of users loaded
-		int arr[2] = { 0, rangeMembers };
-		rangeChildren[0] = arr;
-		rangeParent = rangeChildren;
+		// Each channel has its own member list, so start over at the top of it.
+		if (m_memberListSubscriptions.SetChannel(guildId, channelId))
+		{
+			Guild* pGuild = GetGuild(guildId);
+			if (pGuild) {
+				pGuild->m_members.Clear();
+				GetFrontend()->UpdateMemberList(guildId, 0, 0, true);
+			}
+		}
+
+		// Ranges of the member list loaded
+		for (auto& range : m_memberListSubscriptions.GetRanges())
+		{
+			int arr[2] = { range.first, range.second };
+			rangeParent.push_back(arr);
+		}
 
 		if (channelId != 0)
 			channels[std::to_string(channelId)] = rangeParent;
@@ -1614,6 +1708,17 @@ void DiscordInstance::UpdateSubscriptions(Snowflake guildId, Snowflake channelId
 	GetWebsocketClient()->SendMsg(m_gatewayConnId, j.dump());
 }
 
+void DiscordInstance::UpdateMemberListViewport(Snowflake guild, size_t first, size_t last)
+{
+	if (guild != m_CurrentGuild || !guild)
+		return;
+
+	if (!m_memberListSubscriptions.SetVisibleRange(guild, m_CurrentChannel, first, last))
+		return;
+
+	UpdateSubscriptions(guild, m_CurrentChannel, false, false, false);
+}
+
 void DiscordInstance::RequestLeaveGuild(Snowflake guild)
 {
 	Json j;
@@ -1695,6 +1800,11 @@ void DiscordInstance::ClearData()
 {
 	CloseGatewaySession();
 
+	m_entityDirectory.Clear();
+	m_permissionCache.Clear();
+	m_profileFetchScheduler.Clear();
+	m_memberRequestTracker.Clear();
+	m_memberListSubscriptions.Clear();
 	m_guilds.clear();
 	m_dmGuild.m_channels.clear();
 	m_messageRequestsInProgress.clear();
@@ -1925,6 +2035,7 @@ void DiscordInstance::ParsePermissionOverwrites(Channel& channel, nlohmann::json
 		return;
 
 	channel.m_overwrites.clear();
+	channel.InvalidateRoleOverwrites();
 	for (auto& po : pos)
 	{
 		Overwrite ow;
@@ -2262,6 +2373,8 @@ void DiscordInstance::ParseAndAddGuild(nlohmann::json& elem)
 		g.m_roles[role.m_id] = role;
 	}
 
+	g.RebuildRoleSlots();
+
 	// parse emoji
 	Json& emojis = elem["emojis"];
 	for (auto& emojij : emojis)
@@ -2274,15 +2387,28 @@ void DiscordInstance::ParseAndAddGuild(nlohmann::json& elem)
 	// Check if the guild already exists.  If it does, replace its contents.
 	// I'm not totally sure why discord sends a GUILD_CREATE event.  Perhaps
 	// the server I was testing with is considered a "lazy guild"?
-	for (auto& gld : m_guilds)
+	Guild* pOldGuild = GetGuild(g.m_snowflake);
+	if (pOldGuild)
 	{
-		if (gld.m_snowflake == g.m_snowflake) {
-			gld = g;
-			return;
-		}
+		m_entityDirectory.RemoveGuild(pOldGuild);
+		*pOldGuild = g;
+		m_entityDirectory.AddGuild(pOldGuild);
+		m_permissionCache.InvalidateGuild(pOldGuild);
+		return;
 	}
 
 	m_guilds.push_front(g);
+	m_entityDirectory.AddGuild(&m_guilds.front());
+	m_permissionCache.InvalidateGuild(&m_guilds.front());
+}
+
+void DiscordInstance::ClearGuilds()
+{
+	for (auto& gld : m_guilds)
+		m_entityDirectory.RemoveGuild(&gld);
+
+	m_guilds.clear();
+	m_permissionCache.Clear();
 }
 
 // DISPATCH FUNCTIONS
@@ -2303,9 +2429,14 @@ void DiscordInstance::InitDispatchFunctions()
 	DECL(USER_NOTE_UPDATE);
 	DECL(GUILD_CREATE);
 	DECL(GUILD_DELETE);
+	DECL(GUILD_UPDATE);
+	DECL(GUILD_ROLE_CREATE);
+	DECL(GUILD_ROLE_UPDATE);
+	DECL(GUILD_ROLE_DELETE);
 	DECL(CHANNEL_CREATE);
 	DECL(CHANNEL_DELETE);
 	DECL(CHANNEL_UPDATE);
+	DECL(CHANNEL_PINS_UPDATE);
 	DECL(GUILD_MEMBER_LIST_UPDATE);
 	DECL(GUILD_MEMBERS_CHUNK);
 	DECL(TYPING_START);
@@ -2419,13 +2550,14 @@ void DiscordInstance::HandleREADY(Json& j)
 	Profile* pf = GetProfile();
 
 	m_dmGuild.m_ownerId = pf->m_snowflake;
+	m_permissionCache.InvalidateGuild(&m_dmGuild);
 
 	// ==== load user settings
 	LoadUserSettings(data["user_settings_proto"]);
 
 	// ==== reload guild DB
 	Json& guilds = data["guilds"];
-	m_guilds.clear();
+	ClearGuilds();
 
 	std::vector<Snowflake> guildIds; // used by merged members
 	for (auto& elem : guilds) {
@@ -2475,16 +2607,21 @@ void DiscordInstance::HandleREADY(Json& j)
 			for (auto& memesub : meme)
 			{
 				Snowflake sf = GetSnowflake(memesub, "user_id");
-				GuildMember& gm = pf->m_guildMembers[guildIds[idx]];
-				gm.m_nick = GetFieldSafe(memesub, "nick");
-				gm.m_avatar = GetFieldSafe(memesub, "avatar");
+				GuildMember gm = GetProfileCache()->LookupGuildMember(pf->m_snowflake, guildIds[idx]);
+				gm.SetNick(GetFieldSafe(memesub, "nick"));
+				gm.SetAvatar(GetFieldSafe(memesub, "avatar"));
 
 				// add all roles
-				gm.m_roles.clear();
+				SmallSnowflakeSet roles;
 				for (auto& role : memesub["roles"]) {
 					Snowflake roleid = GetSnowflakeFromJsonObject(role);
-					gm.m_roles.push_back(roleid);
+					roles.insert(roleid);
 				}
+				gm.SetRoles(std::move(roles));
+
+				Guild* pGld = GetGuild(guildIds[idx]);
+				if (pGld)
+					m_permissionCache.InvalidateMember(pGld, pf->m_snowflake);
 			}
 		}
 	}
@@ -2495,6 +2632,7 @@ void DiscordInstance::HandleREADY(Json& j)
 		auto& chans = data["private_channels"];
 		
 		Guild* pGld = &m_dmGuild;
+		m_entityDirectory.RemoveChannels(pGld);
 		pGld->m_channels.clear();
 
 		Snowflake chan = 0;
@@ -2511,6 +2649,7 @@ void DiscordInstance::HandleREADY(Json& j)
 		pGld->m_channels.sort();
 		pGld->m_bChannelsLoaded = true;
 		pGld->m_currentChannel = chan;
+		m_entityDirectory.AddChannels(pGld);
 	}
 
 	// ==== load read_state
@@ -2596,17 +2735,23 @@ void DiscordInstance::HandleMessageInsertOrUpdate(Json& j, bool bIsUpdate)
 	if (!pChan)
 		return;
 
-	Message msg;
+	// N.B. Before the message is parsed, parsing adds empty fields to it.
+	GetMessageCache()->StoreMessage(channelId, data, bIsUpdate);
 
+	// Messages in the cache are never changed in place, as the cache still
+	// needs the old version to replace it.  Updates are applied to a copy,
+	// which is cheap since the strings and extras are shared.
+	MessagePtr msg;
 	MessagePtr pOldMsg = GetMessageCache()->GetLoadedMessage(channelId, messageId);
 	if (pOldMsg)
 	{
-		msg = *pOldMsg; // copy it asap
+		msg = MakeMessage(*pOldMsg);
 		pOldMsg = NULL;
 	}
 	else if (bIsUpdate) return;
+	else msg = MakeMessage();
 
-	msg.Load(data, guildId);
+	msg->Load(data, guildId);
 
 	Snowflake oldSentMsg = pChan->m_lastSentMsg;
 	pChan->m_lastSentMsg = std::max(pChan->m_lastSentMsg, messageId);
@@ -2637,7 +2782,7 @@ void DiscordInstance::HandleMessageInsertOrUpdate(Json& j, bool bIsUpdate)
 				isNonMutedDM = true;
 		}
 
-		if ((isNonMutedDM || msg.CheckWasMentioned(m_mySnowflake, guildId, suppEveryone, suppRoles)) && m_CurrentChannel != channelId)
+		if ((isNonMutedDM || msg->CheckWasMentioned(m_mySnowflake, guildId, suppEveryone, suppRoles)) && m_CurrentChannel != channelId)
 			pChan->m_mentionCount++;
 	}
 
@@ -2709,6 +2854,8 @@ void DiscordInstance::HandleUSER_NOTE_UPDATE(nlohmann::json& j)
 	Snowflake uid = GetSnowflake(data, "id");
 	std::string note = GetFieldSafe(data, "note");
 
+	GetHTTPCache()->Invalidate(GetDiscordAPI() + "users/@me/notes/" + std::to_string(uid), m_token);
+
 	Profile* pf = GetProfileCache()->LookupProfile(uid, "", "", "", false);
 	if (!pf) return;
 
@@ -2739,6 +2886,8 @@ void DiscordInstance::HandleGUILD_CREATE(Json& j)
 	Guild* guild = GetGuild(guildID);
 	if (guild)
 	{
+		GetHTTPCache()->Invalidate(guild->GetChannelsUrl(), m_token);
+
 		if (!m_guildItemList.ContainsGuild(guildID))
 			m_guildItemList.AddGuild(0, guildID, guild->m_name, guild->m_avatarlnk);
 	}
@@ -2757,6 +2906,7 @@ void DiscordInstance::HandleGUILD_DELETE(Json& j)
 	{
 		if (iter->m_snowflake == sf)
 		{
+			m_entityDirectory.RemoveGuild(&*iter);
 			m_guilds.erase(iter);
 			m_guildItemList.EraseGuild(sf);
 			GetFrontend()->RepaintGuildList();
@@ -2773,6 +2923,77 @@ void DiscordInstance::HandleGUILD_DELETE(Json& j)
 	}
 }
 
+void DiscordInstance::HandleGUILD_UPDATE(Json& j)
+{
+	Json& data = j["d"];
+	Snowflake guildId = GetSnowflake(data, "id");
+
+	Guild* pGuild = GetGuild(guildId);
+	if (!pGuild)
+		return;
+
+	// N.B. Only the owner is taken from here for now.
+	Snowflake ownerId = GetSnowflake(data, "owner_id");
+	if (ownerId && pGuild->m_ownerId != ownerId)
+	{
+		pGuild->m_ownerId = ownerId;
+		m_permissionCache.InvalidateGuild(pGuild);
+
+		if (m_CurrentGuild == guildId)
+			GetFrontend()->UpdateChannelList();
+	}
+}
+
+void DiscordInstance::HandleGUILD_ROLE_CREATE(Json& j)
+{
+	Json& data = j["d"];
+	Snowflake guildId = GetSnowflake(data, "guild_id");
+
+	Guild* pGuild = GetGuild(guildId);
+	if (!pGuild || !data.contains("role"))
+		return;
+
+	GuildRole role;
+	role.Load(data["role"]);
+
+	GuildRole& newRole = pGuild->m_roles[role.m_id];
+	newRole = role;
+	m_entityDirectory.AddRole(pGuild, &newRole);
+	pGuild->RebuildRoleSlots();
+	m_permissionCache.InvalidateGuild(pGuild);
+
+	if (m_CurrentGuild == guildId)
+		GetFrontend()->UpdateChannelList();
+}
+
+void DiscordInstance::HandleGUILD_ROLE_UPDATE(Json& j)
+{
+	HandleGUILD_ROLE_CREATE(j);
+}
+
+void DiscordInstance::HandleGUILD_ROLE_DELETE(Json& j)
+{
+	Json& data = j["d"];
+	Snowflake guildId = GetSnowflake(data, "guild_id");
+	Snowflake roleId = GetSnowflake(data, "role_id");
+
+	Guild* pGuild = GetGuild(guildId);
+	if (!pGuild)
+		return;
+
+	auto iter = pGuild->m_roles.find(roleId);
+	if (iter == pGuild->m_roles.end())
+		return;
+
+	m_entityDirectory.RemoveRole(roleId);
+	pGuild->m_roles.erase(iter);
+	pGuild->RebuildRoleSlots();
+	m_permissionCache.InvalidateGuild(pGuild);
+
+	if (m_CurrentGuild == guildId)
+		GetFrontend()->UpdateChannelList();
+}
+
 void DiscordInstance::HandleCHANNEL_CREATE(Json& j)
 {
 	Json& data = j["d"];
@@ -2782,12 +3003,15 @@ void DiscordInstance::HandleCHANNEL_CREATE(Json& j)
 	if (!pGuild)
 		return;
 
+	GetHTTPCache()->Invalidate(pGuild->GetChannelsUrl(), m_token);
+
 	int ord = 0;
 	Channel chn;
 	ParseChannel(chn, data, ord);
 
 	chn.m_parentGuild = pGuild->m_snowflake;
 	pGuild->m_channels.push_back(chn);
+	m_entityDirectory.AddChannel(pGuild, &pGuild->m_channels.back());
 	pGuild->m_channels.sort();
 
 	if (m_CurrentGuild == guildId)
@@ -2804,17 +3028,22 @@ void DiscordInstance::HandleCHANNEL_UPDATE(Json& j)
 	if (!pGuild)
 		return;
 
+	GetHTTPCache()->Invalidate(pGuild->GetChannelsUrl(), m_token);
+
 	Channel* pChan = pGuild->GetChannel(channelId);
 	if (!pChan)
 		return;
 
 	int position = pChan->m_pos;
 	Snowflake oldCategory = pChan->m_parentCateg;
-	uint64_t oldPerms = pChan->ComputePermissionOverwrites(m_mySnowflake, pGuild->ComputeBasePermissions(m_mySnowflake));
+	uint64_t oldPerms = m_permissionCache.GetCurrentUserPermissions(pGuild, pChan);
 
 	int ord = 0;
 	ParseChannel(*pChan, data, ord);
 
+	// The permission overwrites may have changed.
+	m_permissionCache.InvalidateChannel(pChan);
+
 	// If the position, permissions, or parent category changed, refresh the channel.
 	bool modifiedOrder = position != pChan->m_pos || oldCategory != pChan->m_parentCateg;
 
@@ -2822,7 +3051,7 @@ void DiscordInstance::HandleCHANNEL_UPDATE(Json& j)
 		pGuild->m_channels.sort();
 	}
 
-	if (modifiedOrder || oldPerms != pChan->ComputePermissionOverwrites(m_mySnowflake, pGuild->ComputeBasePermissions(m_mySnowflake))) {
+	if (modifiedOrder || oldPerms != m_permissionCache.GetCurrentUserPermissions(pGuild, pChan)) {
 		GetFrontend()->UpdateChannelList();
 	}
 }
@@ -2837,11 +3066,14 @@ void DiscordInstance::HandleCHANNEL_DELETE(Json& j)
 	if (!pGuild)
 		return;
 
+	GetHTTPCache()->Invalidate(pGuild->GetChannelsUrl(), m_token);
+
 	for (auto iter = pGuild->m_channels.begin();
 		iter != pGuild->m_channels.end();
 		++iter)
 	{
 		if (iter->m_snowflake == channelId) {
+			m_entityDirectory.RemoveChannel(channelId);
 			pGuild->m_channels.erase(iter);
 			break;
 		}
@@ -2854,6 +3086,15 @@ void DiscordInstance::HandleCHANNEL_DELETE(Json& j)
 		GetFrontend()->UpdateChannelList();
 }
 
+void DiscordInstance::HandleCHANNEL_PINS_UPDATE(Json& j)
+{
+	Json& data = j["d"];
+	Snowflake channelId = GetSnowflake(data, "channel_id");
+
+	// The pins will be fetched again next time the pins list is opened.
+	GetHTTPCache()->Invalidate(GetDiscordAPI() + "channels/" + std::to_string(channelId) + "/pins", m_token);
+}
+
 static Snowflake GetGroupId(std::string idStr)
 {
 	/**/ if (idStr == "online")  return GROUP_ONLINE;
@@ -2870,56 +3111,130 @@ void DiscordInstance::HandleGUILD_MEMBER_LIST_UPDATE(Json& j)
 	if (!pGld)
 		return;
 
+	MemberListChange change;
+	change.m_guild = guildId;
+	bool bKnowSize = data.contains("groups");
+	size_t listSize = 0;
 	for (auto& op : data["groups"])
 	{
 		Snowflake groupId = GetGroupId(GetFieldSafe(op, "id"));
 		int count = GetFieldSafeInt(op, "count");
 
-		GuildMember* pGroupMember = pGld->GetGuildMember(groupId);
-		pGroupMember->m_groupCount = count;
+		// The header, and the members under it.
+		listSize += 1 + std::max(count, 0);
+
+		// The headers show the counts.
+		GuildMember group = pGld->GetGuildMember(groupId);
+		if (group.GetGroupCount() != count) {
+			group.SetGroupCount(count);
+			change.m_groups.push_back(groupId);
+		}
 	}
 
 	pGld->m_memberCount = GetFieldSafeInt(data, "member_count");
 	pGld->m_onlineCount = GetFieldSafeInt(data, "online_count");
 
+	// Only the subscribed windows are sent, but the ops give positions in the
+	// whole list.  Placeholders stand in for the rest, but not for all of a
+	// huge guild.  The sizes are after the ops, so only cut the list after.
+	listSize = std::min(listSize, m_memberListSubscriptions.GetSizeLimit());
+	if (bKnowSize)
+		ResizeMemberList(pGld, listSize, false, change);
+
 	for (auto& op : data["ops"])
 	{
 		std::string opCode = op["op"];
 
 		if (opCode == "SYNC") {
-			HandleGuildMemberListUpdate_Sync(guildId, op);
+			HandleGuildMemberListUpdate_Sync(guildId, op, change);
 			continue;
 		}
 		if (opCode == "INSERT") {
-			HandleGuildMemberListUpdate_Insert(guildId, op);
+			HandleGuildMemberListUpdate_Insert(guildId, op, change);
 			continue;
 		}
 		if (opCode == "DELETE") {
-			HandleGuildMemberListUpdate_Delete(guildId, op);
+			HandleGuildMemberListUpdate_Delete(guildId, op, change);
 			continue;
 		}
 		if (opCode == "UPDATE") {
-			HandleGuildMemberListUpdate_Update(guildId, op);
+			HandleGuildMemberListUpdate_Update(guildId, op, change);
 			continue;
 		}
 		if (opCode == "INVALIDATE") {
-			// nothing really
+			HandleGuildMemberListUpdate_Invalidate(guildId, op, change);
 			continue;
 		}
 		assert(!"TODO"); // what else
 	}
 
-	Snowflake currentGroup = 0;
-	for (auto& member : pGld->m_members) {
-		GuildMember* pMember = pGld->GetGuildMember(member);
+	if (bKnowSize)
+		ResizeMemberList(pGld, listSize, true, change);
 
-		if (pMember->m_bIsGroup)
-			currentGroup = pMember->m_groupId;
-		else
-			pMember->m_groupId = currentGroup;
+	if (change.m_bResized) {
+		GetFrontend()->UpdateMemberList(guildId, 0, pGld->m_members.Size(), true);
+		return;
+	}
+
+	if (change.m_groups.empty())
+		return;
+
+	const MemberListTree& members = pGld->m_members;
+	for (size_t index = members.FindNextGroup(0); index < members.Size(); index = members.FindNextGroup(index + 1))
+	{
+		Snowflake group = members.Get(index);
+		if (std::find(change.m_groups.begin(), change.m_groups.end(), group) != change.m_groups.end())
+			change.Replace(index, index + 1);
+	}
+}
+
+void DiscordInstance::MemberListChange::Replace(size_t start, size_t end)
+{
+	if (!m_bResized && start < end)
+		GetFrontend()->UpdateMemberList(m_guild, start, end, false);
+}
+
+void DiscordInstance::MemberListChange::Splice(size_t index, size_t erased, size_t inserted)
+{
+	if (!m_bResized && (erased || inserted))
+		GetFrontend()->SpliceMemberList(m_guild, index, erased, inserted);
+}
+
+void DiscordInstance::AssignMemberGroups(Guild* pGld, size_t start, size_t end)
+{
+	Snowflake group = start > 0 ? pGld->m_members.GetGroupAt(start - 1) : 0;
+
+	pGld->m_members.ForEachInRange(start, end, [&](size_t index, Snowflake sf, bool bIsGroup) {
+		if (bIsGroup)
+			group = sf;
+		else if (sf)
+			pGld->GetGuildMember(sf).SetGroupId(group);
+	});
+}
+
+void DiscordInstance::ResizeMemberList(Guild* pGld, size_t size, bool bAllowShrink, MemberListChange& change)
+{
+	MemberListTree& members = pGld->m_members;
+	size_t oldSize = members.Size();
+	if (oldSize == size || (oldSize > size && !bAllowShrink))
+		return;
+
+	while (members.Size() < size)
+		members.Insert(members.Size(), 0, false);
+
+	bool bErasedGroups = false;
+	while (members.Size() > size)
+	{
+		bErasedGroups |= members.IsGroup(members.Size() - 1);
+		members.Erase(members.Size() - 1);
 	}
 
-	GetFrontend()->UpdateMemberList();
+	if (bErasedGroups)
+		change.m_bResized = true;
+	else if (size > oldSize)
+		change.Splice(oldSize, 0, size - oldSize);
+	else
+		change.Splice(size, oldSize - size, 0);
 }
 
 Snowflake DiscordInstance::ParseGuildMember(Snowflake guild, nlohmann::json& memb, Snowflake userID)
@@ -2943,14 +3258,12 @@ Snowflake DiscordInstance::ParseGuildMember(Snowflake guild, nlohmann::json& mem
 	std::string avatarOverride = GetFieldSafe(memb, "avatar");
 	std::string nameOverride = GetFieldSafe(memb, "nick");
 
-	GuildMember& gm = pf->m_guildMembers[guild];
-	gm.m_user = pf->m_snowflake;
-	gm.m_avatar = avatarOverride;
-	gm.m_nick = nameOverride;
-	gm.m_user = pf->m_snowflake;
-	gm.m_joinedAt = ParseTime(GetFieldSafe(memb, "joined_at"));
-	gm.m_bIsLoadedFromChunk = true;
-	gm.m_groupId = 0; // to be filled in by the group layout
+	GuildMember gm = GetProfileCache()->LookupGuildMember(pf->m_snowflake, guild);
+	gm.SetAvatar(avatarOverride);
+	gm.SetNick(nameOverride);
+	gm.SetJoinedAt(ParseTime(GetFieldSafe(memb, "joined_at")));
+	gm.SetLoadedFromChunk(true);
+	// N.B. The group is left alone, it's only changed by the group layout.
 
 	Guild* pGuild = GetGuild(guild);
 	if (pGuild)
@@ -2974,9 +3287,19 @@ Snowflake DiscordInstance::ParseGuildMember(Snowflake guild, nlohmann::json& mem
 		}
 	}
 
-	gm.m_roles.clear();
+	SmallSnowflakeSet newRoles;
 	for (auto& it : roles)
-		gm.m_roles.push_back(GetSnowflakeFromJsonObject(it));
+		newRoles.insert(GetSnowflakeFromJsonObject(it));
+
+	if (gm.SetRoles(std::move(newRoles)))
+	{
+		if (pGuild)
+			m_permissionCache.InvalidateMember(pGuild, pf->m_snowflake);
+
+		// Role mentions in the guild's channels may now mean us, or no longer do.
+		if (pf->m_snowflake == m_mySnowflake)
+			GetMessageCache()->OnRolesChanged(guild);
+	}
 
 	return userID;
 }
@@ -3060,6 +3383,12 @@ void DiscordInstance::HandleGUILD_MEMBERS_CHUNK(nlohmann::json& j)
 		}
 	}
 
+	m_memberRequestTracker.OnChunk(
+		GetFieldSafe(data, "nonce"),
+		GetFieldSafeInt(data, "chunk_index"),
+		GetFieldSafeInt(data, "chunk_count")
+	);
+
 	if (m_CurrentGuild == guildId)
 		GetFrontend()->RefreshMembers(memsToRefresh);
 }
@@ -3091,14 +3420,13 @@ Snowflake DiscordInstance::ParseGuildMemberOrGroup(Snowflake guild, nlohmann::js
 	if (item.contains("group")) {
 		Json& grp = item["group"];
 
-		// fake a profile to integrate with the existing stuff
+		// groups are stored as members, keyed by their ID
 		Snowflake groupId = GetGroupId(GetFieldSafe(grp, "id"));
-		Profile* pf = GetProfileCache()->LookupProfile(groupId, "GROUP", "GROUP", "", false);
 
-		GuildMember& gm = pf->m_guildMembers[guild];
-		gm.m_groupId = groupId;
-		gm.m_bIsGroup = true;
-		return gm.m_groupId;
+		GuildMember gm = GetProfileCache()->LookupGuildMember(groupId, guild);
+		gm.SetGroupId(groupId);
+		gm.SetGroup(true);
+		return groupId;
 	}
 	else if (item.contains("member"))
 	{
@@ -3112,22 +3440,67 @@ Snowflake DiscordInstance::ParseGuildMemberOrGroup(Snowflake guild, nlohmann::js
 	}
 }
 
-void DiscordInstance::HandleGuildMemberListUpdate_Sync(Snowflake guild, nlohmann::json& jx)
+void DiscordInstance::HandleGuildMemberListUpdate_Sync(Snowflake guild, nlohmann::json& jx, MemberListChange& change)
 {
 	Guild* pGld = GetGuild(guild);
 	assert(pGld);
 
-	pGld->m_members.clear();
+	// The range is one of the windows we subscribed to.
+	size_t start = 0, end = 0;
+	Json& range = jx["range"];
+	if (range.is_array() && range.size() == 2) {
+		start = range[0];
+		end = size_t(range[1]) + 1;
+	}
 
-	// TODO: j["range"].  Is the range we told discord about
-	// when subscribing to the channel using websocket.
-	int m_ordinal = 0;
+	MemberListTree& members = pGld->m_members;
+	size_t oldSize = members.Size();
+	while (members.Size() < start)
+		members.Insert(members.Size(), 0, false);
+
+	size_t index = start;
+	bool bGroupsChanged = false;
 	Json& items = jx["items"];
 	for (auto& item : items)
-		pGld->m_members.push_back(ParseGuildMemberOrGroup(guild, item));
+	{
+		Snowflake sf = ParseGuildMemberOrGroup(guild, item);
+		bool bIsGroup = item.contains("group");
+
+		if (index < members.Size())
+		{
+			bool bWasGroup = members.IsGroup(index);
+			if ((bWasGroup || bIsGroup) && (bWasGroup != bIsGroup || members.Get(index) != sf))
+				bGroupsChanged = true;
+
+			members.Set(index, sf, bIsGroup);
+		}
+		else
+		{
+			members.Insert(index, sf, bIsGroup);
+		}
+
+		index++;
+	}
+
+	// Fewer items than asked for means the list ends here.
+	if (index < end) {
+		while (members.Size() > index)
+			members.Erase(members.Size() - 1);
+	}
+
+	// New group headers may take over the members after the window.
+	size_t assignEnd = members.FindNextGroup(index);
+	AssignMemberGroups(pGld, start, assignEnd);
+
+	// Usually the window was synced before, and only its entries were
+	// replaced.
+	if (members.Size() != oldSize || bGroupsChanged)
+		change.m_bResized = true;
+	else
+		change.Replace(start, assignEnd);
 }
 
-void DiscordInstance::HandleGuildMemberListUpdate_Insert(Snowflake guild, nlohmann::json& j)
+void DiscordInstance::HandleGuildMemberListUpdate_Insert(Snowflake guild, nlohmann::json& j, MemberListChange& change)
 {
 	Guild* pGld = GetGuild(guild);
 	assert(pGld);
@@ -3136,59 +3509,122 @@ void DiscordInstance::HandleGuildMemberListUpdate_Insert(Snowflake guild, nlohma
 	int index = j["index"];
 	Snowflake sf = ParseGuildMemberOrGroup(guild, item);
 
-	if (index < 0 || index >= int(pGld->m_members.size() + 1)) {
+	if (index < 0 || index >= int(pGld->m_members.Size() + 1)) {
 		//assert(!"huh");
 		// TODO: Treat this case somehow
 		return;
 	}
 
-	pGld->m_members.insert(pGld->m_members.begin() + index, sf);
+	bool bIsGroup = item.contains("group");
+	pGld->m_members.Insert(index, sf, bIsGroup);
+
+	// A new group header takes over the members after it.
+	size_t end = bIsGroup ? pGld->m_members.FindNextGroup(index + 1) : index + 1;
+	AssignMemberGroups(pGld, index, end);
+
+	if (bIsGroup)
+		change.m_bResized = true;
+	else
+		change.Splice(index, 0, 1);
 }
 
-void DiscordInstance::HandleGuildMemberListUpdate_Delete(Snowflake guild, nlohmann::json& j)
+void DiscordInstance::HandleGuildMemberListUpdate_Delete(Snowflake guild, nlohmann::json& j, MemberListChange& change)
 {
 	Guild* pGld = GetGuild(guild);
 	assert(pGld);
 
 	int index = j["index"];
 
-	if (index < 0 || index >= int(pGld->m_members.size())) {
+	if (index < 0 || index >= int(pGld->m_members.Size())) {
 		//assert(!"huh");
 		// TODO: Treat this case somehow
 		return;
 	}
 	
-	Snowflake memberId = pGld->m_members[index];
-	GuildMember& member = GetProfileCache()->LookupProfile(memberId, "", "", "", false)->m_guildMembers[guild];
+	Snowflake memberId = pGld->m_members.Get(index);
+	bool bIsGroup = pGld->m_members.IsGroup(index);
 
-	if (member.m_bIsGroup) {
+	if (bIsGroup) {
 		// also remove that group
-		GetProfileCache()->ForgetProfile(memberId);
+		GetProfileCache()->ForgetGuildMember(memberId, guild);
 	}
 
-	pGld->m_members.erase(pGld->m_members.begin() + index);
+	pGld->m_members.Erase(index);
+
+	// The members of a removed group header fall under the one before it.
+	size_t end = bIsGroup ? pGld->m_members.FindNextGroup(index) : index;
+	AssignMemberGroups(pGld, index, end);
+
+	if (bIsGroup)
+		change.m_bResized = true;
+	else
+		change.Splice(index, 1, 0);
 }
 
-void DiscordInstance::HandleGuildMemberListUpdate_Update(Snowflake guild, nlohmann::json& j)
+void DiscordInstance::HandleGuildMemberListUpdate_Update(Snowflake guild, nlohmann::json& j, MemberListChange& change)
 {
 	Guild* pGld = GetGuild(guild);
 	assert(pGld);
 
 	int index = j["index"];
 
-	if (index < 0 || index >= int(pGld->m_members.size())) {
+	if (index < 0 || index >= int(pGld->m_members.Size())) {
 		//assert(!"huh");
 		// TODO: Treat this case somehow
 		return;
 	}
 
-	Snowflake sf = ParseGuildMemberOrGroup(guild, j["item"]);
-	pGld->m_members[index] = sf;
+	Json& item = j["item"];
+	Snowflake sf = ParseGuildMemberOrGroup(guild, item);
+	Snowflake oldSf = pGld->m_members.Get(index);
+	bool bWasGroup = pGld->m_members.IsGroup(index);
+	bool bIsGroup = item.contains("group");
+	pGld->m_members.Set(index, sf, bIsGroup);
+
+	if ((bWasGroup || bIsGroup) && (bWasGroup != bIsGroup || oldSf != sf))
+	{
+		// A different group header takes over the members after it.
+		AssignMemberGroups(pGld, index, pGld->m_members.FindNextGroup(index + 1));
+		change.m_bResized = true;
+	}
+	else
+	{
+		AssignMemberGroups(pGld, index, index + 1);
+		change.Replace(index, index + 1);
+	}
 
 	std::set<Snowflake> updates{ sf };
 	GetFrontend()->RefreshMembers(updates);
 }
 
+void DiscordInstance::HandleGuildMemberListUpdate_Invalidate(Snowflake guild, nlohmann::json& j, MemberListChange& change)
+{
+	Guild* pGld = GetGuild(guild);
+	assert(pGld);
+
+	// A window we no longer subscribe to.  Its members won't be kept up to
+	// date, so only keep the group headers.
+	Json& range = j["range"];
+	if (!range.is_array() || range.size() != 2)
+		return;
+
+	MemberListTree& members = pGld->m_members;
+	size_t start = range[0];
+	size_t end = std::min(size_t(range[1]) + 1, members.Size());
+
+	std::vector<size_t> invalidated;
+	members.ForEachInRange(start, end, [&](size_t index, Snowflake sf, bool bIsGroup) {
+		if (!bIsGroup && sf)
+			invalidated.push_back(index);
+	});
+
+	for (size_t index : invalidated)
+		members.Set(index, 0, false);
+
+	if (!invalidated.empty())
+		change.Replace(invalidated.front(), invalidated.back() + 1);
+}
+
 void DiscordInstance::OnUploadAttachmentFirst(NetRequest* pReq)
 {
 	auto& ups = m_pendingUploads;
@@ -3216,10 +3652,7 @@ void DiscordInstance::OnUploadAttachmentFirst(NetRequest* pReq)
 		up.m_uploadUrl = GetFieldSafe(att, "upload_url");
 		up.m_uploadFileName = GetFieldSafe(att, "upload_filename");
 
-		// Send data to the upload URL
-		uint8_t* pNewData = new uint8_t[up.m_data.size()];
-		memcpy(pNewData, up.m_data.data(), up.m_data.size());
-
+		// Send data to the upload URL.  The HTTP client copies it.
 		GetHTTPClient()->PerformRequest(
 			true,
 			NetRequest::PUT_OCTETS_PROGRESS,
@@ -3230,7 +3663,7 @@ void DiscordInstance::OnUploadAttachmentFirst(NetRequest* pReq)
 			"",//GetToken(),
 			"",
 			nullptr, // default processing
-			pNewData,
+			up.m_data.data(),
 			up.m_data.size()
 		);
 
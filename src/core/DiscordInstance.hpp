@@ -14,6 +14,12 @@
 #include "network/DiscordRequest.hpp"
 #include "state/MessageCache.hpp"
 #include "state/ProfileCache.hpp"
+#include "state/SearchIndex.hpp"
+#include "state/EntityDirectory.hpp"
+#include "state/PermissionCache.hpp"
+#include "state/ProfileFetchScheduler.hpp"
+#include "state/MemberRequestTracker.hpp"
+#include "state/MemberListSubscriptions.hpp"
 #include "models/ScrollDir.hpp"
 #include "models/Message.hpp"
 #include "models/Relationship.hpp"
@@ -26,7 +32,7 @@ struct NetRequest;
 
 struct AddMessageParams
 {
-	Message msg;
+	MessagePtr msg;
 	Snowflake channel;
 };
 
@@ -171,6 +177,19 @@ public:
 
 	Guild m_dmGuild;
 
+	// Index of the guilds, channels and roles above, by snowflake.
+	EntityDirectory m_entityDirectory;
+
+	PermissionCache m_permissionCache;
+
+	ProfileFetchScheduler m_profileFetchScheduler;
+
+	// Member requests (gateway op 8) waiting for an answer.
+	MemberRequestTracker m_memberRequestTracker;
+
+	// Windows of the current channel's member list subscribed to (gateway op 14).
+	MemberListSubscriptions m_memberListSubscriptions;
+
 	// Requests in progress
 	std::map<Snowflake, bool> m_messageRequestsInProgress;
 
@@ -239,7 +258,6 @@ public:
 		return m_gatewayConnId;
 	}
 
-	// TODO optimize this stuff
 	Guild* GetGuild(Snowflake sf)
 	{
 		assert(sf != 1);
@@ -247,12 +265,7 @@ public:
 		if (!sf)
 			return &m_dmGuild;
 
-		for (auto& g : m_guilds)
-		{
-			if (g.m_snowflake == sf)
-				return &g;
-		}
-		return nullptr;
+		return m_entityDirectory.GetGuild(sf);
 	}
 
 	void GetGuildIDs(std::vector<Snowflake>& sf, bool bUI = false)
@@ -343,20 +356,7 @@ public:
 
 	Channel* GetChannel(Snowflake sf)
 	{
-		Channel* pChan;
-		Guild* pGuild = GetCurrentGuild();
-		if (pGuild) {
-			pChan = pGuild->GetChannel(sf);
-			if (pChan) return pChan;
-		}
-
-		for (auto& gld : m_guilds) {
-			pChan = gld.GetChannel(sf);
-			if (pChan)
-				return pChan;
-		}
-
-		return m_dmGuild.GetChannel(sf);
+		return m_entityDirectory.GetChannel(sf);
 	}
 
 	Channel* GetCurrentChannel()
@@ -456,6 +456,10 @@ public:
 	// Inform the Discord backend that we have acknowledged a message.
 	void RequestAcknowledgeChannel(Snowflake channel);
 
+	// Searches the messages we have locally, in the message cache and store, without asking
+	// the server.  Returns the amount of matches in total; only one page is added to "results".
+	size_t SearchMessages(const SearchQuery& query, std::vector<SearchResult>& results);
+
 	// Mark an entire guild as read.
 	void RequestAcknowledgeGuild(Snowflake guild);
 
@@ -472,7 +476,11 @@ public:
 	void RequestLeaveGuild(Snowflake guild);
 
 	// Update channels that we are subscribed to.
-	void UpdateSubscriptions(Snowflake guild, Snowflake channel, bool typing, bool activities, bool threads, int rangeMembers = 99);
+	void UpdateSubscriptions(Snowflake guild, Snowflake channel, bool typing, bool activities, bool threads);
+
+	// The member list shows entries [first, last] of the guild's member list.
+	// Subscribes to the windows around them, if they changed.
+	void UpdateMemberListViewport(Snowflake guild, size_t first, size_t last);
 
 	// Request a jump to a message.
 	void JumpToMessage(Snowflake guild, Snowflake channel, Snowflake message);
@@ -521,6 +529,7 @@ private:
 	bool SortGuilds();
 	void ParseChannel(Channel& c, nlohmann::json& j, int& num);
 	void ParseAndAddGuild(nlohmann::json& j);
+	void ClearGuilds();
 	void ParsePermissionOverwrites(Channel& c, nlohmann::json& j);
 	void ParseReadStateObject(nlohmann::json& j, bool bAlternate);
 	void OnUploadAttachmentFirst(NetRequest* pReq);
@@ -542,9 +551,14 @@ private:
 	void HandleUSER_NOTE_UPDATE(nlohmann::json& j);
 	void HandleGUILD_CREATE(nlohmann::json& j);
 	void HandleGUILD_DELETE(nlohmann::json& j);
+	void HandleGUILD_UPDATE(nlohmann::json& j);
+	void HandleGUILD_ROLE_CREATE(nlohmann::json& j);
+	void HandleGUILD_ROLE_UPDATE(nlohmann::json& j);
+	void HandleGUILD_ROLE_DELETE(nlohmann::json& j);
 	void HandleCHANNEL_CREATE(nlohmann::json& j);
 	void HandleCHANNEL_DELETE(nlohmann::json& j);
 	void HandleCHANNEL_UPDATE(nlohmann::json& j);
+	void HandleCHANNEL_PINS_UPDATE(nlohmann::json& j);
 	void HandleGUILD_MEMBER_LIST_UPDATE(nlohmann::json& j);
 	void HandleGUILD_MEMBERS_CHUNK(nlohmann::json& j);
 	void HandleTYPING_START(nlohmann::json& j);
@@ -552,10 +566,39 @@ private:
 	void HandlePASSIVE_UPDATE_V1(nlohmann::json& j);
 
 private:
-	void HandleGuildMemberListUpdate_Sync(Snowflake guild, nlohmann::json& j);
-	void HandleGuildMemberListUpdate_Insert(Snowflake guild, nlohmann::json& j);
-	void HandleGuildMemberListUpdate_Delete(Snowflake guild, nlohmann::json& j);
-	void HandleGuildMemberListUpdate_Update(Snowflake guild, nlohmann::json& j);
+	// Reports the changes the ops of one GUILD_MEMBER_LIST_UPDATE make to a
+	// guild's member list to the frontend, as they're made.  Once the list has
+	// to be laid out again, e.g. because group headers came or went, the rest
+	// is left to that.
+	struct MemberListChange
+	{
+		Snowflake m_guild = 0;
+		bool m_bResized = false;
+
+		// Group headers whose member counts changed.
+		std::vector<Snowflake> m_groups;
+
+		// Entries [start, end) were replaced.
+		void Replace(size_t start, size_t end);
+
+		// 'erased' members at this position were replaced by 'inserted' new
+		// ones.  Group headers must not be among them.
+		void Splice(size_t index, size_t erased, size_t inserted);
+	};
+
+	// Sets the group of the members in [start, end) of the guild's member list
+	// to the group header they are listed under.
+	void AssignMemberGroups(Guild* pGld, size_t start, size_t end);
+
+	// Pads the guild's member list with placeholders, for the entries that
+	// aren't subscribed to, or cuts it, to the size the server reports.
+	void ResizeMemberList(Guild* pGld, size_t size, bool bAllowShrink, MemberListChange& change);
+
+	void HandleGuildMemberListUpdate_Sync(Snowflake guild, nlohmann::json& j, MemberListChange& change);
+	void HandleGuildMemberListUpdate_Insert(Snowflake guild, nlohmann::json& j, MemberListChange& change);
+	void HandleGuildMemberListUpdate_Delete(Snowflake guild, nlohmann::json& j, MemberListChange& change);
+	void HandleGuildMemberListUpdate_Update(Snowflake guild, nlohmann::json& j, MemberListChange& change);
+	void HandleGuildMemberListUpdate_Invalidate(Snowflake guild, nlohmann::json& j, MemberListChange& change);
 	void HandleMessageInsertOrUpdate(nlohmann::json& j, bool bIsUpdate);
 };
 
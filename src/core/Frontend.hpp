@@ -23,8 +23,8 @@ public:
 	virtual void OnSessionClosed(int errorCode) = 0;
 	virtual void OnConnecting() = 0;
 	virtual void OnConnected() = 0;
-	virtual void OnAddMessage(Snowflake channelID, const Message& msg) = 0;
-	virtual void OnUpdateMessage(Snowflake channelID, const Message& msg) = 0;
+	virtual void OnAddMessage(Snowflake channelID, const MessagePtr& msg) = 0;
+	virtual void OnUpdateMessage(Snowflake channelID, const MessagePtr& msg) = 0;
 	virtual void OnDeleteMessage(Snowflake messageInCurrentChannel) = 0;
 	virtual void OnStartTyping(Snowflake userID, Snowflake guildID, Snowflake channelID, time_t startTime) = 0;
 	virtual void OnAttachmentDownloaded(bool bIsProfilePicture, const uint8_t* pData, size_t nSize, const std::string& additData) = 0;
@@ -51,7 +51,8 @@ public:
 	virtual void UpdateSelectedGuild() = 0;
 	virtual void UpdateSelectedChannel() = 0;
 	virtual void UpdateChannelList() = 0;
-	virtual void UpdateMemberList() = 0;
+	virtual void UpdateMemberList(Snowflake guild, size_t start, size_t end, bool bResized) = 0; // <-- Entries [start, end) of the guild's member list changed. bResized if entries were added or removed
+	virtual void SpliceMemberList(Snowflake guild, size_t index, size_t erased, size_t inserted) = 0; // <-- 'erased' members at this position of the guild's member list were replaced by 'inserted' new ones
 	virtual void UpdateChannelAcknowledge(Snowflake channelID, Snowflake messageID) = 0;
 	virtual void UpdateProfileAvatar(Snowflake userID, const std::string& resid) = 0;
 	virtual void UpdateProfilePopout(Snowflake userID) = 0; // <-- Updates if userID is the ID of the profile currently open
@@ -75,6 +76,10 @@ public:
 	// Heartbeat interval
 	virtual void SetHeartbeatInterval(int timeMs) = 0;
 
+	// Calls ProfileFetchScheduler::OnTimer once after this time, replacing the
+	// timer set before.  0 cancels it.
+	virtual void SetProfileFetchTimer(int timeMs) = 0;
+
 	// Interface with AvatarCache
 	virtual void RegisterIcon(Snowflake sf, const std::string& avatarlnk) = 0;
 	virtual void RegisterAvatar(Snowflake sf, const std::string& avatarlnk) = 0;
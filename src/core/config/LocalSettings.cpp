@@ -131,6 +131,24 @@ bool LocalSettings::Load()
 	if (j.contains("UseDoubleBuffering"))
 		m_bUseDoubleBuffering = j["UseDoubleBuffering"];
 
+	if (j.contains("MaxInteractiveNetworkerThreads"))
+		m_maxInteractiveNetworkerThreads = int(j["MaxInteractiveNetworkerThreads"]);
+
+	if (j.contains("MaxBackgroundNetworkerThreads"))
+		m_maxBackgroundNetworkerThreads = int(j["MaxBackgroundNetworkerThreads"]);
+
+	if (j.contains("NetworkerIdleTimeout"))
+		m_networkerIdleTimeout = int(j["NetworkerIdleTimeout"]);
+
+	if (j.contains("EnableHTTPDiskCache"))
+		m_bEnableHTTPDiskCache = j["EnableHTTPDiskCache"];
+	if (j.contains("EnableMessageStore"))
+		m_bEnableMessageStore = j["EnableMessageStore"];
+	if (j.contains("MessageCacheBudget"))
+		m_messageCacheBudget = int(j["MessageCacheBudget"]);
+	if (j.contains("ProfileCacheBudget"))
+		m_profileCacheBudget = int(j["ProfileCacheBudget"]);
+
 	if (m_bSaveWindowSize)
 	{
 		if (j.contains("WindowWidth"))
@@ -203,6 +221,13 @@ bool LocalSettings::Save()
 	j["Use12HourTime"] = m_bUse12HourTime;
 	j["ShowBlockedMessages"] = m_bShowBlockedMessages;
 	j["UseDoubleBuffering"] = m_bUseDoubleBuffering;
+	j["MaxInteractiveNetworkerThreads"] = m_maxInteractiveNetworkerThreads;
+	j["MaxBackgroundNetworkerThreads"] = m_maxBackgroundNetworkerThreads;
+	j["NetworkerIdleTimeout"] = m_networkerIdleTimeout;
+	j["EnableHTTPDiskCache"] = m_bEnableHTTPDiskCache;
+	j["EnableMessageStore"] = m_bEnableMessageStore;
+	j["MessageCacheBudget"] = m_messageCacheBudget;
+	j["ProfileCacheBudget"] = m_profileCacheBudget;
 	
 	if (m_bSaveWindowSize) {
 		j["WindowWidth"] = m_width;
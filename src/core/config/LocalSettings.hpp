@@ -226,6 +226,48 @@ public:
 	void SetUseDoubleBuffering(bool b) {
 		m_bUseDoubleBuffering = b;
 	}
+	int GetMaxInteractiveNetworkerThreads() const {
+		return m_maxInteractiveNetworkerThreads;
+	}
+	void SetMaxInteractiveNetworkerThreads(int n) {
+		m_maxInteractiveNetworkerThreads = n;
+	}
+	int GetMaxBackgroundNetworkerThreads() const {
+		return m_maxBackgroundNetworkerThreads;
+	}
+	void SetMaxBackgroundNetworkerThreads(int n) {
+		m_maxBackgroundNetworkerThreads = n;
+	}
+	int GetNetworkerIdleTimeout() const {
+		return m_networkerIdleTimeout;
+	}
+	void SetNetworkerIdleTimeout(int seconds) {
+		m_networkerIdleTimeout = seconds;
+	}
+	bool EnableHTTPDiskCache() const {
+		return m_bEnableHTTPDiskCache;
+	}
+	void SetEnableHTTPDiskCache(bool b) {
+		m_bEnableHTTPDiskCache = b;
+	}
+	bool EnableMessageStore() const {
+		return m_bEnableMessageStore;
+	}
+	void SetEnableMessageStore(bool b) {
+		m_bEnableMessageStore = b;
+	}
+	int GetMessageCacheBudget() const {
+		return m_messageCacheBudget;
+	}
+	void SetMessageCacheBudget(int megabytes) {
+		m_messageCacheBudget = megabytes;
+	}
+	int GetProfileCacheBudget() const {
+		return m_profileCacheBudget;
+	}
+	void SetProfileCacheBudget(int megabytes) {
+		m_profileCacheBudget = megabytes;
+	}
 
 private:
 	std::string m_token;
@@ -262,6 +304,13 @@ private:
 	int m_width = 1000;
 	int m_height = 700;
 	int m_userScale = 1000;
+	int m_maxInteractiveNetworkerThreads = 4;
+	int m_maxBackgroundNetworkerThreads = 8;
+	int m_networkerIdleTimeout = 30; // seconds
+	bool m_bEnableHTTPDiskCache = false;
+	bool m_bEnableMessageStore = true;
+	int m_messageCacheBudget = 64; // megabytes, 0 for no limit
+	int m_profileCacheBudget = 16; // megabytes, 0 for no limit
 };
 
 LocalSettings* GetLocalSettings();
@@ -1,35 +1,79 @@
+#include <algorithm>
 #include <nlohmann/json.h>
 #include "Channel.hpp"
 #include "../state/MessageCache.hpp"
 #include "../DiscordInstance.hpp"
 
+static const RoleOverwrites& GetRoleOverwrites(const Channel* pChannel, const Guild* pGuild)
+{
+	RoleOverwrites& ro = pChannel->m_roleOverwrites;
+	if (ro.m_generation != 0 && ro.m_generation == pGuild->m_roleSlotGeneration)
+		return ro;
+
+	ro = RoleOverwrites();
+	ro.m_generation = pGuild->m_roleSlotGeneration;
+
+	for (auto& ow : pChannel->m_overwrites)
+	{
+		if (ow.second.m_bIsMember)
+			continue;
+
+		if (ow.first == pChannel->m_parentGuild)
+		{
+			ro.m_everyoneAllow = ow.second.m_allow;
+			ro.m_everyoneDeny = ow.second.m_deny;
+			continue;
+		}
+
+		int slot = pGuild->GetRoleSlot(ow.first);
+		if (slot < 0)
+			continue;
+
+		RoleOverwrites::Entry entry;
+		entry.m_slot = slot;
+		entry.m_allow = ow.second.m_allow;
+		entry.m_deny = ow.second.m_deny;
+		ro.m_entries.push_back(entry);
+		ro.m_roles.Set(slot);
+	}
+
+	std::sort(ro.m_entries.begin(), ro.m_entries.end(), [](const RoleOverwrites::Entry& a, const RoleOverwrites::Entry& b) {
+		return a.m_slot < b.m_slot;
+	});
+
+	return ro;
+}
+
 // Thanks https://discord.com/developers/docs/topics/permissions#permission-overwrites
-uint64_t Channel::ComputePermissionOverwrites(Snowflake Member, uint64_t BasePermissions) const
+uint64_t Channel::ComputePermissionOverwrites(const Guild* pGuild, Snowflake Member, uint64_t BasePermissions) const
 {
 	// Administrator overrides any potential permission overwrites.
 	if (BasePermissions & PERM_ADMINISTRATOR)
 		return PERM_ALL;
 
-	// Find @everyone overwrite and apply it.
-	auto everyoneIter = m_overwrites.find(m_parentGuild);
-	if (everyoneIter != m_overwrites.end())
-	{
-		BasePermissions &= ~everyoneIter->second.m_deny;
-		BasePermissions |= everyoneIter->second.m_allow;
-	}
+	const RoleOverwrites& ro = GetRoleOverwrites(this, pGuild);
+
+	// Apply the @everyone overwrite.
+	BasePermissions &= ~ro.m_everyoneDeny;
+	BasePermissions |= ro.m_everyoneAllow;
 
 	// Apply role specific overwrites.
-	Profile* pf = GetProfileCache()->LookupProfile(Member, "", "", "", false);
-	GuildMember& gm = pf->m_guildMembers[m_parentGuild];
+	GuildMember gm = GetProfileCache()->FindGuildMember(Member, m_parentGuild);
+	RoleBitset matched;
+	if (gm.IsValid())
+		matched = pGuild->GetMemberRoles(gm) & ro.m_roles;
+
 	uint64_t Allow = 0, Deny = 0;
-	for (auto roleId : gm.m_roles)
+	if (!matched.Empty())
 	{
-		auto roleIter = m_overwrites.find(roleId);
-		if (roleIter == m_overwrites.end())
-			continue; // not found!
+		for (auto& entry : ro.m_entries)
+		{
+			if (!matched.Test(entry.m_slot))
+				continue;
 
-		Allow |= roleIter->second.m_allow;
-		Deny  &= ~roleIter->second.m_deny;
+			Allow |= entry.m_allow;
+			Deny  |= entry.m_deny;
+		}
 	}
 
 	BasePermissions &= ~Deny;
@@ -48,39 +92,25 @@ uint64_t Channel::ComputePermissionOverwrites(Snowflake Member, uint64_t BasePer
 
 bool Channel::HasPermissionUser(Snowflake sf, uint64_t Permission)
 {
-	Guild* pGuild = GetDiscordInstance()->GetGuild(m_parentGuild);
+	DiscordInstance* pDiscord = GetDiscordInstance();
+	Guild* pGuild = pDiscord->GetGuild(m_parentGuild);
 	assert(pGuild);
-	uint64_t perms = ComputePermissionOverwrites(sf, pGuild->ComputeBasePermissions(sf));
+	uint64_t perms = pDiscord->m_permissionCache.GetUserPermissions(pGuild, this, sf);
 
 	return (perms & Permission) != 0;
 }
 
 bool Channel::HasPermission(uint64_t Permission)
 {
-	if (!m_bCurrentUserPermsCalculated)
-	{
-		// calculate them
-		Guild* pGuild = GetDiscordInstance()->GetGuild(m_parentGuild);
-		assert(pGuild);
-		Snowflake currUser = GetDiscordInstance()->GetProfile()->m_snowflake;
-		m_currentUserPerms = ComputePermissionOverwrites(currUser, pGuild->ComputeBasePermissions(currUser));
-	}
-
-	return (m_currentUserPerms & Permission) != 0;
+	return HasPermissionConst(Permission);
 }
 
 bool Channel::HasPermissionConst(uint64_t Permission) const
 {
-	uint64_t perms = m_currentUserPerms;
-
-	if (!m_bCurrentUserPermsCalculated)
-	{
-		// calculate them
-		Guild* pGuild = GetDiscordInstance()->GetGuild(m_parentGuild);
-		assert(pGuild);
-		Snowflake currUser = GetDiscordInstance()->GetProfile()->m_snowflake;
-		perms = ComputePermissionOverwrites(currUser, pGuild->ComputeBasePermissions(currUser));
-	}
+	DiscordInstance* pDiscord = GetDiscordInstance();
+	Guild* pGuild = pDiscord->GetGuild(m_parentGuild);
+	assert(pGuild);
+	uint64_t perms = pDiscord->m_permissionCache.GetCurrentUserPermissions(pGuild, this);
 
 	return (perms & Permission) != 0;
 }
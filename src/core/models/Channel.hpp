@@ -4,10 +4,36 @@
 #include <vector>
 #include "Snowflake.hpp"
 #include "Permissions.hpp"
+#include "RoleBitset.hpp"
 
 // Read state object "flags" member.  Only seems to have this.
 #define RSTATE_FLAG_HAS_LASTVIEWED (1 << 0)
 
+struct Guild;
+
+// A channel's role overwrites, by slot in the guild's role table.
+struct RoleOverwrites
+{
+	struct Entry
+	{
+		int m_slot = 0;
+		uint64_t m_allow = 0;
+		uint64_t m_deny = 0;
+	};
+
+	// The generation of the guild's role table this was built for.  0 if
+	// it must be rebuilt.
+	uint32_t m_generation = 0;
+
+	// The roles that have an overwrite, and their overwrites by ascending slot.
+	RoleBitset m_roles;
+	std::vector<Entry> m_entries;
+
+	// The @everyone overwrite.
+	uint64_t m_everyoneAllow = 0;
+	uint64_t m_everyoneDeny = 0;
+};
+
 struct Channel
 {
 	enum eChannelType
@@ -40,8 +66,14 @@ struct Channel
 	std::string m_avatarLnk = ""; // valid only for DM channels
 	int m_pos = 0;
 	std::map<Snowflake, Overwrite> m_overwrites;
-	uint64_t m_currentUserPerms = 0;
-	bool m_bCurrentUserPermsCalculated = false;
+
+	// Built from m_overwrites by GetRoleOverwrites.
+	mutable RoleOverwrites m_roleOverwrites;
+
+	// Cached by the PermissionCache.  Valid while the generation matches the guild's.
+	mutable uint64_t m_currentUserPerms = 0;
+	mutable uint32_t m_currentUserPermsGeneration = 0;
+	mutable bool m_bCurrentUserPermsCalculated = false;
 	int m_mentionCount = 0;
 
 	// The "last_viewed" field in the read state object.  Appears to be a sequence number.
@@ -80,7 +112,12 @@ struct Channel
 	Channel() {}
 	Channel(uint64_t sf, const std::string& st, eChannelType ct) :m_channelType(ct), m_snowflake(sf), m_name(st) {}
 
-	uint64_t ComputePermissionOverwrites(Snowflake Member, uint64_t BasePermissions) const;
+	uint64_t ComputePermissionOverwrites(const Guild* pGuild, Snowflake Member, uint64_t BasePermissions) const;
+
+	// Must be called after m_overwrites is changed.
+	void InvalidateRoleOverwrites() {
+		m_roleOverwrites.m_generation = 0;
+	}
 
 	// Check if the current user has permission to do something.
 	bool HasPermission(uint64_t Permission);
@@ -18,24 +18,25 @@ void GuildRole::Load(nlohmann::json& j)
 	m_colorOriginal = GetFieldSafeInt(j, "color");
 }
 
-GuildMember* Guild::GetGuildMember(Snowflake sf)
+GuildMember Guild::GetGuildMember(Snowflake sf)
 {
-	return &GetProfileCache()->LookupProfile(sf, "", "", "", false)->m_guildMembers[m_snowflake];
+	return GetProfileCache()->LookupGuildMember(sf, m_snowflake);
 }
 
-void Guild::RequestFetchChannels()
+std::string Guild::GetChannelsUrl() const
 {
-	std::string url;
-
 	if (m_snowflake)
-		url = GetDiscordAPI() + "guilds/" + std::to_string(m_snowflake) + "/channels";
+		return GetDiscordAPI() + "guilds/" + std::to_string(m_snowflake) + "/channels";
 	else
-		url = GetDiscordAPI() + "users/@me/channels";
+		return GetDiscordAPI() + "users/@me/channels";
+}
 
+void Guild::RequestFetchChannels()
+{
 	GetHTTPClient()->PerformRequest(
 		true,
 		NetRequest::GET,
-		url,
+		GetChannelsUrl(),
 		DiscordRequest::GUILD,
 		m_snowflake,
 		"",
@@ -50,11 +51,9 @@ std::string Guild::GetGroupName(Snowflake id)
 	if (id == GROUP_OFFLINE)
 		return "Offline";
 
-	for (auto& role : m_roles) {
-		if (role.first == id) {
-			return role.second.m_name;
-		}
-	}
+	auto iter = m_roles.find(id);
+	if (iter != m_roles.end())
+		return iter->second.m_name;
 
 	return std::to_string(id);
 }
@@ -66,14 +65,17 @@ uint64_t Guild::ComputeBasePermissions(Snowflake member)
 		return PERM_ALL;
 
 	// Get the everyone role
-	GuildRole& everyone = m_roles[m_snowflake];
-	uint64_t perms = everyone.m_permissions;
-
-	Profile* pf = GetProfileCache()->LookupProfile(member, "", "", "", false);
-	GuildMember& gm = pf->m_guildMembers[m_snowflake];
-	for (auto& roleId : gm.m_roles) {
-		GuildRole& grole = m_roles[roleId];
-		perms |= grole.m_permissions;
+	uint64_t perms = 0;
+	int everyoneSlot = GetRoleSlot(m_snowflake);
+	if (everyoneSlot >= 0)
+		perms = m_slotPermissions[everyoneSlot];
+
+	GuildMember gm = GetProfileCache()->FindGuildMember(member, m_snowflake);
+	if (gm.IsValid())
+	{
+		GetMemberRoles(gm).ForEach([&](int slot) {
+			perms |= m_slotPermissions[slot];
+		});
 	}
 
 	if (perms & PERM_ADMINISTRATOR)
@@ -82,6 +84,66 @@ uint64_t Guild::ComputeBasePermissions(Snowflake member)
 	return perms;
 }
 
+void Guild::RebuildRoleSlots()
+{
+	// Generations are never reused, so bitsets built for an older table, even
+	// one of a guild object that was replaced, are always rebuilt.
+	static uint32_t s_generation = 0;
+
+	m_roleSlots.Clear();
+	m_slotPermissions.clear();
+	m_roleSlotGeneration = ++s_generation;
+
+	for (auto& role : m_roles)
+	{
+		if (m_slotPermissions.size() >= C_MAX_GUILD_ROLES)
+			break;
+
+		m_roleSlots.Insert(role.first, int(m_slotPermissions.size()));
+		m_slotPermissions.push_back(role.second.m_permissions);
+	}
+}
+
+int Guild::GetRoleSlot(Snowflake role) const
+{
+	const int* pSlot = m_roleSlots.Find(role);
+	return pSlot ? *pSlot : -1;
+}
+
+RoleBitset Guild::GetRoleBitset(const SmallSnowflakeSet& roles) const
+{
+	RoleBitset bits;
+	for (Snowflake role : roles)
+	{
+		int slot = GetRoleSlot(role);
+		if (slot >= 0)
+			bits.Set(slot);
+	}
+
+	return bits;
+}
+
+const RoleBitset& Guild::GetMemberRoles(const GuildMember& gm) const
+{
+	GuildMemberTable* pTable = gm.m_pTable;
+	RoleBitset& bits = pTable->m_roleBits[gm.m_row];
+	uint32_t& generation = pTable->m_roleBitsGenerations[gm.m_row];
+
+	if (generation == m_roleSlotGeneration)
+		return bits;
+
+	bits.Clear();
+	for (Snowflake role : pTable->m_roles[gm.m_row])
+	{
+		int slot = GetRoleSlot(role);
+		if (slot >= 0)
+			bits.Set(slot);
+	}
+
+	generation = m_roleSlotGeneration;
+	return bits;
+}
+
 bool Guild::IsFirstChannel(Snowflake channel)
 {
 	Snowflake lowestId = Snowflake(-1);
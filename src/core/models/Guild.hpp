@@ -6,6 +6,10 @@
 #include <vector>
 #include <nlohmann/json.h>
 #include "Snowflake.hpp"
+#include "SnowflakeMap.hpp"
+#include "SmallSnowflakeSet.hpp"
+#include "RoleBitset.hpp"
+#include "MemberListTree.hpp"
 #include "Channel.hpp"
 #include "../utils/Emoji.hpp"
 #include "../state/UserGuildSettings.hpp"
@@ -62,12 +66,21 @@ struct Guild
 	Snowflake m_currentChannel = 0;
 
 	std::map<Snowflake, GuildRole> m_roles;
+
+	// Slots of the roles above in RoleBitsets, and the permissions of each slot.
+	// Rebuilt by RebuildRoleSlots, which gives the table a new generation.
+	SnowflakeMap<int> m_roleSlots;
+	std::vector<uint64_t> m_slotPermissions;
+	uint32_t m_roleSlotGeneration = 0;
 	std::map<Snowflake, Emoji> m_emoji;
-	std::vector<Snowflake> m_members;
+	MemberListTree m_members;
 	int m_memberCount = 0, m_onlineCount = 0;
 
 	Snowflake m_ownerId = 0;
 
+	// Bumped by the PermissionCache when the roles or the owner change.
+	uint32_t m_permissionGeneration = 0;
+
 	std::set<Snowflake> m_knownMembers;
 
 	eMessageNotifications m_defaultMessageNotifications = NOTIF_ALL_MESSAGES;
@@ -88,7 +101,8 @@ struct Guild
 		return nullptr;
 	}
 
-	GuildMember* GetGuildMember(Snowflake sf);
+	// Gets a member, adding them to the guild's member table if needed.
+	GuildMember GetGuildMember(Snowflake sf);
 
 	Guild(Snowflake sf, const std::string& name) : m_snowflake(sf), m_name(name)
 	{}
@@ -97,10 +111,24 @@ struct Guild
 
 	void RequestFetchChannels();
 
+	// Gets the URL that the channel list is fetched from.
+	std::string GetChannelsUrl() const;
+
 	std::string GetGroupName(Snowflake id);
 
 	uint64_t ComputeBasePermissions(Snowflake member);
 
+	// Must be called after m_roles is changed.
+	void RebuildRoleSlots();
+
+	// Returns -1 if the role doesn't exist.
+	int GetRoleSlot(Snowflake role) const;
+
+	RoleBitset GetRoleBitset(const SmallSnowflakeSet& roles) const;
+
+	// Gets the member's roles as a bitset, building it if it's out of date.
+	const RoleBitset& GetMemberRoles(const GuildMember& gm) const;
+
 	bool IsFirstChannel(Snowflake channel);
 
 	void AddKnownMember(Snowflake sf) {
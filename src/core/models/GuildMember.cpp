@@ -0,0 +1,218 @@
+#include "GuildMember.hpp"
+
+Snowflake GuildMember::GetUser() const
+{
+	return m_pTable->m_users[m_row];
+}
+
+const InternedString& GuildMember::GetNick() const
+{
+	return m_pTable->m_nicks[m_row];
+}
+
+void GuildMember::SetNick(const InternedString& nick)
+{
+	m_pTable->m_nicks[m_row] = nick;
+}
+
+const InternedString& GuildMember::GetAvatar() const
+{
+	return m_pTable->m_avatars[m_row];
+}
+
+void GuildMember::SetAvatar(const InternedString& avatar)
+{
+	m_pTable->m_avatars[m_row] = avatar;
+}
+
+const SmallSnowflakeSet& GuildMember::GetRoles() const
+{
+	return m_pTable->m_roles[m_row];
+}
+
+bool GuildMember::SetRoles(SmallSnowflakeSet&& roles)
+{
+	SmallSnowflakeSet& oldRoles = m_pTable->m_roles[m_row];
+	if (oldRoles == roles)
+		return false;
+
+	oldRoles = std::move(roles);
+	m_pTable->m_roleBitsGenerations[m_row] = 0;
+	return true;
+}
+
+time_t GuildMember::GetJoinedAt() const
+{
+	return m_pTable->m_joinedAt[m_row];
+}
+
+void GuildMember::SetJoinedAt(time_t joinedAt)
+{
+	m_pTable->m_joinedAt[m_row] = joinedAt;
+}
+
+static void SetFlag(uint8_t& flags, uint8_t flag, bool bSet)
+{
+	if (bSet)
+		flags |= flag;
+	else
+		flags &= ~flag;
+}
+
+bool GuildMember::IsLoadedFromChunk() const
+{
+	return (m_pTable->m_flags[m_row] & GuildMemberTable::FLAG_LOADED_FROM_CHUNK) != 0;
+}
+
+void GuildMember::SetLoadedFromChunk(bool bLoaded)
+{
+	SetFlag(m_pTable->m_flags[m_row], GuildMemberTable::FLAG_LOADED_FROM_CHUNK, bLoaded);
+}
+
+bool GuildMember::Exists() const
+{
+	return (m_pTable->m_flags[m_row] & GuildMemberTable::FLAG_DOESNT_EXIST) == 0;
+}
+
+void GuildMember::SetExists(bool bExists)
+{
+	SetFlag(m_pTable->m_flags[m_row], GuildMemberTable::FLAG_DOESNT_EXIST, !bExists);
+}
+
+bool GuildMember::IsGroup() const
+{
+	return (m_pTable->m_flags[m_row] & GuildMemberTable::FLAG_GROUP) != 0;
+}
+
+void GuildMember::SetGroup(bool bIsGroup)
+{
+	SetFlag(m_pTable->m_flags[m_row], GuildMemberTable::FLAG_GROUP, bIsGroup);
+}
+
+Snowflake GuildMember::GetGroupId() const
+{
+	return m_pTable->m_groupIds[m_row];
+}
+
+void GuildMember::SetGroupId(Snowflake groupId)
+{
+	m_pTable->m_groupIds[m_row] = groupId;
+}
+
+int GuildMember::GetGroupCount() const
+{
+	const int* pCount = m_pTable->m_groupCounts.Find(GetUser());
+	return pCount ? *pCount : 0;
+}
+
+void GuildMember::SetGroupCount(int count)
+{
+	m_pTable->m_groupCounts.Insert(GetUser(), count);
+}
+
+GuildMember GuildMemberTable::Find(Snowflake user)
+{
+	const uint32_t* pRow = m_rows.Find(user);
+	return pRow ? GuildMember(this, *pRow) : GuildMember();
+}
+
+GuildMember GuildMemberTable::Lookup(Snowflake user)
+{
+	GuildMember member = Find(user);
+	if (member.IsValid())
+		return member;
+
+	uint32_t row = AddRow(user);
+	m_rows.Insert(user, row);
+	return GuildMember(this, row);
+}
+
+void GuildMemberTable::Remove(Snowflake user)
+{
+	const uint32_t* pRow = m_rows.Find(user);
+	if (!pRow)
+		return;
+
+	uint32_t row = *pRow;
+	m_rows.Erase(user);
+	m_groupCounts.Erase(user);
+
+	m_users[row] = 0;
+	m_nicks[row] = InternedString();
+	m_avatars[row] = InternedString();
+	m_roles[row].clear();
+	m_joinedAt[row] = 0;
+	m_flags[row] = 0;
+	m_groupIds[row] = 0;
+	m_roleBitsGenerations[row] = 0;
+	m_freeRows.push_back(row);
+}
+
+void GuildMemberTable::ClearMarks()
+{
+	for (auto& flags : m_flags)
+		flags &= ~FLAG_MARKED;
+}
+
+void GuildMemberTable::Mark(Snowflake user)
+{
+	const uint32_t* pRow = m_rows.Find(user);
+	if (pRow)
+		m_flags[*pRow] |= FLAG_MARKED;
+}
+
+size_t GuildMemberTable::RemoveUnmarked()
+{
+	std::vector<Snowflake> unmarked;
+	m_rows.ForEach([&](Snowflake user, uint32_t row) {
+		if ((m_flags[row] & FLAG_MARKED) == 0)
+			unmarked.push_back(user);
+	});
+
+	for (Snowflake user : unmarked)
+		Remove(user);
+
+	return unmarked.size();
+}
+
+uint32_t GuildMemberTable::AddRow(Snowflake user)
+{
+	if (!m_freeRows.empty())
+	{
+		uint32_t row = m_freeRows.back();
+		m_freeRows.pop_back();
+		m_users[row] = user;
+		return row;
+	}
+
+	m_users.push_back(user);
+	m_nicks.push_back(InternedString());
+	m_avatars.push_back(InternedString());
+	m_roles.push_back(SmallSnowflakeSet());
+	m_joinedAt.push_back(0);
+	m_flags.push_back(0);
+	m_groupIds.push_back(0);
+	m_roleBits.push_back(RoleBitset());
+	m_roleBitsGenerations.push_back(0);
+	return uint32_t(m_users.size() - 1);
+}
+
+size_t GuildMemberTable::GetMemoryUsage() const
+{
+	size_t size = m_rows.GetMemoryUsage() + m_groupCounts.GetMemoryUsage();
+	size += m_users.capacity() * sizeof(Snowflake);
+	size += m_nicks.capacity() * sizeof(InternedString);
+	size += m_avatars.capacity() * sizeof(InternedString);
+	size += m_roles.capacity() * sizeof(SmallSnowflakeSet);
+	size += m_joinedAt.capacity() * sizeof(time_t);
+	size += m_flags.capacity() * sizeof(uint8_t);
+	size += m_groupIds.capacity() * sizeof(Snowflake);
+	size += m_roleBits.capacity() * sizeof(RoleBitset);
+	size += m_roleBitsGenerations.capacity() * sizeof(uint32_t);
+	size += m_freeRows.capacity() * sizeof(uint32_t);
+
+	for (auto& roles : m_roles)
+		size += roles.GetMemoryUsage();
+
+	return size;
+}
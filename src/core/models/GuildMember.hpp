@@ -1,25 +1,146 @@
 #pragma once
+#include <ctime>
 #include <string>
 #include <vector>
 #include "Snowflake.hpp"
+#include "SnowflakeMap.hpp"
+#include "SmallSnowflakeSet.hpp"
+#include "RoleBitset.hpp"
+#include "../utils/InternedString.hpp"
 
-struct GuildMember
+class GuildMemberTable;
+
+// A handle to a member's row in a GuildMemberTable.  Stays valid as long as
+// the table does, even when more members are added to it.
+//
+// Groups of the member list are stored as members too, with the group's ID
+// as their snowflake.
+class GuildMember
+{
+public:
+	GuildMember() {}
+	GuildMember(GuildMemberTable* pTable, uint32_t row) : m_pTable(pTable), m_row(row) {}
+
+	bool IsValid() const {
+		return m_pTable != nullptr;
+	}
+
+	Snowflake GetUser() const;
+
+	const InternedString& GetNick() const;
+	void SetNick(const InternedString& nick);
+
+	const InternedString& GetAvatar() const;
+	void SetAvatar(const InternedString& avatar);
+
+	const SmallSnowflakeSet& GetRoles() const;
+	// Returns true if the roles changed.
+	bool SetRoles(SmallSnowflakeSet&& roles);
+
+	time_t GetJoinedAt() const;
+	void SetJoinedAt(time_t joinedAt);
+
+	bool IsLoadedFromChunk() const;
+	void SetLoadedFromChunk(bool bLoaded);
+
+	bool Exists() const;
+	void SetExists(bool bExists);
+
+	bool IsGroup() const;
+	void SetGroup(bool bIsGroup);
+
+	// The group a member is listed under, or the ID of a group.
+	Snowflake GetGroupId() const;
+	void SetGroupId(Snowflake groupId);
+
+	// The amount of members in a group.
+	int GetGroupCount() const;
+	void SetGroupCount(int count);
+
+private:
+	friend struct Guild;
+
+	GuildMemberTable* m_pTable = nullptr;
+	uint32_t m_row = 0;
+};
+
+// The known members of one guild.  Each field is stored in its own array,
+// indexed by the member's row, so the fields that are scanned together stay
+// together and a member costs no allocations beyond what its roles need.
+class GuildMemberTable
 {
-	bool m_bIsGroup = false;
-	bool m_bExists = true; //assumption
-
-	// if group
-	Snowflake m_groupId = 0;
-	int m_groupCount = 0;
-
-	// if user
-	Snowflake m_user = 0;
-	std::vector<Snowflake> m_roles;
-	std::string m_avatar;
-	std::string m_nick;
-	std::string m_status;
-	std::string m_pronouns;
-	std::string m_bio;
-	time_t m_joinedAt = 0;
-	bool m_bIsLoadedFromChunk = false;
+public:
+	GuildMemberTable(Snowflake guild) : m_guild(guild) {}
+
+	Snowflake GetGuild() const {
+		return m_guild;
+	}
+
+	size_t Size() const {
+		return m_rows.Size();
+	}
+
+	// Returns an invalid handle if the user isn't in the table.
+	GuildMember Find(Snowflake user);
+
+	// Adds the user to the table if needed.
+	GuildMember Lookup(Snowflake user);
+
+	// Removes the user from the table.  Their row is reused by the next
+	// member added, so handles to it must not be used afterwards.
+	void Remove(Snowflake user);
+
+	// Used by the ProfileCache to evict the members no one uses: unmark all
+	// members, mark the ones in use, then remove the rest.
+	void ClearMarks();
+	void Mark(Snowflake user);
+	size_t RemoveUnmarked();
+
+	// Calls func with the snowflake of each member.
+	template <typename Func>
+	void ForEachUser(Func func) const
+	{
+		m_rows.ForEach([&](Snowflake user, uint32_t) {
+			func(user);
+		});
+	}
+
+	size_t GetMemoryUsage() const;
+
+private:
+	friend class GuildMember;
+	friend struct Guild;
+
+	uint32_t AddRow(Snowflake user);
+
+	enum
+	{
+		FLAG_LOADED_FROM_CHUNK = (1 << 0),
+		FLAG_DOESNT_EXIST      = (1 << 1),
+		FLAG_GROUP             = (1 << 2),
+		FLAG_MARKED            = (1 << 3),
+	};
+
+	Snowflake m_guild;
+
+	// Maps a user's snowflake to their row.
+	SnowflakeMap<uint32_t> m_rows;
+
+	std::vector<Snowflake> m_users;
+	std::vector<InternedString> m_nicks;
+	std::vector<InternedString> m_avatars;
+	std::vector<SmallSnowflakeSet> m_roles;
+	std::vector<time_t> m_joinedAt;
+	std::vector<uint8_t> m_flags;
+	std::vector<Snowflake> m_groupIds;
+
+	// Built by Guild::GetMemberRoles.
+	std::vector<RoleBitset> m_roleBits;
+	std::vector<uint32_t> m_roleBitsGenerations;
+
+	// The member counts of groups, by group ID.
+	SnowflakeMap<int> m_groupCounts;
+
+	// Rows of removed members.
+	std::vector<uint32_t> m_freeRows;
 };
@@ -0,0 +1,240 @@
+#include <cassert>
+#include "MemberListTree.hpp"
+
+Snowflake MemberListTree::Get(size_t index) const
+{
+	return m_nodes[FindNode(index)].m_sf;
+}
+
+bool MemberListTree::IsGroup(size_t index) const
+{
+	return m_nodes[FindNode(index)].m_bIsGroup;
+}
+
+void MemberListTree::Insert(size_t index, Snowflake sf, bool bIsGroup)
+{
+	assert(index <= Size());
+
+	// N.B. Allocate first, the split below holds on to node indices only.
+	int node = NewNode(sf, bIsGroup);
+
+	int left, right;
+	Split(m_root, index, left, right);
+	m_root = Merge(Merge(left, node), right);
+}
+
+void MemberListTree::Erase(size_t index)
+{
+	assert(index < Size());
+
+	int left, middle, right;
+	Split(m_root, index, left, right);
+	Split(right, 1, middle, right);
+
+	m_freeNodes.push_back(middle);
+	m_root = Merge(left, right);
+}
+
+void MemberListTree::Set(size_t index, Snowflake sf, bool bIsGroup)
+{
+	int left, middle, right;
+	Split(m_root, index, left, right);
+	Split(right, 1, middle, right);
+
+	assert(middle >= 0);
+	m_nodes[middle].m_sf = sf;
+	m_nodes[middle].m_bIsGroup = bIsGroup;
+	Recount(middle);
+
+	m_root = Merge(Merge(left, middle), right);
+}
+
+void MemberListTree::Clear()
+{
+	m_nodes.clear();
+	m_freeNodes.clear();
+	m_root = -1;
+}
+
+Snowflake MemberListTree::GetGroupAt(size_t index) const
+{
+	size_t groups = CountGroupsBefore(index + 1);
+	if (groups == 0)
+		return 0;
+
+	return Get(FindGroup(groups - 1));
+}
+
+size_t MemberListTree::FindNextGroup(size_t index) const
+{
+	return FindGroup(CountGroupsBefore(index));
+}
+
+size_t MemberListTree::CountGroupsBefore(size_t index) const
+{
+	size_t groups = 0;
+	int node = m_root;
+	while (node >= 0)
+	{
+		const Node& n = m_nodes[node];
+		size_t leftSize = SizeOf(n.m_left);
+		if (index <= leftSize) {
+			node = n.m_left;
+			continue;
+		}
+
+		groups += GroupsOf(n.m_left) + (n.m_bIsGroup ? 1 : 0);
+		index -= leftSize + 1;
+		node = n.m_right;
+	}
+
+	return groups;
+}
+
+size_t MemberListTree::FindMember(size_t rank) const
+{
+	size_t pos = 0;
+	int node = m_root;
+	while (node >= 0)
+	{
+		const Node& n = m_nodes[node];
+		size_t leftMembers = SizeOf(n.m_left) - GroupsOf(n.m_left);
+		if (rank < leftMembers) {
+			node = n.m_left;
+			continue;
+		}
+
+		if (!n.m_bIsGroup && rank == leftMembers)
+			return pos + SizeOf(n.m_left);
+
+		rank -= leftMembers + (n.m_bIsGroup ? 0 : 1);
+		pos += SizeOf(n.m_left) + 1;
+		node = n.m_right;
+	}
+
+	return Size();
+}
+
+int MemberListTree::FindNode(size_t index) const
+{
+	assert(index < Size());
+
+	int node = m_root;
+	while (true)
+	{
+		const Node& n = m_nodes[node];
+		size_t leftSize = SizeOf(n.m_left);
+		if (index == leftSize)
+			return node;
+
+		if (index < leftSize) {
+			node = n.m_left;
+		}
+		else {
+			index -= leftSize + 1;
+			node = n.m_right;
+		}
+	}
+}
+
+size_t MemberListTree::FindGroup(size_t rank) const
+{
+	size_t pos = 0;
+	int node = m_root;
+	while (node >= 0)
+	{
+		const Node& n = m_nodes[node];
+		size_t leftGroups = GroupsOf(n.m_left);
+		if (rank < leftGroups) {
+			node = n.m_left;
+			continue;
+		}
+
+		if (n.m_bIsGroup && rank == leftGroups)
+			return pos + SizeOf(n.m_left);
+
+		rank -= leftGroups + (n.m_bIsGroup ? 1 : 0);
+		pos += SizeOf(n.m_left) + 1;
+		node = n.m_right;
+	}
+
+	return Size();
+}
+
+int MemberListTree::NewNode(Snowflake sf, bool bIsGroup)
+{
+	int node;
+	if (!m_freeNodes.empty()) {
+		node = m_freeNodes.back();
+		m_freeNodes.pop_back();
+	}
+	else {
+		node = int(m_nodes.size());
+		m_nodes.push_back(Node());
+	}
+
+	m_seed ^= m_seed << 13;
+	m_seed ^= m_seed >> 17;
+	m_seed ^= m_seed << 5;
+
+	Node& n = m_nodes[node];
+	n = Node();
+	n.m_sf = sf;
+	n.m_bIsGroup = bIsGroup;
+	n.m_priority = m_seed;
+	Recount(node);
+	return node;
+}
+
+void MemberListTree::Recount(int node)
+{
+	Node& n = m_nodes[node];
+	n.m_size   = uint32_t(1 + SizeOf(n.m_left) + SizeOf(n.m_right));
+	n.m_groups = uint32_t((n.m_bIsGroup ? 1 : 0) + GroupsOf(n.m_left) + GroupsOf(n.m_right));
+}
+
+void MemberListTree::Split(int node, size_t count, int& left, int& right)
+{
+	if (node < 0) {
+		left = right = -1;
+		return;
+	}
+
+	size_t leftSize = SizeOf(m_nodes[node].m_left);
+	if (count <= leftSize) {
+		int l, r;
+		Split(m_nodes[node].m_left, count, l, r);
+		m_nodes[node].m_left = r;
+		left = l;
+		right = node;
+	}
+	else {
+		int l, r;
+		Split(m_nodes[node].m_right, count - leftSize - 1, l, r);
+		m_nodes[node].m_right = l;
+		left = node;
+		right = r;
+	}
+
+	Recount(node);
+}
+
+int MemberListTree::Merge(int left, int right)
+{
+	if (left < 0)
+		return right;
+	if (right < 0)
+		return left;
+
+	if (m_nodes[left].m_priority > m_nodes[right].m_priority) {
+		int merged = Merge(m_nodes[left].m_right, right);
+		m_nodes[left].m_right = merged;
+		Recount(left);
+		return left;
+	}
+
+	int merged = Merge(left, m_nodes[right].m_left);
+	m_nodes[right].m_left = merged;
+	Recount(right);
+	return right;
+}
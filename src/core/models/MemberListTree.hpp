@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Snowflake.hpp"
+
+// The entries of a guild's lazy member list: members, and the group headers
+// that they are listed under.  Stored as an implicit treap, i.e. a balanced
+// tree ordered by position instead of by key.  Each node knows how many
+// entries, and how many group headers, its subtree holds, so inserting and
+// erasing at a position, and finding the group an entry belongs to, take
+// O(log n) instead of moving or walking the whole list.
+//
+// The nodes live in one array and refer to each other by index.
+class MemberListTree
+{
+public:
+	size_t Size() const {
+		return SizeOf(m_root);
+	}
+	bool Empty() const {
+		return m_root < 0;
+	}
+
+	Snowflake Get(size_t index) const;
+	bool IsGroup(size_t index) const;
+
+	void Insert(size_t index, Snowflake sf, bool bIsGroup);
+	void Erase(size_t index);
+	void Set(size_t index, Snowflake sf, bool bIsGroup);
+	void Clear();
+
+	// Gets the group header the entry at this position is listed under, or 0
+	// if there is none before it.  A group header is listed under itself.
+	Snowflake GetGroupAt(size_t index) const;
+
+	// Gets the position of the first group header at or after this position,
+	// or Size() if there is none.
+	size_t FindNextGroup(size_t index) const;
+
+	// Gets the amount of group headers before this position.
+	size_t CountGroupsBefore(size_t index) const;
+
+	// Gets the position of the entry that is the rank-th member, not counting
+	// group headers, or Size() if there are fewer members.
+	size_t FindMember(size_t rank) const;
+
+	// Calls func with the position, snowflake and group flag of each entry in
+	// [start, end), in order.  The tree must not be changed while doing so.
+	template <typename Func>
+	void ForEachInRange(size_t start, size_t end, Func func) const
+	{
+		if (start < end)
+			ForEachInRange(m_root, 0, start, end, func);
+	}
+
+	// Calls func with the snowflake and group flag of each entry, in order.
+	template <typename Func>
+	void ForEach(Func func) const
+	{
+		ForEachInRange(0, Size(), [&](size_t, Snowflake sf, bool bIsGroup) {
+			func(sf, bIsGroup);
+		});
+	}
+
+private:
+	struct Node
+	{
+		Snowflake m_sf = 0;
+		uint32_t m_priority = 0;
+		int m_left = -1;
+		int m_right = -1;
+		uint32_t m_size = 1;   // entries in the subtree
+		uint32_t m_groups = 0; // group headers in the subtree
+		bool m_bIsGroup = false;
+	};
+
+	size_t SizeOf(int node) const {
+		return node < 0 ? 0 : m_nodes[node].m_size;
+	}
+	size_t GroupsOf(int node) const {
+		return node < 0 ? 0 : m_nodes[node].m_groups;
+	}
+
+	// Gets the node at this position.  The position must be in the tree.
+	int FindNode(size_t index) const;
+
+	// Gets the position of the group header with this rank, or Size().
+	size_t FindGroup(size_t rank) const;
+
+	int NewNode(Snowflake sf, bool bIsGroup);
+	void Recount(int node);
+
+	// Splits the subtree into its first 'count' entries and the rest.
+	void Split(int node, size_t count, int& left, int& right);
+	int Merge(int left, int right);
+
+	template <typename Func>
+	void ForEachInRange(int node, size_t offset, size_t start, size_t end, Func& func) const
+	{
+		if (node < 0)
+			return;
+
+		const Node& n = m_nodes[node];
+		size_t pos = offset + SizeOf(n.m_left);
+
+		if (start < pos)
+			ForEachInRange(n.m_left, offset, start, end, func);
+
+		if (start <= pos && pos < end)
+			func(pos, n.m_sf, n.m_bIsGroup);
+
+		if (pos + 1 < end)
+			ForEachInRange(n.m_right, pos + 1, start, end, func);
+	}
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_freeNodes;
+	int m_root = -1;
+
+	// State of the xorshift generator that picks node priorities.
+	uint32_t m_seed = 2463534242u;
+};
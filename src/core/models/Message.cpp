@@ -1,6 +1,7 @@
 #include "Message.hpp"
 #include "../DiscordInstance.hpp"
 #include "../utils/Util.hpp"
+#include "../utils/TimeFormatCache.hpp"
 
 using Json = nlohmann::json;
 
@@ -17,10 +18,11 @@ void Message::SetDate(const std::string & dateStr)
 
 void Message::SetTime(time_t t)
 {
+	TimeFormatCache* pCache = GetTimeFormatCache();
 	m_dateTime = t;
-	m_dateFull = FormatTimeLong(m_dateTime, true);
-	m_dateCompact = FormatTimeShorter(m_dateTime);
-	m_dateOnly = FormatDate(m_dateTime);
+	m_dateFull = pCache->FormatTimeLong(m_dateTime);
+	m_dateCompact = pCache->FormatTimeShorter(m_dateTime);
+	m_dateOnly = pCache->FormatDate(m_dateTime);
 }
 
 void Message::SetDateEdited(const std::string& dateStr)
@@ -37,7 +39,7 @@ void Message::SetDateEdited(const std::string& dateStr)
 void Message::SetTimeEdited(time_t t)
 {
 	m_timeEdited = t;
-	m_editedText = "(edited " + FormatTimeLong(m_timeEdited, true) + ")";
+	m_editedText = "(edited " + GetTimeFormatCache()->FormatTimeLong(m_timeEdited) + ")";
 	m_editedTextCompact = "(edited)";
 }
 
@@ -60,6 +62,163 @@ void Message::UpdateTimestamp()
 		m_editedText = m_editedTextCompact = "";
 }
 
+// Rough estimate of the heap used by a string.  Short strings are stored in
+// the string object itself.
+static size_t StringUsage(const std::string& str)
+{
+	return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+// Like GetFieldSafe, but doesn't copy the string.
+static const std::string& GetStringRef(const Json& j, const char* key)
+{
+	static const std::string empty;
+
+	auto iter = j.find(key);
+	if (iter == j.end() || !iter->is_string())
+		return empty;
+
+	return iter->get_ref<const std::string&>();
+}
+
+// N.B. Interned strings are shared between messages, so they aren't counted.
+
+size_t Message::GetMemoryUsage() const
+{
+	size_t size = sizeof(Message);
+
+	size += StringUsage(m_message);
+	size += m_userMentions.GetMemoryUsage();
+	size += m_roleMentions.GetMemoryUsage();
+
+	if (m_pExtras)
+		size += m_pExtras->GetMemoryUsage();
+
+	if (m_pReferencedMessage)
+	{
+		size += sizeof(ReferenceMessage);
+		size += StringUsage(m_pReferencedMessage->m_message);
+		size += m_pReferencedMessage->m_userMentions.GetMemoryUsage();
+	}
+
+	return size;
+}
+
+size_t MessageExtras::GetMemoryUsage() const
+{
+	size_t size = sizeof(MessageExtras) + m_data.capacity();
+
+	size += m_attachments.capacity() * sizeof(Attachment);
+	for (auto& att : m_attachments)
+		size += StringUsage(att.m_fileName) + StringUsage(att.m_proxyUrl) + StringUsage(att.m_actualUrl);
+
+	size += m_embeds.capacity() * sizeof(RichEmbed);
+	for (auto& emb : m_embeds)
+	{
+		size += StringUsage(emb.m_typeStr) + StringUsage(emb.m_title) + StringUsage(emb.m_url) + StringUsage(emb.m_description);
+		size += StringUsage(emb.m_footerText);
+		size += StringUsage(emb.m_imageUrl) + StringUsage(emb.m_imageProxiedUrl);
+		size += StringUsage(emb.m_thumbnailUrl) + StringUsage(emb.m_thumbnailProxiedUrl);
+
+		size += emb.m_fields.capacity() * sizeof(RichEmbedField);
+		for (auto& field : emb.m_fields)
+			size += StringUsage(field.m_title) + StringUsage(field.m_value);
+	}
+
+	if (m_pPoll)
+	{
+		size += sizeof(MessagePoll) + StringUsage(m_pPoll->m_question);
+		size += m_pPoll->m_options.size() * (sizeof(MessagePollOption) + 4 * sizeof(void*));
+	}
+
+	return size;
+}
+
+MessageExtras::MessageExtras(const Json& data)
+{
+	m_data = Json::to_msgpack(data);
+}
+
+Json MessageExtras::Decode() const
+{
+	Json data = Json::from_msgpack(m_data, true, false);
+	if (!data.is_object())
+		return Json::object();
+
+	return data;
+}
+
+void MessageExtras::DecodeIfNeeded()
+{
+	if (m_bDecoded)
+		return;
+
+	m_bDecoded = true;
+	Json data = Decode();
+
+	if (data["attachments"].is_array())
+	{
+		m_attachments.reserve(data["attachments"].size());
+		for (auto& attd : data["attachments"])
+		{
+			Attachment att;
+			att.Load(attd);
+			m_attachments.push_back(att);
+		}
+	}
+
+	if (data["embeds"].is_array())
+	{
+		m_embeds.reserve(data["embeds"].size());
+		for (auto& embd : data["embeds"])
+		{
+			RichEmbed emb;
+			emb.Load(embd);
+			m_embeds.push_back(emb);
+		}
+	}
+
+	if (data.contains("poll"))
+		m_pPoll = std::make_shared<MessagePoll>(data["poll"]);
+}
+
+const std::vector<Attachment>& MessageExtras::GetAttachments()
+{
+	DecodeIfNeeded();
+	return m_attachments;
+}
+
+const std::vector<RichEmbed>& MessageExtras::GetEmbeds()
+{
+	DecodeIfNeeded();
+	return m_embeds;
+}
+
+const std::shared_ptr<MessagePoll>& MessageExtras::GetPoll()
+{
+	DecodeIfNeeded();
+	return m_pPoll;
+}
+
+static const std::vector<Attachment> g_noAttachments;
+static const std::vector<RichEmbed> g_noEmbeds;
+static const std::shared_ptr<MessagePoll> g_noPoll;
+
+const std::vector<Attachment>& Message::GetAttachments() const
+{
+	return m_pExtras ? m_pExtras->GetAttachments() : g_noAttachments;
+}
+
+const std::vector<RichEmbed>& Message::GetEmbeds() const
+{
+	return m_pExtras ? m_pExtras->GetEmbeds() : g_noEmbeds;
+}
+
+const std::shared_ptr<MessagePoll>& Message::GetPoll() const
+{
+	return m_pExtras ? m_pExtras->GetPoll() : g_noPoll;
+}
+
 bool Message::CheckWasMentioned(Snowflake user, Snowflake guild, bool bSuppressEveryone, bool bSuppressRoles) const
 {
 	if (GetDiscordInstance()->IsUserBlocked(user))
@@ -74,17 +233,18 @@ bool Message::CheckWasMentioned(Snowflake user, Snowflake guild, bool bSuppressE
 	if (!guild)
 		return false;
 
-	Profile* pf = GetProfileCache()->LookupProfile(user, "", "", "", false);
-	if (!pf->HasGuildMemberProfile(guild))
+	GuildMember gm = GetProfileCache()->FindGuildMember(user, guild);
+	if (!gm.IsValid())
 		return false;
 
-	if (!bSuppressRoles)
+	if (!bSuppressRoles && !m_roleMentions.empty())
 	{
-		GuildMember* gm = &pf->m_guildMembers[guild];
-		for (auto role : gm->m_roles) {
-			if (m_roleMentions.find(role) != m_roleMentions.end())
-				return true;
-		}
+		Guild* pGuild = GetDiscordInstance()->GetGuild(guild);
+		if (!pGuild)
+			return false;
+
+		if (pGuild->GetRoleBitset(m_roleMentions).Intersects(pGuild->GetMemberRoles(gm)))
+			return true;
 	}
 
 	return false;
@@ -231,8 +391,6 @@ void Message::Load(Json& data, Snowflake guild)
 {
 	Json& author = data["author"];
 
-	m_pMessagePoll.reset();
-
 	Snowflake messageId = GetSnowflake(data, "id");
 
 	Snowflake authorId = m_author_snowflake;
@@ -253,10 +411,10 @@ void Message::Load(Json& data, Snowflake guild)
 		m_message = GetFieldSafe(data, "content");
 
 	if (data.contains("timestamp"))
-		SetDate(GetFieldSafe(data, "timestamp"));
+		SetDate(GetStringRef(data, "timestamp"));
 
 	if (data.contains("edited_timestamp"))
-		SetDateEdited(GetFieldSafe(data, "edited_timestamp"));
+		SetDateEdited(GetStringRef(data, "edited_timestamp"));
 
 	if (data.contains("type"))
 		m_type = (MessageType::eType)data["type"];
@@ -278,6 +436,10 @@ void Message::Load(Json& data, Snowflake guild)
 	m_snowflake = messageId;
 	m_author_snowflake = authorId;
 
+	// If the timestamp is missing or invalid, use the time the snowflake was made at.
+	if (!m_dateTime && m_snowflake)
+		SetTime(time_t(ExtractTimestamp(m_snowflake) / 1000));
+
 	m_author = authorName;
 	m_avatar = avatar;
 	m_bIsAuthorBot = isBot;
@@ -291,33 +453,18 @@ void Message::Load(Json& data, Snowflake guild)
 	if (data["pinned"].is_boolean())
 		m_bIsPinned = data["pinned"];
 
-	if (data["attachments"].is_array())
-	{
-		m_attachments.clear();
-		for (auto& attd : data["attachments"])
-		{
-			Attachment att;
-			att.Load(attd);
-			m_attachments.push_back(att);
-		}
-	}
+	Json& msgRef = data["message_reference"];
+	Json& refdMsg = data["referenced_message"];
 
-	if (data["embeds"].is_array())
-	{
-		m_embeds.clear();
-		for (auto& attd : data["embeds"])
-		{
-			RichEmbed emb;
-			emb.Load(attd);
-			m_embeds.push_back(emb);
-		}
+	// The attachments and embeds of a forwarded message are shown as its own.
+	Json* pSnapshot = nullptr;
+	if (!msgRef.is_null() && GetFieldSafeInt(msgRef, "type") == 1) {
+		Json& msgShots = data["message_snapshots"];
+		if (msgShots.is_array() && msgShots.size() != 0)
+			pSnapshot = &msgShots[0]["message"];
 	}
 
-	if (data.contains("poll"))
-		m_pMessagePoll = std::make_shared<MessagePoll>(data["poll"]);
-
-	Json& msgRef = data["message_reference"];
-	Json& refdMsg = data["referenced_message"];
+	LoadExtras(data, pSnapshot);
 
 	if (!msgRef.is_null())
 	{
@@ -376,28 +523,6 @@ void Message::Load(Json& data, Snowflake guild)
 					rMsg.m_userMentions.insert(id);
 				}
 			}
-
-			// TODO: This sucks, but I'll allow it for now.
-			if (msgShot["attachments"].is_array())
-			{
-				for (auto& attd : msgShot["attachments"])
-				{
-					Attachment att;
-					att.Load(attd);
-					m_attachments.push_back(att);
-				}
-			}
-
-			if (msgShot["embeds"].is_array())
-			{
-				for (auto& attd : msgShot["embeds"])
-				{
-					RichEmbed emb;
-					emb.Load(attd);
-					m_embeds.push_back(emb);
-				}
-			}
-
 		}
 		else
 		{
@@ -439,3 +564,73 @@ void Message::Load(Json& data, Snowflake guild)
 	if (data["mention_everyone"].is_boolean())
 		m_bMentionedEveryone = data["mention_everyone"];
 }
+
+void Message::LoadExtras(Json& data, Json* pSnapshot)
+{
+	static const char* const fields[] = { "attachments", "embeds", "poll" };
+
+	bool bPresent[3];
+	bPresent[0] = data["attachments"].is_array();
+	bPresent[1] = data["embeds"].is_array();
+	bPresent[2] = data.contains("poll");
+
+	Json extras = Json::object();
+
+	// Updates may leave out any of the extras, in which case the old ones stay.
+	if (m_pExtras && (!bPresent[0] || !bPresent[1] || !bPresent[2]))
+	{
+		Json old = m_pExtras->Decode();
+		for (int i = 0; i < 3; i++) {
+			if (!bPresent[i] && old.contains(fields[i]))
+				extras[fields[i]] = std::move(old[fields[i]]);
+		}
+	}
+
+	// N.B. Unless a forwarded message's fields have to be appended to them, the
+	// fields are swapped out of the message data, and put back after encoding.
+	bool bSwap = pSnapshot == nullptr;
+	for (int i = 0; i < 3; i++)
+	{
+		if (!bPresent[i])
+			continue;
+
+		if (bSwap)
+			extras[fields[i]].swap(data[fields[i]]);
+		else
+			extras[fields[i]] = data[fields[i]];
+	}
+
+	if (pSnapshot)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			Json& snapField = (*pSnapshot)[fields[i]];
+			if (!snapField.is_array())
+				continue;
+
+			Json& field = extras[fields[i]];
+			if (!field.is_array())
+				field = Json::array();
+
+			for (auto& item : snapField)
+				field.push_back(item);
+		}
+	}
+
+	// Most messages have no attachments or embeds, so don't keep empty lists around.
+	bool bEmpty = true;
+	for (auto& field : extras.items()) {
+		if (!field.value().is_array() || !field.value().empty())
+			bEmpty = false;
+	}
+
+	m_pExtras = bEmpty ? nullptr : std::make_shared<MessageExtras>(extras);
+
+	if (bSwap)
+	{
+		for (int i = 0; i < 3; i++) {
+			if (bPresent[i])
+				extras[fields[i]].swap(data[fields[i]]);
+		}
+	}
+}
@@ -6,8 +6,11 @@
 #include <memory>
 #include <nlohmann/json.h>
 #include "Snowflake.hpp"
+#include "SmallSnowflakeSet.hpp"
 #include "Attachment.hpp"
 #include "MessageType.hpp"
+#include "../utils/InternedString.hpp"
+#include "../utils/FixedPool.hpp"
 #include "../network/MessagePoll.hpp"
 
 // XXX: Ok, I'm going to be cheap here and implement a separate class for the referenced message stuff.
@@ -18,15 +21,15 @@ struct ReferenceMessage
 	Snowflake m_author_snowflake = 0;
 	Snowflake m_webhook_id = 0;
 	std::string m_message;
-	std::string m_author;
-	std::string m_avatar;
+	InternedString m_author;
+	InternedString m_avatar;
 	time_t m_timestamp;
 	bool m_bHasAttachments = false;
 	bool m_bHasComponents = false;
 	bool m_bHasEmbeds = false;
 	bool m_bMentionsAuthor = false;
 	bool m_bIsAuthorBot = false;
-	std::set<Snowflake> m_userMentions;
+	SmallSnowflakeSet m_userMentions;
 
 	void Load(nlohmann::json& msgData, Snowflake guild);
 };
@@ -57,17 +60,17 @@ struct RichEmbed
 	std::string m_url;
 	std::string m_description;
 	// author
-	std::string m_providerName;
-	std::string m_providerUrl;
+	InternedString m_providerName;
+	InternedString m_providerUrl;
 	// author
-	std::string m_authorName;
-	std::string m_authorUrl;
-	std::string m_authorIconUrl;
-	std::string m_authorIconProxiedUrl;
+	InternedString m_authorName;
+	InternedString m_authorUrl;
+	InternedString m_authorIconUrl;
+	InternedString m_authorIconProxiedUrl;
 	// footer text
 	std::string m_footerText;
-	std::string m_footerIconUrl;
-	std::string m_footerIconProxiedUrl;
+	InternedString m_footerIconUrl;
+	InternedString m_footerIconProxiedUrl;
 	// shared between images and videos
 	bool m_bHasImage = false;
 	std::string m_imageUrl;
@@ -88,6 +91,40 @@ struct RichEmbed
 	void Load(nlohmann::json& j);
 };
 
+// The attachments, embeds and poll of a message.  These are only needed once
+// the message is drawn, so they're kept as MessagePack, and only decoded the
+// first time they're asked for.  Not changed after it's created, so messages
+// copied from one another can share it.
+class MessageExtras
+{
+public:
+	// Takes an object with any of the "attachments", "embeds" and "poll" fields
+	// of a message.
+	MessageExtras(const nlohmann::json& data);
+
+	nlohmann::json Decode() const;
+
+	bool IsDecoded() const {
+		return m_bDecoded;
+	}
+
+	const std::vector<Attachment>& GetAttachments();
+	const std::vector<RichEmbed>& GetEmbeds();
+	const std::shared_ptr<MessagePoll>& GetPoll();
+
+	// Estimates how much memory this takes up, in bytes.
+	size_t GetMemoryUsage() const;
+
+private:
+	void DecodeIfNeeded();
+
+	std::vector<uint8_t> m_data;
+	bool m_bDecoded = false;
+	std::vector<Attachment> m_attachments;
+	std::vector<RichEmbed> m_embeds;
+	std::shared_ptr<MessagePoll> m_pPoll;
+};
+
 class Message
 {
 public:
@@ -95,20 +132,19 @@ public:
 	Snowflake m_snowflake = 0;
 	Snowflake m_author_snowflake = 0;
 	std::string m_message = "";
-	std::string m_author = "";
-	std::string m_avatar = "";
+	InternedString m_author;
+	InternedString m_avatar;
 	Snowflake m_anchor = 0; // for gap messages
 	Snowflake m_nonce = 0; // to create messages
-	std::vector<Attachment> m_attachments;
-	std::string m_dateFull = "";
-	std::string m_dateCompact = "";
-	std::string m_dateOnly = "";
-	std::string m_editedText = "";
-	std::string m_editedTextCompact = "";
+	InternedString m_dateFull;
+	InternedString m_dateCompact;
+	InternedString m_dateOnly;
+	InternedString m_editedText;
+	InternedString m_editedTextCompact;
 	time_t m_dateTime = 0;
 	time_t m_timeEdited = 0;
-	std::set<Snowflake> m_userMentions;
-	std::set<Snowflake> m_roleMentions;
+	SmallSnowflakeSet m_userMentions;
+	SmallSnowflakeSet m_roleMentions;
 	bool m_bMentionedEveryone = false;
 	bool m_bIsAuthorBot = false;
 	bool m_bIsPinned = false;
@@ -117,9 +153,8 @@ public:
 	Snowflake m_refMessageGuild = 0;
 	Snowflake m_refMessageChannel = 0;
 	Snowflake m_refMessageSnowflake = 0;
-	std::vector<RichEmbed> m_embeds;
 	Snowflake m_webhookId = 0;
-	std::shared_ptr<MessagePoll> m_pMessagePoll;
+	std::shared_ptr<MessageExtras> m_pExtras; // null if there are no attachments, embeds or poll
 	std::shared_ptr<ReferenceMessage> m_pReferencedMessage;
 
 public:
@@ -142,6 +177,10 @@ public:
 		return m_pReferencedMessage && !m_bIsForward;
 	}
 
+	const std::vector<Attachment>& GetAttachments() const;
+	const std::vector<RichEmbed>& GetEmbeds() const;
+	const std::shared_ptr<MessagePoll>& GetPoll() const;
+
 public:
 	void SetDate(const std::string& dateStr);
 	void SetTime(time_t t);
@@ -149,17 +188,29 @@ public:
 	void SetTimeEdited(time_t t);
 	void UpdateTimestamp();
 
+	// Estimates how much memory this message takes up, in bytes.
+	size_t GetMemoryUsage() const;
+
 	bool CheckWasMentioned(Snowflake user, Snowflake guild, bool bSuppressEveryone = false, bool bSuppressRoles = false) const;
 
 	void Load(nlohmann::json& j, Snowflake guild);
+
+private:
+	void LoadExtras(nlohmann::json& data, nlohmann::json* pSnapshot);
 };
 
 typedef std::shared_ptr<Message> MessagePtr;
 
+// N.B. Messages are allocated from a pool, so that the messages of a page
+// sit together, and are freed together.
 static MessagePtr MakeMessage() {
-	return std::make_shared<Message>();
+	return std::allocate_shared<Message>(PoolAllocator<Message>());
 }
 
 static MessagePtr MakeMessage(const Message& msg) {
-	return std::make_shared<Message>(msg);
+	return std::allocate_shared<Message>(PoolAllocator<Message>(), msg);
+}
+
+static MessagePtr MakeMessage(Message&& msg) {
+	return std::allocate_shared<Message>(PoolAllocator<Message>(), std::move(msg));
 }
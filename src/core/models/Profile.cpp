@@ -2,6 +2,13 @@
 #include "../state/ProfileCache.hpp"
 #include "../utils/Util.hpp"
 
+// Rough estimate of the heap used by a string.  Short strings are stored in
+// the string object itself.
+static size_t StringUsage(const std::string& str)
+{
+	return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
 float Profile::FuzzyMatch(const char* check, Snowflake guild) const
 {
 	return std::max({
@@ -11,7 +18,39 @@ float Profile::FuzzyMatch(const char* check, Snowflake guild) const
 	});
 }
 
+bool Profile::HasGuildMemberProfile(Snowflake guild) const
+{
+	return GetProfileCache()->FindGuildMember(m_snowflake, guild).IsValid();
+}
+
+GuildMember Profile::GetGuildMember(Snowflake guild) const
+{
+	return GetProfileCache()->FindGuildMember(m_snowflake, guild);
+}
+
+std::string Profile::GetName(Snowflake guild) const
+{
+	GuildMember member = GetProfileCache()->FindGuildMember(m_snowflake, guild);
+	if (!member.IsValid() || member.GetNick().empty())
+		return m_globalName;
+
+	return member.GetNick();
+}
+
 void Profile::PutNote() const
 {
 	GetProfileCache()->PutNote(m_snowflake, m_note);
 }
+
+size_t Profile::GetMemoryUsage() const
+{
+	return sizeof(Profile) +
+		StringUsage(m_name) +
+		StringUsage(m_globalName) +
+		StringUsage(m_email) +
+		StringUsage(m_avatarlnk) +
+		StringUsage(m_note) +
+		StringUsage(m_bio) +
+		StringUsage(m_pronouns) +
+		StringUsage(m_status);
+}
@@ -31,8 +31,6 @@ struct Profile
 	eActiveStatus m_activeStatus = STATUS_OFFLINE;
 	std::string m_status = "";
 
-	std::map<Snowflake, GuildMember> m_guildMembers;
-
 	Profile() {}
 
 	Profile(Snowflake s, const std::string& name, int disc, const std::string& email) :
@@ -40,29 +38,14 @@ struct Profile
 	{
 	}
 
-	bool HasGuildMemberProfile(Snowflake guild) const {
-		auto fnd = m_guildMembers.find(guild);
-		return fnd != m_guildMembers.end();
-	}
+	// The user's membership in guilds is kept by the ProfileCache.
+	bool HasGuildMemberProfile(Snowflake guild) const;
+	GuildMember GetGuildMember(Snowflake guild) const;
 
-	std::string GetName(Snowflake guild) const {
-		auto it = m_guildMembers.find(guild);
-		if (it == m_guildMembers.end())
-			return m_globalName;
-		const GuildMember& gm = it->second;
-		if (gm.m_nick.empty())
-			return m_globalName;
-		return gm.m_nick;
-	}
+	std::string GetName(Snowflake guild) const;
 
 	std::string GetStatus(Snowflake guild) const {
-		auto it = m_guildMembers.find(guild);
-		if (it == m_guildMembers.end())
-			return m_status;
-		const GuildMember& gm = it->second;
-		if (gm.m_nick.empty())
-			return m_status;
-		return gm.m_status;
+		return m_status;
 	}
 
 	const std::string& GetUsername() const { return m_name; }
@@ -70,4 +53,7 @@ struct Profile
 
 	// Sends the Discord backend a request to either remove or set the note.
 	void PutNote() const;
+
+	// Estimated memory used by the profile, itself included.
+	size_t GetMemoryUsage() const;
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+// Maximum amount of roles in a guild that can be told apart by a RoleBitset.
+// Discord allows up to 250.
+#define C_MAX_GUILD_ROLES (256)
+
+// A set of roles of one guild, with one bit per role slot.  The slots are
+// assigned by the guild, see Guild::GetRoleSlot.
+class RoleBitset
+{
+public:
+	void Set(int slot) {
+		m_words[slot / 64] |= uint64_t(1) << (slot % 64);
+	}
+
+	bool Test(int slot) const {
+		return (m_words[slot / 64] & (uint64_t(1) << (slot % 64))) != 0;
+	}
+
+	void Clear() {
+		for (int i = 0; i < C_WORDS; i++)
+			m_words[i] = 0;
+	}
+
+	bool Empty() const {
+		uint64_t any = 0;
+		for (int i = 0; i < C_WORDS; i++)
+			any |= m_words[i];
+		return any == 0;
+	}
+
+	bool Intersects(const RoleBitset& oth) const {
+		uint64_t any = 0;
+		for (int i = 0; i < C_WORDS; i++)
+			any |= m_words[i] & oth.m_words[i];
+		return any != 0;
+	}
+
+	RoleBitset operator&(const RoleBitset& oth) const {
+		RoleBitset result;
+		for (int i = 0; i < C_WORDS; i++)
+			result.m_words[i] = m_words[i] & oth.m_words[i];
+		return result;
+	}
+
+	// Calls func with the slot of every role in the set, in ascending order.
+	template <typename Func>
+	void ForEach(Func func) const
+	{
+		for (int i = 0; i < C_WORDS; i++)
+		{
+			uint64_t word = m_words[i];
+			while (word)
+			{
+				uint64_t lowest = word & (~word + 1);
+				func(i * 64 + LowestBitIndex(lowest));
+				word ^= lowest;
+			}
+		}
+	}
+
+private:
+	enum { C_WORDS = C_MAX_GUILD_ROLES / 64 };
+
+	// Index of the only bit set in the value, using a de Bruijn sequence.
+	static int LowestBitIndex(uint64_t bit)
+	{
+		static const int table[64] = {
+			 0,  1,  2, 53,  3,  7, 54, 27,  4, 38, 41,  8, 34, 55, 48, 28,
+			62,  5, 39, 46, 44, 42, 22,  9, 24, 35, 59, 56, 49, 18, 29, 11,
+			63, 52,  6, 26, 37, 40, 33, 47, 61, 45, 43, 21, 23, 58, 17, 10,
+			51, 25, 36, 32, 60, 20, 57, 16, 50, 31, 19, 15, 30, 14, 13, 12,
+		};
+
+		return table[(bit * 0x022FDD63CC95386DULL) >> 58];
+	}
+
+	uint64_t m_words[C_WORDS] = {};
+};
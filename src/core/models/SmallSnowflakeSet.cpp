@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstring>
+#include "SmallSnowflakeSet.hpp"
+
+SmallSnowflakeSet::SmallSnowflakeSet(const SmallSnowflakeSet& oth)
+{
+	CopyFrom(oth);
+}
+
+SmallSnowflakeSet::SmallSnowflakeSet(SmallSnowflakeSet&& oth) noexcept
+{
+	*this = std::move(oth);
+}
+
+SmallSnowflakeSet::~SmallSnowflakeSet()
+{
+	Free();
+}
+
+SmallSnowflakeSet& SmallSnowflakeSet::operator=(const SmallSnowflakeSet& oth)
+{
+	if (this != &oth) {
+		Free();
+		CopyFrom(oth);
+	}
+
+	return *this;
+}
+
+SmallSnowflakeSet& SmallSnowflakeSet::operator=(SmallSnowflakeSet&& oth) noexcept
+{
+	if (this == &oth)
+		return *this;
+
+	Free();
+
+	if (oth.IsInline()) {
+		CopyFrom(oth);
+	}
+	else {
+		// Take over the other set's array.
+		m_pHeap = oth.m_pHeap;
+		m_size = oth.m_size;
+		m_capacity = oth.m_capacity;
+	}
+
+	oth.m_size = 0;
+	oth.m_capacity = C_SMALL_SET_INLINE;
+	return *this;
+}
+
+bool SmallSnowflakeSet::operator==(const SmallSnowflakeSet& oth) const
+{
+	if (m_size != oth.m_size)
+		return false;
+
+	return m_size == 0 || memcmp(Data(), oth.Data(), m_size * sizeof(Snowflake)) == 0;
+}
+
+void SmallSnowflakeSet::Free()
+{
+	if (!IsInline())
+		delete[] m_pHeap;
+
+	m_size = 0;
+	m_capacity = C_SMALL_SET_INLINE;
+}
+
+void SmallSnowflakeSet::CopyFrom(const SmallSnowflakeSet& oth)
+{
+	if (oth.m_size > C_SMALL_SET_INLINE) {
+		m_pHeap = new Snowflake[oth.m_size];
+		m_capacity = oth.m_size;
+	}
+
+	m_size = oth.m_size;
+	if (m_size)
+		memcpy(Data(), oth.Data(), m_size * sizeof(Snowflake));
+}
+
+SmallSnowflakeSet::const_iterator SmallSnowflakeSet::find(Snowflake sf) const
+{
+	const_iterator iter = std::lower_bound(begin(), end(), sf);
+	if (iter == end() || *iter != sf)
+		return end();
+
+	return iter;
+}
+
+bool SmallSnowflakeSet::insert(Snowflake sf)
+{
+	Snowflake* pData = Data();
+	Snowflake* pIter = std::lower_bound(pData, pData + m_size, sf);
+	size_t index = size_t(pIter - pData);
+
+	if (index < m_size && *pIter == sf)
+		return false;
+
+	if (m_size == m_capacity)
+	{
+		uint32_t capacity = m_capacity * 2;
+		Snowflake* pNewData = new Snowflake[capacity];
+		memcpy(pNewData, pData, m_size * sizeof(Snowflake));
+
+		if (!IsInline())
+			delete[] m_pHeap;
+
+		m_pHeap = pNewData;
+		m_capacity = capacity;
+		pData = pNewData;
+	}
+
+	memmove(pData + index + 1, pData + index, (m_size - index) * sizeof(Snowflake));
+	pData[index] = sf;
+	m_size++;
+	return true;
+}
+
+void SmallSnowflakeSet::clear()
+{
+	Free();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Snowflake.hpp"
+
+// Amount of snowflakes a SmallSnowflakeSet holds without allocating.
+#define C_SMALL_SET_INLINE (2)
+
+// A sorted set of snowflakes stored as a flat array.  The first few entries
+// are stored in the object itself, which covers almost every message's list
+// of mentions.  Has the parts of std::set's interface that are used.
+class SmallSnowflakeSet
+{
+public:
+	typedef const Snowflake* const_iterator;
+	typedef const_iterator iterator;
+
+	SmallSnowflakeSet() {}
+	SmallSnowflakeSet(const SmallSnowflakeSet& oth);
+	SmallSnowflakeSet(SmallSnowflakeSet&& oth) noexcept;
+	~SmallSnowflakeSet();
+
+	SmallSnowflakeSet& operator=(const SmallSnowflakeSet& oth);
+	SmallSnowflakeSet& operator=(SmallSnowflakeSet&& oth) noexcept;
+
+	bool operator==(const SmallSnowflakeSet& oth) const;
+	bool operator!=(const SmallSnowflakeSet& oth) const {
+		return !(*this == oth);
+	}
+
+	const_iterator begin() const {
+		return Data();
+	}
+	const_iterator end() const {
+		return Data() + m_size;
+	}
+	size_t size() const {
+		return m_size;
+	}
+	bool empty() const {
+		return m_size == 0;
+	}
+	size_t count(Snowflake sf) const {
+		return find(sf) != end() ? 1 : 0;
+	}
+
+	const_iterator find(Snowflake sf) const;
+	bool insert(Snowflake sf);
+	void clear();
+
+	// Heap memory used, in bytes.
+	size_t GetMemoryUsage() const {
+		return IsInline() ? 0 : m_capacity * sizeof(Snowflake);
+	}
+
+private:
+	bool IsInline() const {
+		return m_capacity <= C_SMALL_SET_INLINE;
+	}
+	Snowflake* Data() {
+		return IsInline() ? m_inline : m_pHeap;
+	}
+	const Snowflake* Data() const {
+		return IsInline() ? m_inline : m_pHeap;
+	}
+
+	void Free();
+	void CopyFrom(const SmallSnowflakeSet& oth);
+
+	uint32_t m_size = 0;
+	uint32_t m_capacity = C_SMALL_SET_INLINE;
+	union {
+		Snowflake m_inline[C_SMALL_SET_INLINE];
+		Snowflake* m_pHeap;
+	};
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "Snowflake.hpp"
+
+// Capacity of a SnowflakeMap when the first entry is inserted.
+#define C_SNOWFLAKE_MAP_MIN_CAPACITY (16)
+
+// A hash map from snowflakes to small values, using open addressing with
+// linear probing.  The entries are stored in one flat array, so a lookup is a
+// multiply and usually a single cache line.  Erasing shifts the following
+// entries back instead of leaving tombstones.
+//
+// N.B. Snowflake 0 marks empty slots, so its value is stored on the side.
+template <typename T>
+class SnowflakeMap
+{
+public:
+	T* Find(Snowflake key)
+	{
+		if (!key)
+			return m_bHasZero ? &m_zeroValue : nullptr;
+
+		size_t index = FindIndex(key);
+		return index == size_t(-1) ? nullptr : &m_slots[index].m_value;
+	}
+
+	const T* Find(Snowflake key) const
+	{
+		if (!key)
+			return m_bHasZero ? &m_zeroValue : nullptr;
+
+		size_t index = FindIndex(key);
+		return index == size_t(-1) ? nullptr : &m_slots[index].m_value;
+	}
+
+	// Inserts the value, or replaces the one already stored under the key.
+	void Insert(Snowflake key, const T& value)
+	{
+		if (!key)
+		{
+			if (!m_bHasZero)
+				m_size++;
+
+			m_bHasZero = true;
+			m_zeroValue = value;
+			return;
+		}
+
+		if ((m_size + 1) * 2 > m_slots.size())
+			Rehash(m_slots.empty() ? C_SNOWFLAKE_MAP_MIN_CAPACITY : m_slots.size() * 2);
+
+		size_t mask = m_slots.size() - 1;
+		size_t index = Home(key);
+		while (m_slots[index].m_key && m_slots[index].m_key != key)
+			index = (index + 1) & mask;
+
+		if (!m_slots[index].m_key) {
+			m_slots[index].m_key = key;
+			m_size++;
+		}
+
+		m_slots[index].m_value = value;
+	}
+
+	bool Erase(Snowflake key)
+	{
+		if (!key)
+		{
+			if (!m_bHasZero)
+				return false;
+
+			m_bHasZero = false;
+			m_zeroValue = T();
+			m_size--;
+			return true;
+		}
+
+		size_t hole = FindIndex(key);
+		if (hole == size_t(-1))
+			return false;
+
+		// Move back the entries after the hole that would otherwise no longer
+		// be reachable from their home slot.
+		size_t mask = m_slots.size() - 1;
+		size_t index = hole;
+		while (true)
+		{
+			index = (index + 1) & mask;
+			if (!m_slots[index].m_key)
+				break;
+
+			size_t home = Home(m_slots[index].m_key);
+			bool bReachable = hole <= index
+				? (hole < home && home <= index)
+				: (hole < home || home <= index);
+
+			if (bReachable)
+				continue;
+
+			m_slots[hole] = m_slots[index];
+			hole = index;
+		}
+
+		m_slots[hole] = Slot();
+		m_size--;
+		return true;
+	}
+
+	void Clear()
+	{
+		m_slots.clear();
+		m_size = 0;
+		m_bHasZero = false;
+		m_zeroValue = T();
+	}
+
+	size_t Size() const {
+		return m_size;
+	}
+
+	// Calls func with each key and value.  The map must not be changed while
+	// doing so.
+	template <typename Func>
+	void ForEach(Func func) const
+	{
+		if (m_bHasZero)
+			func(Snowflake(0), m_zeroValue);
+
+		for (auto& slot : m_slots)
+		{
+			if (slot.m_key)
+				func(slot.m_key, slot.m_value);
+		}
+	}
+
+	size_t GetMemoryUsage() const {
+		return m_slots.capacity() * sizeof(Slot);
+	}
+
+private:
+	struct Slot
+	{
+		Snowflake m_key = 0;
+		T m_value = T();
+	};
+
+	size_t Home(Snowflake key) const
+	{
+		// Fibonacci hashing.  Spreads the timestamp bits of a snowflake over
+		// the whole index, as its low bits are mostly the same.
+		return size_t((key * 0x9E3779B97F4A7C15ULL) >> (64 - m_bits));
+	}
+
+	size_t FindIndex(Snowflake key) const
+	{
+		if (m_slots.empty())
+			return size_t(-1);
+
+		size_t mask = m_slots.size() - 1;
+		size_t index = Home(key);
+		while (m_slots[index].m_key)
+		{
+			if (m_slots[index].m_key == key)
+				return index;
+
+			index = (index + 1) & mask;
+		}
+
+		return size_t(-1);
+	}
+
+	void Rehash(size_t capacity)
+	{
+		std::vector<Slot> slots(capacity);
+		slots.swap(m_slots);
+
+		m_bits = 0;
+		while ((size_t(1) << m_bits) < capacity)
+			m_bits++;
+
+		m_size = m_bHasZero ? 1 : 0;
+		for (auto& slot : slots)
+		{
+			if (slot.m_key)
+				Insert(slot.m_key, slot.m_value);
+		}
+	}
+
+	std::vector<Slot> m_slots;
+	size_t m_size = 0;
+	int m_bits = 0;
+
+	bool m_bHasZero = false;
+	T m_zeroValue = T();
+};
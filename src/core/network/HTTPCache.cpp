@@ -0,0 +1,245 @@
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include "HTTPCache.hpp"
+#include "HTTPClient.hpp"
+#include "../utils/Util.hpp"
+#include "../config/LocalSettings.hpp"
+
+#ifdef MINGW_SPECIFIC_HACKS
+#include <iprog/mutex.hpp>
+typedef iprog::mutex HTTPCacheMutex;
+#else
+#include <mutex>
+typedef std::mutex HTTPCacheMutex;
+#endif
+
+static HTTPCacheMutex g_httpCacheMutex;
+
+HTTPCache* GetHTTPCache()
+{
+	static HTTPCache instance;
+	return &instance;
+}
+
+bool HTTPCache::IsCacheable(const NetRequest& request)
+{
+	if (request.type != NetRequest::GET)
+		return false;
+
+	switch (request.itype)
+	{
+		using namespace DiscordRequest;
+		case PINS:
+		case GUILD:
+		case PROFILE:
+		case USER_NOTE:
+			return true;
+	}
+
+	return false;
+}
+
+std::string HTTPCache::MakeKey(const NetRequest& request)
+{
+	return MakeKey(request.url + request.params, request.authorization);
+}
+
+std::string HTTPCache::MakeKey(const std::string& urlAndParams, const std::string& authorization)
+{
+	// Don't keep the token itself around, a hash of it is enough to tell
+	// users apart.
+	uint64_t userHash = HashStringLong(authorization.c_str(), int(authorization.size()));
+
+	return urlAndParams + "\n" + std::to_string(userHash);
+}
+
+HTTPCache::Entry* HTTPCache::Find(const std::string& key)
+{
+	// N.B. Called with the mutex held.
+	auto iter = m_entries.find(key);
+	if (iter != m_entries.end())
+		return &iter->second;
+
+	if (!GetLocalSettings()->EnableHTTPDiskCache())
+		return nullptr;
+
+	Entry entry;
+	if (!LoadFromDisk(key, entry))
+		return nullptr;
+
+	EvictIfNeeded();
+
+	Entry& newEntry = m_entries[key];
+	newEntry = std::move(entry);
+	return &newEntry;
+}
+
+bool HTTPCache::GetFresh(const std::string& key, std::string& body)
+{
+	g_httpCacheMutex.lock();
+
+	Entry* pEntry = Find(key);
+	if (!pEntry || !pEntry->m_expiresAt || pEntry->m_expiresAt < GetTimeMs()) {
+		g_httpCacheMutex.unlock();
+		return false;
+	}
+
+	pEntry->m_lastUsed = GetTimeMs();
+	body = pEntry->m_body;
+
+	g_httpCacheMutex.unlock();
+	return true;
+}
+
+bool HTTPCache::GetValidators(const std::string& key, std::string& etag, std::string& lastModified)
+{
+	g_httpCacheMutex.lock();
+
+	Entry* pEntry = Find(key);
+	if (!pEntry || (pEntry->m_etag.empty() && pEntry->m_lastModified.empty())) {
+		g_httpCacheMutex.unlock();
+		return false;
+	}
+
+	etag = pEntry->m_etag;
+	lastModified = pEntry->m_lastModified;
+
+	g_httpCacheMutex.unlock();
+	return true;
+}
+
+bool HTTPCache::GetRevalidated(const std::string& key, std::string& body)
+{
+	g_httpCacheMutex.lock();
+
+	// Don't go to the disk, the entry was there when the request was sent.
+	auto iter = m_entries.find(key);
+	if (iter == m_entries.end()) {
+		g_httpCacheMutex.unlock();
+		return false;
+	}
+
+	iter->second.m_lastUsed = GetTimeMs();
+	body = iter->second.m_body;
+
+	g_httpCacheMutex.unlock();
+	return true;
+}
+
+void HTTPCache::Store(const std::string& key, const std::string& body, const std::string& etag, const std::string& lastModified)
+{
+	if (body.size() > C_MAX_HTTP_CACHE_BODY_SIZE)
+		return;
+
+	bool hasValidators = !etag.empty() || !lastModified.empty();
+
+	g_httpCacheMutex.lock();
+
+	if (!m_entries.count(key))
+		EvictIfNeeded();
+
+	Entry& entry = m_entries[key];
+	entry.m_body = body;
+	entry.m_etag = etag;
+	entry.m_lastModified = lastModified;
+	entry.m_expiresAt = hasValidators ? 0 : GetTimeMs() + C_HTTP_CACHE_TTL_MS;
+	entry.m_lastUsed = GetTimeMs();
+
+	// Responses without validators go stale quickly, so they're not worth
+	// putting on disk.
+	if (hasValidators && GetLocalSettings()->EnableHTTPDiskCache())
+		SaveToDisk(key, entry);
+
+	g_httpCacheMutex.unlock();
+}
+
+void HTTPCache::Invalidate(const std::string& url, const std::string& authorization)
+{
+	g_httpCacheMutex.lock();
+
+	bool useDisk = GetLocalSettings()->EnableHTTPDiskCache();
+
+	auto iter = m_entries.lower_bound(url);
+	while (iter != m_entries.end() && iter->first.compare(0, url.size(), url) == 0)
+	{
+		// Only the URL itself, with its parameters, or the resources under it.
+		// Not other URLs that start the same, like .../notes/123 for .../notes/12.
+		char next = iter->first[url.size()];
+		if (next != '\n' && next != '?' && next != '/') {
+			++iter;
+			continue;
+		}
+
+		if (useDisk)
+			remove(GetDiskPath(iter->first).c_str());
+
+		iter = m_entries.erase(iter);
+	}
+
+	// The response may be on disk without having been loaded since startup.
+	if (useDisk)
+		remove(GetDiskPath(MakeKey(url, authorization)).c_str());
+
+	g_httpCacheMutex.unlock();
+}
+
+void HTTPCache::Clear()
+{
+	g_httpCacheMutex.lock();
+	m_entries.clear();
+	g_httpCacheMutex.unlock();
+}
+
+void HTTPCache::EvictIfNeeded()
+{
+	// N.B. Called with the mutex held.
+	if (m_entries.size() < C_MAX_HTTP_CACHE_ENTRIES)
+		return;
+
+	auto oldest = m_entries.begin();
+	for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+	{
+		if (oldest->second.m_lastUsed > iter->second.m_lastUsed)
+			oldest = iter;
+	}
+
+	m_entries.erase(oldest);
+}
+
+std::string HTTPCache::GetDiskPath(const std::string& key)
+{
+	return GetCachePath() + "\\http_" + std::to_string(HashStringLong(key.c_str(), int(key.size()))) + ".bin";
+}
+
+bool HTTPCache::LoadFromDisk(const std::string& key, Entry& entry)
+{
+	std::ifstream file(GetDiskPath(key), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	// The file starts with the key, so that hash collisions can be told apart,
+	// then the validators and the body.
+	std::string fileKey, userHash;
+	std::getline(file, fileKey);
+	std::getline(file, userHash);
+	std::getline(file, entry.m_etag);
+	std::getline(file, entry.m_lastModified);
+
+	if (!file.good() || fileKey + "\n" + userHash != key)
+		return false;
+
+	entry.m_body.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	entry.m_expiresAt = 0;
+	entry.m_lastUsed = GetTimeMs();
+	return true;
+}
+
+void HTTPCache::SaveToDisk(const std::string& key, const Entry& entry)
+{
+	std::ofstream file(GetDiskPath(key), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return;
+
+	file << key << "\n" << entry.m_etag << "\n" << entry.m_lastModified << "\n" << entry.m_body;
+}
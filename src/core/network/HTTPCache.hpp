@@ -0,0 +1,80 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <cstdint>
+
+struct NetRequest;
+
+// Maximum amount of responses kept in memory.
+#define C_MAX_HTTP_CACHE_ENTRIES (256)
+
+// Responses larger than this aren't cached.
+#define C_MAX_HTTP_CACHE_BODY_SIZE (1024 * 1024)
+
+// Time a response without an ETag or Last-Modified validator is considered
+// fresh for, in milliseconds.
+#define C_HTTP_CACHE_TTL_MS (30000)
+
+// Caches the responses of GET requests for REST resources that are fetched
+// every time their UI opens, like pins, channel lists, profiles and notes.
+//
+// Responses with validators are revalidated with If-None-Match and
+// If-Modified-Since, and a 304 Not Modified is served from the cache.
+// Responses without validators are served straight from the cache for a
+// short while instead.  Optionally, validated responses are also kept on
+// disk.  Thread safe.
+class HTTPCache
+{
+public:
+	// Whether the response to this request may be cached.
+	static bool IsCacheable(const NetRequest& request);
+
+	// Gets the key that identifies a request's response.  Responses are kept
+	// apart per user.
+	static std::string MakeKey(const NetRequest& request);
+	static std::string MakeKey(const std::string& urlAndParams, const std::string& authorization);
+
+	// If there is a response that can be used without asking the server, fills
+	// it in and returns true.
+	bool GetFresh(const std::string& key, std::string& body);
+
+	// Gets the validators to send along with a conditional request.  Returns
+	// false if there is no response that can be revalidated.
+	bool GetValidators(const std::string& key, std::string& etag, std::string& lastModified);
+
+	// Gets the cached response after the server replied with 304 Not Modified.
+	bool GetRevalidated(const std::string& key, std::string& body);
+
+	// Stores the response to a request.  If there are no validators, the
+	// response is only kept for a short while.
+	void Store(const std::string& key, const std::string& body, const std::string& etag, const std::string& lastModified);
+
+	// Drops all cached responses for this URL, with any parameters, for every
+	// user.  On disk, drops the response without parameters for this user.
+	void Invalidate(const std::string& url, const std::string& authorization);
+
+	void Clear();
+
+private:
+	struct Entry
+	{
+		std::string m_body;
+		std::string m_etag;
+		std::string m_lastModified;
+		uint64_t m_expiresAt = 0; // only for responses without validators
+		uint64_t m_lastUsed = 0;
+	};
+
+	Entry* Find(const std::string& key);
+	void EvictIfNeeded();
+
+	static std::string GetDiskPath(const std::string& key);
+	static bool LoadFromDisk(const std::string& key, Entry& entry);
+	static void SaveToDisk(const std::string& key, const Entry& entry);
+
+	// Keys start with the URL, so all entries for a URL are next to each other.
+	std::map<std::string, Entry> m_entries;
+};
+
+HTTPCache* GetHTTPCache();
@@ -1,6 +1,18 @@
 #include "HTTPClient.hpp"
 #include "../Frontend.hpp"
 
+#ifdef MINGW_SPECIFIC_HACKS
+#include <iprog/mutex.hpp>
+typedef iprog::mutex RequestPoolMutex;
+#else
+#include <mutex>
+typedef std::mutex RequestPoolMutex;
+#endif
+
+static RequestPoolMutex g_requestPoolMutex;
+static NetRequest* g_pFreeRequests = nullptr;
+static int g_freeRequestCount = 0;
+
 NetRequest::NetRequest(
 	int _result,
 	int _itype,
@@ -37,6 +49,106 @@ NetRequest::NetRequest(
 	pFunc = _func;
 }
 
+void NetRequest::Set(
+	int _itype,
+	uint64_t _key,
+	eType _type,
+	const std::string& _url,
+	std::string&& _params,
+	std::string&& _authorization,
+	std::string&& _additional_data,
+	NetworkResponseFunc _func,
+	const uint8_t* _bytes,
+	size_t _size)
+{
+	assert(_size == 0 || _bytes);
+
+	result = 0;
+	itype = _itype;
+	key = _key;
+	type = _type;
+	url = _url;
+	response.clear();
+	params = std::move(_params);
+	authorization = std::move(_authorization);
+	additional_data = std::move(_additional_data);
+	params_bytes.assign(_bytes, _bytes + _size);
+	pFunc = _func ? _func : &HTTPClient::DefaultRequestHandler;
+}
+
+template <typename T>
+static void RecycleBuffer(T& buffer)
+{
+	if (buffer.capacity() > C_MAX_POOLED_BUFFER_SIZE)
+		T().swap(buffer);
+	else
+		buffer.clear();
+}
+
+void NetRequest::Reset()
+{
+	result = 0;
+	itype = 0;
+	key = 0;
+	type = NOTHING_MAN;
+	pFunc = nullptr;
+	m_offset = 0;
+	m_length = 0;
+	m_bCancelOp = false;
+	m_enqueueTime = 0;
+	m_priority = 0;
+	m_sequence = 0;
+
+	RecycleBuffer(url);
+	RecycleBuffer(response);
+	RecycleBuffer(params);
+	RecycleBuffer(authorization);
+	RecycleBuffer(additional_data);
+	RecycleBuffer(params_bytes);
+}
+
+NetRequest* NetRequest::Acquire()
+{
+	g_requestPoolMutex.lock();
+
+	NetRequest* pRequest = g_pFreeRequests;
+	if (pRequest) {
+		g_pFreeRequests = pRequest->m_pNextFree;
+		g_freeRequestCount--;
+	}
+
+	g_requestPoolMutex.unlock();
+
+	if (!pRequest)
+		return new NetRequest;
+
+	pRequest->m_pNextFree = nullptr;
+	return pRequest;
+}
+
+void NetRequest::Release(NetRequest* pRequest)
+{
+	if (!pRequest)
+		return;
+
+	// Clear it outside of the lock, this may free memory.
+	pRequest->Reset();
+
+	g_requestPoolMutex.lock();
+
+	if (g_freeRequestCount >= C_MAX_POOLED_REQUESTS) {
+		g_requestPoolMutex.unlock();
+		delete pRequest;
+		return;
+	}
+
+	pRequest->m_pNextFree = g_pFreeRequests;
+	g_pFreeRequests = pRequest;
+	g_freeRequestCount++;
+
+	g_requestPoolMutex.unlock();
+}
+
 std::string NetRequest::ErrorMessage() const
 {
 	return GetHTTPClient()->ErrorMessage(result);
@@ -17,6 +17,8 @@ enum eHttpResponseCodes
 	HTTP_RESETCONTENT = 204,
 	HTTP_PARTIALCNTNT = 204,
 
+	HTTP_NOTMODIFIED  = 304,
+
 	HTTP_BADREQUEST   = 400,
 	HTTP_UNAUTHORIZED = 401,
 	HTTP_FORBIDDEN    = 403,
@@ -73,6 +75,15 @@ struct NetRequest
 	size_t m_offset; // used only for *_PROGRESS
 	size_t m_length; // used only for *_PROGRESS
 	bool m_bCancelOp = false; // used only for *_PROGRESS
+	uint64_t m_enqueueTime = 0; // time in ms when the request was queued
+
+	// Used by the request queues.  Requests of equal priority are serviced in
+	// the order they were queued.
+	int m_priority = 0;
+	uint64_t m_sequence = 0;
+
+	// Next free request while this one sits in the request pool.
+	NetRequest* m_pNextFree = nullptr;
 
 	size_t GetOffset() const {
 		return m_offset;
@@ -112,10 +123,56 @@ struct NetRequest
 	);
 
 	std::string ErrorMessage() const;
+
+	// Requests are move-only.  Their buffers are handed over, never copied.
+	NetRequest(const NetRequest&) = delete;
+	NetRequest& operator=(const NetRequest&) = delete;
+	NetRequest(NetRequest&&) = default;
+	NetRequest& operator=(NetRequest&&) = default;
+
+	// Fills in a request, reusing the buffers it already owns.  The strings
+	// passed by rvalue reference are moved in.  The stream bytes are copied.
+	void Set(
+		int _itype,
+		uint64_t _key,
+		eType _type,
+		const std::string& _url,
+		std::string&& _params,
+		std::string&& _authorization,
+		std::string&& _additional_data,
+		NetworkResponseFunc _func,
+		const uint8_t* _bytes,
+		size_t _size
+	);
+
+	// Clears the request, but keeps the capacity of its buffers around.
+	void Reset();
+
+	// Takes a request from the request pool, or allocates one if the pool is
+	// empty.  Hand it back with Release() once done.  Thread safe.
+	static NetRequest* Acquire();
+	static void Release(NetRequest* pRequest);
 };
 
+// Maximum amount of free requests kept around for reuse.
+#define C_MAX_POOLED_REQUESTS (64)
+
+// Buffers larger than this aren't kept around when a request is recycled.
+#define C_MAX_POOLED_BUFFER_SIZE (256 * 1024)
+
 class HTTPClient
 {
+public:
+	// Live statistics about one of the HTTP client's worker pools.
+	struct PoolStats
+	{
+		int m_threads = 0;
+		int m_idleThreads = 0;
+		int m_maxThreads = 0;
+		int m_queueDepth = 0;
+		int m_avgQueueWaitMs = 0;
+	};
+
 public:
 	HTTPClient() {}
 	virtual ~HTTPClient() {}
@@ -142,6 +199,9 @@ public:
 		size_t stream_size = 0
 	) = 0;
 
+	// Gets statistics about the interactive or the background worker pool.
+	virtual void GetPoolStats(bool interactive, PoolStats& stats) = 0;
+
 	static void DefaultRequestHandler(NetRequest* pRequest);
 };
 
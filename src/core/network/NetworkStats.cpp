@@ -0,0 +1,304 @@
+#include <fstream>
+#include <nlohmann/json.h>
+#include "NetworkStats.hpp"
+#include "DiscordRequest.hpp"
+#include "../utils/Util.hpp"
+
+#ifdef MINGW_SPECIFIC_HACKS
+#include <iprog/mutex.hpp>
+typedef iprog::mutex NetworkStatsMutex;
+#else
+#include <mutex>
+typedef std::mutex NetworkStatsMutex;
+#endif
+
+using nlohmann::json;
+
+constexpr int LatencyHistogram::SUB_BUCKET_BITS;
+constexpr int LatencyHistogram::SUB_BUCKETS;
+constexpr int LatencyHistogram::MAX_EXPONENT;
+constexpr int LatencyHistogram::BUCKET_COUNT;
+
+static NetworkStatsMutex g_networkStatsMutex;
+
+NetworkStats* GetNetworkStats()
+{
+	static NetworkStats instance;
+	return &instance;
+}
+
+int LatencyHistogram::BucketIndex(uint64_t value)
+{
+	if (value < uint64_t(SUB_BUCKETS))
+		return int(value);
+
+	int exponent = 0;
+	while (value >> (exponent + 1))
+		exponent++;
+
+	if (exponent >= MAX_EXPONENT)
+		return BUCKET_COUNT - 1;
+
+	int subBucket = int(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+	return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::BucketLowerBound(int index)
+{
+	if (index < SUB_BUCKETS)
+		return uint64_t(index);
+
+	int group = index / SUB_BUCKETS;
+	int subBucket = index % SUB_BUCKETS;
+	return uint64_t(SUB_BUCKETS + subBucket) << (group - 1);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int index)
+{
+	if (index + 1 >= BUCKET_COUNT)
+		return UINT64_MAX;
+
+	return BucketLowerBound(index + 1) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value)
+{
+	m_buckets[BucketIndex(value)]++;
+
+	if (m_count == 0 || m_min > value)
+		m_min = value;
+	if (m_max < value)
+		m_max = value;
+
+	m_count++;
+	m_sum += value;
+}
+
+void LatencyHistogram::Reset()
+{
+	for (int i = 0; i < BUCKET_COUNT; i++)
+		m_buckets[i] = 0;
+
+	m_count = m_sum = m_min = m_max = 0;
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(double percentile) const
+{
+	if (m_count == 0)
+		return 0;
+
+	if (percentile < 0.0) percentile = 0.0;
+	if (percentile > 100.0) percentile = 100.0;
+
+	uint64_t target = uint64_t(percentile * double(m_count) / 100.0 + 0.5);
+	if (target < 1)
+		target = 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKET_COUNT; i++)
+	{
+		seen += m_buckets[i];
+		if (seen < target)
+			continue;
+
+		uint64_t value = BucketUpperBound(i);
+		if (value > m_max) value = m_max;
+		if (value < m_min) value = m_min;
+		return value;
+	}
+
+	return m_max;
+}
+
+void NetworkEndpointStats::Record(const NetworkSample& sample)
+{
+	m_count++;
+	m_retries += sample.m_retries;
+	m_bytesIn += sample.m_bytesIn;
+	m_bytesOut += sample.m_bytesOut;
+	m_statusCodes[sample.m_status]++;
+
+	if (sample.m_bNewConnection)
+		m_newConnections++;
+
+	if (sample.m_queueWaitMs >= 0)
+		m_queueWait.Record(uint64_t(sample.m_queueWaitMs));
+	if (sample.m_connectMs >= 0)
+		m_connect.Record(uint64_t(sample.m_connectMs));
+	if (sample.m_tlsMs >= 0)
+		m_tls.Record(uint64_t(sample.m_tlsMs));
+	if (sample.m_ttfbMs >= 0)
+		m_ttfb.Record(uint64_t(sample.m_ttfbMs));
+	if (sample.m_totalMs >= 0)
+		m_total.Record(uint64_t(sample.m_totalMs));
+}
+
+NetworkStats::NetworkStats()
+{
+	m_startTime = m_lastDumpTime = GetTimeMs();
+}
+
+void NetworkStats::Record(const NetworkSample& sample)
+{
+	g_networkStatsMutex.lock();
+	m_byRequestType[sample.m_itype].Record(sample);
+	m_byHost[sample.m_host].Record(sample);
+	g_networkStatsMutex.unlock();
+}
+
+void NetworkStats::Reset()
+{
+	g_networkStatsMutex.lock();
+	m_byRequestType.clear();
+	m_byHost.clear();
+	m_startTime = GetTimeMs();
+	g_networkStatsMutex.unlock();
+}
+
+void NetworkStats::GetRequestTypeStats(std::map<int, NetworkEndpointStats>& out)
+{
+	g_networkStatsMutex.lock();
+	out = m_byRequestType;
+	g_networkStatsMutex.unlock();
+}
+
+void NetworkStats::GetHostStats(std::map<std::string, NetworkEndpointStats>& out)
+{
+	g_networkStatsMutex.lock();
+	out = m_byHost;
+	g_networkStatsMutex.unlock();
+}
+
+const char* NetworkStats::GetRequestTypeName(int itype)
+{
+	using namespace DiscordRequest;
+
+	switch (itype)
+	{
+		case NOTHING:             return "NOTHING";
+		case PROFILE:             return "PROFILE";
+		case GUILDS:              return "GUILDS";
+		case MESSAGES:            return "MESSAGES";
+		case GUILD:               return "GUILD";
+		case IMAGE:               return "IMAGE";
+		case GATEWAY:             return "GATEWAY";
+		case TYPING:              return "TYPING";
+		case IMAGE_ATTACHMENT:    return "IMAGE_ATTACHMENT";
+		case DELETE_MESSAGE:      return "DELETE_MESSAGE";
+		case ACK:                 return "ACK";
+		case PINS:                return "PINS";
+		case PIN_MESSAGE:         return "PIN_MESSAGE";
+		case UNPIN_MESSAGE:       return "UNPIN_MESSAGE";
+		case MESSAGE_CREATE:      return "MESSAGE_CREATE";
+		case UPLOAD_ATTACHMENT:   return "UPLOAD_ATTACHMENT";
+		case UPLOAD_ATTACHMENT_2: return "UPLOAD_ATTACHMENT_2";
+		case LEAVE_GUILD:         return "LEAVE_GUILD";
+		case ACK_BULK:            return "ACK_BULK";
+		case USER_NOTE:           return "USER_NOTE";
+		case SET_USER_NOTE:       return "SET_USER_NOTE";
+	}
+
+	return "UNKNOWN";
+}
+
+static json HistogramToJson(const LatencyHistogram& hist)
+{
+	json j;
+	j["count"] = hist.Count();
+
+	if (hist.Count())
+	{
+		j["min"] = hist.Min();
+		j["mean"] = hist.Mean();
+		j["p50"] = hist.ValueAtPercentile(50.0);
+		j["p90"] = hist.ValueAtPercentile(90.0);
+		j["p99"] = hist.ValueAtPercentile(99.0);
+		j["max"] = hist.Max();
+	}
+
+	return j;
+}
+
+static json EndpointStatsToJson(const NetworkEndpointStats& stats)
+{
+	json j, codes;
+
+	for (auto& code : stats.m_statusCodes)
+		codes[std::to_string(code.first)] = code.second;
+
+	j["count"] = stats.m_count;
+	j["retries"] = stats.m_retries;
+	j["new_connections"] = stats.m_newConnections;
+	j["bytes_in"] = stats.m_bytesIn;
+	j["bytes_out"] = stats.m_bytesOut;
+	j["status_codes"] = codes;
+	j["queue_wait_ms"] = HistogramToJson(stats.m_queueWait);
+	j["connect_ms"] = HistogramToJson(stats.m_connect);
+	j["tls_ms"] = HistogramToJson(stats.m_tls);
+	j["ttfb_ms"] = HistogramToJson(stats.m_ttfb);
+	j["total_ms"] = HistogramToJson(stats.m_total);
+	return j;
+}
+
+std::string NetworkStats::DumpJson()
+{
+	std::map<int, NetworkEndpointStats> byRequestType;
+	std::map<std::string, NetworkEndpointStats> byHost;
+	uint64_t startTime;
+
+	g_networkStatsMutex.lock();
+	byRequestType = m_byRequestType;
+	byHost = m_byHost;
+	startTime = m_startTime;
+	g_networkStatsMutex.unlock();
+
+	json j, types, hosts;
+
+	for (auto& type : byRequestType)
+		types[GetRequestTypeName(type.first)] = EndpointStatsToJson(type.second);
+
+	for (auto& host : byHost)
+		hosts[host.first] = EndpointStatsToJson(host.second);
+
+	j["since"] = startTime;
+	j["time"] = GetTimeMs();
+	j["request_types"] = types;
+	j["hosts"] = hosts;
+	return j.dump(1, '\t');
+}
+
+bool NetworkStats::DumpToFile(const std::string& fileName)
+{
+	std::string data = DumpJson();
+
+	std::ofstream of(fileName, std::ios::trunc);
+	if (!of.is_open())
+		return false;
+
+	of << data;
+	return of.good();
+}
+
+void NetworkStats::DumpPeriodically()
+{
+	uint64_t now = GetTimeMs();
+
+	g_networkStatsMutex.lock();
+	if (m_lastDumpTime + C_NETWORK_STATS_DUMP_INTERVAL_MS > now) {
+		g_networkStatsMutex.unlock();
+		return;
+	}
+	m_lastDumpTime = now;
+	g_networkStatsMutex.unlock();
+
+	DumpToCache();
+}
+
+void NetworkStats::DumpToCache()
+{
+	std::string fileName = GetCachePath() + "\\netstats.json";
+
+	if (!DumpToFile(fileName)) {
+		DbgPrintF("Could not write network statistics to %s", fileName.c_str());
+	}
+}
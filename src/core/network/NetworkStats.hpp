@@ -0,0 +1,116 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <cstdint>
+
+// Interval between two periodic dumps of the network statistics, in milliseconds.
+#define C_NETWORK_STATS_DUMP_INTERVAL_MS (5 * 60 * 1000)
+
+// Log-linear histogram of durations in milliseconds, in the style of HdrHistogram.
+// Values below 8 ms are exact, larger values are kept within 12.5% precision.
+// Values from about 4.6 hours up are clamped.
+class LatencyHistogram
+{
+public:
+	static constexpr int SUB_BUCKET_BITS = 3;
+	static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr int MAX_EXPONENT = 24;
+	static constexpr int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	void Record(uint64_t value);
+	void Reset();
+
+	uint64_t Count() const { return m_count; }
+	uint64_t Min() const { return m_count ? m_min : 0; }
+	uint64_t Max() const { return m_max; }
+	uint64_t Mean() const { return m_count ? m_sum / m_count : 0; }
+
+	// Returns an estimate of the value under which the given percentage
+	// (0-100) of the recorded values fall.
+	uint64_t ValueAtPercentile(double percentile) const;
+
+private:
+	static int BucketIndex(uint64_t value);
+	static uint64_t BucketLowerBound(int index);
+	static uint64_t BucketUpperBound(int index);
+
+	uint32_t m_buckets[BUCKET_COUNT] = { 0 };
+	uint64_t m_count = 0;
+	uint64_t m_sum = 0;
+	uint64_t m_min = 0;
+	uint64_t m_max = 0;
+};
+
+// One finished request, as reported by the HTTP client.  Timings are in
+// milliseconds.  Timings that don't apply to the request are negative.
+struct NetworkSample
+{
+	int m_itype = 0; // DiscordRequest::eDiscordRequest
+	std::string m_host;
+	int m_status = 0; // HTTP status code, or a negative number on client error
+	int m_retries = 0;
+	bool m_bNewConnection = false;
+	int64_t m_queueWaitMs = -1;
+	int64_t m_connectMs = -1; // name resolution and TCP connect
+	int64_t m_tlsMs = -1;     // TLS handshake
+	int64_t m_ttfbMs = -1;    // time to first response byte
+	int64_t m_totalMs = -1;
+	uint64_t m_bytesIn = 0;
+	uint64_t m_bytesOut = 0;
+};
+
+struct NetworkEndpointStats
+{
+	uint64_t m_count = 0;
+	uint64_t m_retries = 0;
+	uint64_t m_newConnections = 0;
+	uint64_t m_bytesIn = 0;
+	uint64_t m_bytesOut = 0;
+	std::map<int, uint64_t> m_statusCodes;
+
+	LatencyHistogram m_queueWait;
+	LatencyHistogram m_connect;
+	LatencyHistogram m_tls;
+	LatencyHistogram m_ttfb;
+	LatencyHistogram m_total;
+
+	void Record(const NetworkSample& sample);
+};
+
+// Keeps statistics about the requests performed by the HTTP client, broken
+// down by request type and by host.  Thread safe.
+class NetworkStats
+{
+public:
+	NetworkStats();
+
+	void Record(const NetworkSample& sample);
+	void Reset();
+
+	// Copies out a snapshot of the statistics.
+	void GetRequestTypeStats(std::map<int, NetworkEndpointStats>& out);
+	void GetHostStats(std::map<std::string, NetworkEndpointStats>& out);
+
+	// Serializes the statistics as JSON.
+	std::string DumpJson();
+
+	// Writes the JSON dump to the given file.
+	bool DumpToFile(const std::string& fileName);
+
+	// Writes the JSON dump to netstats.json in the cache directory.
+	void DumpToCache();
+
+	// Calls DumpToCache(), if enough time has passed since the last dump.
+	void DumpPeriodically();
+
+	static const char* GetRequestTypeName(int itype);
+
+private:
+	std::map<int, NetworkEndpointStats> m_byRequestType;
+	std::map<std::string, NetworkEndpointStats> m_byHost;
+	uint64_t m_startTime = 0;
+	uint64_t m_lastDumpTime = 0;
+};
+
+NetworkStats* GetNetworkStats();
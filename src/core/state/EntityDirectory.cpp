@@ -0,0 +1,113 @@
+#include "EntityDirectory.hpp"
+#include "../models/Guild.hpp"
+
+Guild* EntityDirectory::GetGuild(Snowflake sf) const
+{
+	Guild* const* ppGuild = m_guilds.Find(sf);
+	return ppGuild ? *ppGuild : nullptr;
+}
+
+Channel* EntityDirectory::GetChannel(Snowflake sf, Guild** ppGuild) const
+{
+	const ChannelEntry* pEntry = m_channels.Find(sf);
+	if (!pEntry)
+		return nullptr;
+
+	if (ppGuild)
+		*ppGuild = pEntry->m_pGuild;
+
+	return pEntry->m_pChannel;
+}
+
+GuildRole* EntityDirectory::GetRole(Snowflake sf, Guild** ppGuild) const
+{
+	const RoleEntry* pEntry = m_roles.Find(sf);
+	if (!pEntry)
+		return nullptr;
+
+	if (ppGuild)
+		*ppGuild = pEntry->m_pGuild;
+
+	return pEntry->m_pRole;
+}
+
+void EntityDirectory::AddGuild(Guild* pGuild)
+{
+	if (pGuild->m_snowflake)
+		m_guilds.Insert(pGuild->m_snowflake, pGuild);
+
+	AddChannels(pGuild);
+
+	for (auto& role : pGuild->m_roles)
+		AddRole(pGuild, &role.second);
+}
+
+void EntityDirectory::RemoveGuild(Guild* pGuild)
+{
+	// Only remove what still belongs to this guild, in case a newer copy of
+	// it was indexed in the meantime.
+	if (GetGuild(pGuild->m_snowflake) == pGuild)
+		m_guilds.Erase(pGuild->m_snowflake);
+
+	RemoveChannels(pGuild);
+
+	for (auto& role : pGuild->m_roles)
+	{
+		const RoleEntry* pEntry = m_roles.Find(role.first);
+		if (pEntry && pEntry->m_pGuild == pGuild)
+			m_roles.Erase(role.first);
+	}
+}
+
+void EntityDirectory::AddChannels(Guild* pGuild)
+{
+	for (auto& chan : pGuild->m_channels)
+		AddChannel(pGuild, &chan);
+}
+
+void EntityDirectory::RemoveChannels(Guild* pGuild)
+{
+	for (auto& chan : pGuild->m_channels)
+	{
+		const ChannelEntry* pEntry = m_channels.Find(chan.m_snowflake);
+		if (pEntry && pEntry->m_pGuild == pGuild)
+			m_channels.Erase(chan.m_snowflake);
+	}
+}
+
+void EntityDirectory::AddChannel(Guild* pGuild, Channel* pChannel)
+{
+	ChannelEntry entry;
+	entry.m_pChannel = pChannel;
+	entry.m_pGuild = pGuild;
+	m_channels.Insert(pChannel->m_snowflake, entry);
+}
+
+void EntityDirectory::RemoveChannel(Snowflake sf)
+{
+	m_channels.Erase(sf);
+}
+
+void EntityDirectory::AddRole(Guild* pGuild, GuildRole* pRole)
+{
+	// Roles created by looking up a missing role have no ID.
+	if (!pRole->m_id)
+		return;
+
+	RoleEntry entry;
+	entry.m_pRole = pRole;
+	entry.m_pGuild = pGuild;
+	m_roles.Insert(pRole->m_id, entry);
+}
+
+void EntityDirectory::RemoveRole(Snowflake sf)
+{
+	m_roles.Erase(sf);
+}
+
+void EntityDirectory::Clear()
+{
+	m_guilds.Clear();
+	m_channels.Clear();
+	m_roles.Clear();
+}
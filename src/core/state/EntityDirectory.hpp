@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../models/SnowflakeMap.hpp"
+
+struct Guild;
+struct Channel;
+struct GuildRole;
+
+// Finds guilds, channels and roles by their snowflake, without walking the
+// guild list.  Holds pointers into DiscordInstance's guilds, so it must be
+// told about every guild and channel that is added or removed.
+//
+// N.B. The DM guild has the snowflake 0, so it isn't indexed itself, but its
+// channels are.
+class EntityDirectory
+{
+public:
+	Guild* GetGuild(Snowflake sf) const;
+
+	// If ppGuild is not null, it receives the guild that owns the channel.
+	Channel* GetChannel(Snowflake sf, Guild** ppGuild = nullptr) const;
+
+	// If ppGuild is not null, it receives the guild that owns the role.
+	GuildRole* GetRole(Snowflake sf, Guild** ppGuild = nullptr) const;
+
+	// Indexes the guild, along with its channels and roles.
+	void AddGuild(Guild* pGuild);
+
+	// Removes the guild, along with its channels and roles.  Must be called
+	// before the guild is destroyed or its contents replaced.
+	void RemoveGuild(Guild* pGuild);
+
+	// Indexes or removes all channels of a guild, for when its channel list
+	// is replaced.
+	void AddChannels(Guild* pGuild);
+	void RemoveChannels(Guild* pGuild);
+
+	void AddChannel(Guild* pGuild, Channel* pChannel);
+	void RemoveChannel(Snowflake sf);
+
+	void AddRole(Guild* pGuild, GuildRole* pRole);
+	void RemoveRole(Snowflake sf);
+
+	void Clear();
+
+private:
+	struct ChannelEntry
+	{
+		Channel* m_pChannel = nullptr;
+		Guild* m_pGuild = nullptr;
+	};
+
+	struct RoleEntry
+	{
+		GuildRole* m_pRole = nullptr;
+		Guild* m_pGuild = nullptr;
+	};
+
+	SnowflakeMap<Guild*> m_guilds;
+	SnowflakeMap<ChannelEntry> m_channels;
+	SnowflakeMap<RoleEntry> m_roles;
+};
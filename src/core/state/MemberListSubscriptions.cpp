@@ -0,0 +1,73 @@
+#include <algorithm>
+#include "MemberListSubscriptions.hpp"
+
+bool MemberListSubscriptions::SetChannel(Snowflake guild, Snowflake channel)
+{
+	if (m_guild == guild && m_channel == channel)
+		return false;
+
+	m_guild = guild;
+	m_channel = channel;
+	m_windows.assign(1, 0);
+	return true;
+}
+
+bool MemberListSubscriptions::SetVisibleRange(Snowflake guild, Snowflake channel, size_t first, size_t last)
+{
+	if (m_guild != guild || m_channel != channel || first > last)
+		return false;
+
+	int firstWindow = int(first / C_MEMBER_LIST_WINDOW_SIZE);
+	int lastWindow  = int(last  / C_MEMBER_LIST_WINDOW_SIZE);
+
+	// The list never shows this many entries at once, but leave room for the
+	// first window anyway.
+	lastWindow = std::min(lastWindow, firstWindow + C_MAX_MEMBER_LIST_WINDOWS - 2);
+
+	std::vector<int> windows { 0 };
+	for (int window = std::max(firstWindow, 1); window <= lastWindow; window++)
+		windows.push_back(window);
+
+	// Keep the old windows next to the visible ones while there's room.
+	// Those further away are dropped.
+	for (int window : m_windows)
+	{
+		if (window == 0 || (window >= firstWindow && window <= lastWindow))
+			continue;
+
+		int distance = window < firstWindow ? firstWindow - window : window - lastWindow;
+		if (distance <= C_MEMBER_LIST_WINDOW_SLACK && int(windows.size()) < C_MAX_MEMBER_LIST_WINDOWS)
+			windows.push_back(window);
+	}
+
+	std::sort(windows.begin(), windows.end());
+	if (windows == m_windows)
+		return false;
+
+	m_windows.swap(windows);
+	return true;
+}
+
+std::vector<std::pair<int, int>> MemberListSubscriptions::GetRanges() const
+{
+	std::vector<std::pair<int, int>> ranges;
+	for (int window : m_windows)
+	{
+		int start = window * C_MEMBER_LIST_WINDOW_SIZE;
+		ranges.push_back(std::make_pair(start, start + C_MEMBER_LIST_WINDOW_SIZE - 1));
+	}
+
+	return ranges;
+}
+
+size_t MemberListSubscriptions::GetSizeLimit() const
+{
+	return size_t(m_windows.back() + 2) * C_MEMBER_LIST_WINDOW_SIZE;
+}
+
+void MemberListSubscriptions::Clear()
+{
+	m_guild = 0;
+	m_channel = 0;
+	m_windows.assign(1, 0);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include "../models/Snowflake.hpp"
+
+// Amount of member list entries in one subscribed window.  Windows start at
+// multiples of this, the way the server expects them.
+#define C_MEMBER_LIST_WINDOW_SIZE (100)
+
+// Subscribed windows this many windows away from the visible ones are kept,
+// so that scrolling back and forth over a boundary doesn't resubscribe.
+#define C_MEMBER_LIST_WINDOW_SLACK (1)
+
+// Maximum amount of windows subscribed to at once, including the first one.
+#define C_MAX_MEMBER_LIST_WINDOWS (5)
+
+// Picks the ranges of the current channel's member list that are subscribed to
+// with gateway op 14, from the part of the list the member list shows.  The
+// server only sends GUILD_MEMBER_LIST_UPDATE ops for those ranges.
+//
+// The first window is always subscribed to, as the server asks for it.
+//
+// N.B. Only used from the main thread.
+class MemberListSubscriptions
+{
+public:
+	// Starts over with only the first window if the channel changed.  Returns
+	// whether it did.
+	bool SetChannel(Snowflake guild, Snowflake channel);
+
+	// The member list of the channel shows entries [first, last].  Returns
+	// whether the windows changed, and need to be subscribed to again.
+	bool SetVisibleRange(Snowflake guild, Snowflake channel, size_t first, size_t last);
+
+	// Gets the subscribed windows, as inclusive ranges of entries, in order.
+	std::vector<std::pair<int, int>> GetRanges() const;
+
+	// Gets the amount of entries worth keeping in the member list: up to the
+	// end of the last subscribed window, and one more window to scroll into.
+	size_t GetSizeLimit() const;
+
+	void Clear();
+
+private:
+	Snowflake m_guild = 0;
+	Snowflake m_channel = 0;
+
+	// Numbers of the subscribed windows, in order.  Always starts with 0.
+	std::vector<int> m_windows { 0 };
+};
@@ -0,0 +1,126 @@
+#include "MemberRequestTracker.hpp"
+#include "../utils/Util.hpp"
+#include <cstdlib>
+
+bool MemberRequestTracker::IsPending(Snowflake guild, Snowflake user) const
+{
+	auto iter = m_guilds.find(guild);
+	if (iter == m_guilds.end())
+		return false;
+
+	const uint32_t* pNonce = iter->second.m_users.Find(user);
+	return pNonce && IsFresh(*pNonce);
+}
+
+bool MemberRequestTracker::IsQueryPending(Snowflake guild, const std::string& query) const
+{
+	auto iter = m_guilds.find(guild);
+	if (iter == m_guilds.end())
+		return false;
+
+	auto queryIter = iter->second.m_queries.find(query);
+	return queryIter != iter->second.m_queries.end() && IsFresh(queryIter->second);
+}
+
+std::string MemberRequestTracker::AddRequest(Snowflake guild, const std::vector<Snowflake>& users)
+{
+	uint32_t nonce = NewRequest(guild);
+	m_requests[nonce].m_users = users;
+
+	GuildRequests& requests = m_guilds[guild];
+	for (Snowflake user : users)
+		requests.m_users.Insert(user, nonce);
+
+	return std::to_string(nonce);
+}
+
+std::string MemberRequestTracker::AddQuery(Snowflake guild, const std::string& query)
+{
+	uint32_t nonce = NewRequest(guild);
+	m_requests[nonce].m_query = query;
+	m_guilds[guild].m_queries[query] = nonce;
+
+	return std::to_string(nonce);
+}
+
+void MemberRequestTracker::OnChunk(const std::string& nonceStr, int chunkIndex, int chunkCount)
+{
+	if (nonceStr.empty() || chunkIndex + 1 < chunkCount)
+		return;
+
+	uint32_t nonce = uint32_t(strtoul(nonceStr.c_str(), NULL, 10));
+	RemoveRequest(nonce);
+}
+
+void MemberRequestTracker::ExpireStale()
+{
+	std::vector<uint32_t> stale;
+	for (auto& req : m_requests)
+	{
+		if (!IsFresh(req.first))
+			stale.push_back(req.first);
+	}
+
+	for (uint32_t nonce : stale)
+		RemoveRequest(nonce);
+
+	if (!stale.empty()) {
+		DbgPrintF("Gave up on %d member requests", int(stale.size()));
+	}
+}
+
+void MemberRequestTracker::Clear()
+{
+	m_requests.clear();
+	m_guilds.clear();
+}
+
+bool MemberRequestTracker::IsFresh(uint32_t nonce) const
+{
+	auto iter = m_requests.find(nonce);
+	if (iter == m_requests.end())
+		return false;
+
+	return GetTimeMs() - iter->second.m_sentAt < C_MEMBER_REQUEST_TIMEOUT_MS;
+}
+
+uint32_t MemberRequestTracker::NewRequest(Snowflake guild)
+{
+	uint32_t nonce = m_nextNonce++;
+
+	Request& req = m_requests[nonce];
+	req.m_guild = guild;
+	req.m_sentAt = GetTimeMs();
+	return nonce;
+}
+
+void MemberRequestTracker::RemoveRequest(uint32_t nonce)
+{
+	auto iter = m_requests.find(nonce);
+	if (iter == m_requests.end())
+		return;
+
+	Request& req = iter->second;
+	auto guildIter = m_guilds.find(req.m_guild);
+	if (guildIter != m_guilds.end())
+	{
+		GuildRequests& requests = guildIter->second;
+
+		// Only if the users and query weren't requested again since.
+		for (Snowflake user : req.m_users)
+		{
+			const uint32_t* pNonce = requests.m_users.Find(user);
+			if (pNonce && *pNonce == nonce)
+				requests.m_users.Erase(user);
+		}
+
+		auto queryIter = requests.m_queries.find(req.m_query);
+		if (!req.m_query.empty() && queryIter != requests.m_queries.end() && queryIter->second == nonce)
+			requests.m_queries.erase(queryIter);
+
+		if (requests.m_users.Size() == 0 && requests.m_queries.empty())
+			m_guilds.erase(guildIter);
+	}
+
+	m_requests.erase(iter);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../models/Snowflake.hpp"
+#include "../models/SnowflakeMap.hpp"
+
+// Maximum amount of users asked for in one member request (gateway op 8).
+#define C_MAX_MEMBER_REQUEST_USERS (100)
+
+// Time after which a member request that wasn't fully answered is forgotten,
+// in milliseconds.  Its users and query may be requested again afterwards.
+#define C_MEMBER_REQUEST_TIMEOUT_MS (20000)
+
+// Keeps track of the member requests sent over the gateway until their last
+// GUILD_MEMBERS_CHUNK arrives, so that the member list, the message list and
+// the autocomplete don't request the same members over and over.  Requests
+// are told apart by the nonce sent along with them, which the chunks echo.
+//
+// N.B. Only used from the main thread.
+class MemberRequestTracker
+{
+public:
+	// Whether a request for this member, or query, is waiting for an answer.
+	bool IsPending(Snowflake guild, Snowflake user) const;
+	bool IsQueryPending(Snowflake guild, const std::string& query) const;
+
+	// Notes down a request that's about to be sent.  Returns its nonce.
+	std::string AddRequest(Snowflake guild, const std::vector<Snowflake>& users);
+	std::string AddQuery(Snowflake guild, const std::string& query);
+
+	// A chunk of the answer to a request arrived.  The request is done after
+	// its last chunk.
+	void OnChunk(const std::string& nonce, int chunkIndex, int chunkCount);
+
+	// Forgets the requests that timed out.
+	void ExpireStale();
+
+	void Clear();
+
+private:
+	struct Request
+	{
+		Snowflake m_guild = 0;
+		uint64_t m_sentAt = 0;
+		std::vector<Snowflake> m_users;
+		std::string m_query;
+	};
+
+	// The pending requests of one guild, by the users and queries they're for.
+	struct GuildRequests
+	{
+		SnowflakeMap<uint32_t> m_users;
+		std::map<std::string, uint32_t> m_queries;
+	};
+
+	bool IsFresh(uint32_t nonce) const;
+	uint32_t NewRequest(Snowflake guild);
+	void RemoveRequest(uint32_t nonce);
+
+	// Pending requests by nonce.
+	std::map<uint32_t, Request> m_requests;
+	std::map<Snowflake, GuildRequests> m_guilds;
+
+	uint32_t m_nextNonce = 1;
+};
@@ -1,55 +1,102 @@
 #include "MessageCache.hpp"
+#include "MessageStore.hpp"
+#include "SearchIndex.hpp"
 #include "ProfileCache.hpp"
+#include "../config/LocalSettings.hpp"
 #include "../Frontend.hpp"
 #include "../DiscordInstance.hpp"
+#include "../utils/Util.hpp"
+#include <algorithm>
+#include <vector>
 
 constexpr int MESSAGES_PER_REQUEST = 50;
 
 using nlohmann::json;
 static MessageCache g_MCSingleton;
+static uint64_t g_messageListVersion = 0;
 
 MessageCache::MessageCache()
 {
 }
 
-void MessageCache::GetLoadedMessages(Snowflake channel, Snowflake guild, std::list<MessagePtr>& out)
+MessageChunkList& MessageCache::GetChunkList(Snowflake channel)
 {
+	auto iter = m_mapMessages.find(channel);
+	if (iter != m_mapMessages.end())
+		return iter->second;
+
 	MessageChunkList& lst = m_mapMessages[channel];
+	lst.m_channel = channel;
+
+	Channel* pChan = GetDiscordInstance()->GetChannel(channel);
+	if (pChan)
+	{
+		lst.m_guild = pChan->m_parentGuild;
+		lst.LoadFromStore(pChan->GetTypeSymbol() + pChan->m_name, pChan->m_lastSentMsg);
+	}
+
+	return lst;
+}
+
+const MessageRunList& MessageCache::GetLoadedMessages(Snowflake channel, Snowflake guild)
+{
+	MessageChunkList& lst = GetChunkList(channel);
 	lst.m_guild = guild;
+	Touch(lst);
+
+	return lst.m_messages;
+}
+
+uint64_t MessageCache::GetVersion(Snowflake channel)
+{
+	return GetChunkList(channel).m_version;
+}
 
-	for (auto& msg : lst.m_messages)
-		out.push_back(msg.second);
+bool MessageCache::GetChangesSince(Snowflake channel, uint64_t version, std::set<Snowflake>& changed)
+{
+	return GetChunkList(channel).GetChangesSince(version, changed);
 }
 
 void MessageCache::ProcessRequest(Snowflake channel, ScrollDir::eScrollDir sd, Snowflake anchor, nlohmann::json& j, const std::string& channelName)
 {
-	MessageChunkList& lst = m_mapMessages[channel];
+	MessageChunkList& lst = GetChunkList(channel);
+	Touch(lst);
 	lst.ProcessRequest(sd, anchor, j, channelName);
+
+	EnforceBudget();
 }
 
-void MessageCache::AddMessage(Snowflake channel, const Message& msg)
+void MessageCache::AddMessage(Snowflake channel, const MessagePtr& msg)
 {
-	m_mapMessages[channel].AddMessage(msg);
+	GetChunkList(channel).AddMessage(msg);
+
+	EnforceBudget();
 }
 
-void MessageCache::EditMessage(Snowflake channel, const Message& msg)
+void MessageCache::EditMessage(Snowflake channel, const MessagePtr& msg)
 {
-	m_mapMessages[channel].EditMessage(msg);
+	GetChunkList(channel).EditMessage(msg);
 }
 
 void MessageCache::DeleteMessage(Snowflake channel, Snowflake msg)
 {
-	m_mapMessages[channel].DeleteMessage(msg);
+	GetChunkList(channel).DeleteMessage(msg);
+}
+
+void MessageCache::StoreMessage(Snowflake channel, nlohmann::json& data, bool bIsUpdate)
+{
+	GetChunkList(channel).StoreMessage(data, bIsUpdate);
 }
 
 int MessageCache::GetMentionCountSince(Snowflake channel, Snowflake message, Snowflake user)
 {
-	return m_mapMessages[channel].GetMentionCountSince(message, user);
+	return GetChunkList(channel).GetMentionCountSince(message, user);
 }
 
 void MessageCache::ClearAllChannels()
 {
 	m_mapMessages.clear();
+	GetSearchIndex()->Clear();
 }
 
 bool MessageCache::IsMessageLoaded(Snowflake channel, Snowflake message)
@@ -58,14 +105,95 @@ bool MessageCache::IsMessageLoaded(Snowflake channel, Snowflake message)
 	if (it == m_mapMessages.end())
 		return false;
 
-	auto& msgs = it->second.m_messages;
-	auto it2 = msgs.find(message);
-	return it2 != msgs.end();
+	return it->second.m_messages.Find(message) != nullptr;
 }
 
 MessagePtr MessageCache::GetLoadedMessage(Snowflake channel, Snowflake message)
 {
-	return m_mapMessages[channel].GetLoadedMessage(message);
+	return GetChunkList(channel).GetLoadedMessage(message);
+}
+
+void MessageCache::SetViewedMessage(Snowflake channel, Snowflake message)
+{
+	auto iter = m_mapMessages.find(channel);
+	if (iter == m_mapMessages.end())
+		return;
+
+	Touch(iter->second);
+	iter->second.m_viewedMessage = message;
+}
+
+size_t MessageCache::GetMemoryUsage() const
+{
+	size_t usage = 0;
+	for (auto& lst : m_mapMessages)
+		usage += lst.second.m_memoryUsage;
+
+	return usage;
+}
+
+void MessageCache::OnRolesChanged(Snowflake guild)
+{
+	for (auto& lst : m_mapMessages)
+	{
+		if (lst.second.m_guild == guild)
+			lst.second.RefreshRoleMentions();
+	}
+}
+
+void MessageCache::Touch(MessageChunkList& lst)
+{
+	lst.m_lastUsed = ++m_useCounter;
+}
+
+void MessageCache::EnforceBudget()
+{
+	size_t budget = size_t(GetLocalSettings()->GetMessageCacheBudget()) * 1024 * 1024;
+	if (budget == 0)
+		return;
+
+	size_t usage = GetMemoryUsage();
+	if (usage <= budget)
+		return;
+
+	Snowflake currentChannel = GetDiscordInstance()->GetCurrentChannelID();
+
+	std::vector<std::pair<uint64_t, Snowflake>> channels;
+	for (auto& lst : m_mapMessages)
+	{
+		if (lst.first != currentChannel)
+			channels.push_back(std::make_pair(lst.second.m_lastUsed, lst.first));
+	}
+
+	std::sort(channels.begin(), channels.end());
+
+	// Drop whole channels first.  If a channel comes back into view, it's
+	// loaded from the message store again.
+	for (auto& chan : channels)
+	{
+		if (usage <= budget)
+			break;
+
+		auto iter = m_mapMessages.find(chan.second);
+		usage -= iter->second.m_memoryUsage;
+		m_mapMessages.erase(iter);
+
+		// Its stored messages are indexed again if it's searched.
+		GetSearchIndex()->RemoveChannel(chan.second);
+	}
+
+	if (usage <= budget)
+		return;
+
+	// Then trim the messages far away from the ones being viewed.
+	for (auto& lst : m_mapMessages)
+	{
+		usage -= lst.second.m_memoryUsage;
+		lst.second.Trim(C_MESSAGE_CACHE_TRIM_KEEP);
+		usage += lst.second.m_memoryUsage;
+	}
+
+	DbgPrintF("Message cache trimmed to %d KB (budget %d KB)", int(usage / 1024), int(budget / 1024));
 }
 
 MessageCache* GetMessageCache()
@@ -84,38 +212,334 @@ MessageChunkList::MessageChunkList()
 	msg->m_message = "";
 	msg->m_dateFull = "";
 	msg->m_dateCompact = "";
-	m_messages[msg->m_snowflake] = msg;
+
+	m_mentionUser = GetDiscordInstance()->GetUserID();
+	PutEntry(msg);
+	NoteReset();
+}
+
+void MessageChunkList::NoteChange(Snowflake sf)
+{
+	m_version = ++g_messageListVersion;
+	m_changes.push_back(std::make_pair(m_version, sf));
+
+	if (m_changes.size() > C_MAX_MESSAGE_CHANGES)
+	{
+		// Forget the older half.
+		auto middle = m_changes.begin() + m_changes.size() / 2;
+		m_oldestVersion = (middle - 1)->first;
+		m_changes.erase(m_changes.begin(), middle);
+	}
+}
+
+void MessageChunkList::NoteReset()
+{
+	m_version = ++g_messageListVersion;
+	m_oldestVersion = m_version;
+	m_changes.clear();
+}
+
+static void InsertSorted(std::vector<Snowflake>& vec, Snowflake sf)
+{
+	auto iter = std::lower_bound(vec.begin(), vec.end(), sf);
+	if (iter == vec.end() || *iter != sf)
+		vec.insert(iter, sf);
+}
+
+static void EraseSorted(std::vector<Snowflake>& vec, Snowflake sf)
+{
+	auto iter = std::lower_bound(vec.begin(), vec.end(), sf);
+	if (iter != vec.end() && *iter == sf)
+		vec.erase(iter);
+}
+
+void MessageChunkList::IndexMentions(const Message& msg)
+{
+	UnindexMentions(msg.m_snowflake);
+
+	if (MessageRunList::IsMarker(msg))
+		return;
+
+	// N.B. Blocks are checked when counting.
+	if (msg.m_bMentionedEveryone || msg.m_userMentions.count(m_mentionUser))
+	{
+		InsertSorted(m_mentions, msg.m_snowflake);
+		return;
+	}
+
+	if (msg.m_roleMentions.empty())
+		return;
+
+	InsertSorted(m_roleMentions, msg.m_snowflake);
+
+	if (msg.CheckWasMentioned(m_mentionUser, m_guild))
+		InsertSorted(m_mentions, msg.m_snowflake);
+}
+
+void MessageChunkList::UnindexMentions(Snowflake sf)
+{
+	EraseSorted(m_mentions, sf);
+	EraseSorted(m_roleMentions, sf);
+}
+
+void MessageChunkList::RebuildMentionIndex()
+{
+	m_mentions.clear();
+	m_roleMentions.clear();
+
+	m_messages.ForEach(0, [this](const MessagePtr& msg) {
+		IndexMentions(*msg);
+	});
+}
+
+void MessageChunkList::RefreshRoleMentions()
+{
+	for (Snowflake sf : m_roleMentions)
+	{
+		MessagePtr msg = m_messages.Find(sf);
+		if (!msg)
+			continue;
+
+		if (msg->CheckWasMentioned(m_mentionUser, m_guild))
+			InsertSorted(m_mentions, sf);
+		else
+			EraseSorted(m_mentions, sf);
+	}
+}
+
+bool MessageChunkList::GetChangesSince(uint64_t version, std::set<Snowflake>& changed) const
+{
+	if (version < m_oldestVersion)
+		return false;
+
+	auto iter = std::upper_bound(m_changes.begin(), m_changes.end(), version, [](uint64_t ver, const std::pair<uint64_t, Snowflake>& change) {
+		return ver < change.first;
+	});
+
+	for (; iter != m_changes.end(); ++iter)
+		changed.insert(iter->second);
+
+	return true;
+}
+
+void MessageChunkList::PutEntry(const MessagePtr& msg)
+{
+	MessagePtr old = m_messages.Put(msg);
+	if (old)
+		m_memoryUsage -= old->GetMemoryUsage();
+
+	m_memoryUsage += msg->GetMemoryUsage();
+	NoteChange(msg->m_snowflake);
+	IndexMentions(*msg);
+
+	if (m_channel)
+		GetSearchIndex()->AddMessage(m_channel, m_guild, *msg);
+}
+
+void MessageChunkList::EraseEntry(Snowflake sf)
+{
+	MessagePtr old = m_messages.Erase(sf);
+	if (!old)
+		return;
+
+	m_memoryUsage -= old->GetMemoryUsage();
+	NoteChange(sf);
+	UnindexMentions(sf);
+}
+
+void MessageChunkList::RecalculateMemoryUsage()
+{
+	m_memoryUsage = 0;
+	m_messages.ForEach(0, [this](const MessagePtr& msg) {
+		m_memoryUsage += msg->GetMemoryUsage();
+	});
+}
+
+void MessageChunkList::Trim(size_t keep)
+{
+	if (m_messages.Size() <= keep * 2 + 1)
+		return;
+
+	std::vector<MessagePtr> entries;
+	m_messages.GetEntries(entries);
+
+	size_t view = entries.size() - 1;
+	if (m_viewedMessage)
+	{
+		auto iter = std::lower_bound(entries.begin(), entries.end(), m_viewedMessage, [](const MessagePtr& msg, Snowflake sf) {
+			return msg->m_snowflake < sf;
+		});
+
+		if (iter != entries.end())
+			view = size_t(iter - entries.begin());
+	}
+
+	size_t lowestIndex = view > keep ? view - keep : 0;
+	size_t highestIndex = std::min(view + keep, entries.size() - 1);
+
+	MessagePtr lowest = entries[lowestIndex], highest = entries[highestIndex];
+	Snowflake lowestMsg = lowest->m_snowflake, highestMsg = highest->m_snowflake;
+	bool trimBelow = lowestIndex != 0;
+	bool trimAbove = highestIndex != entries.size() - 1;
+
+	// N.B. The trimmed messages are only dropped from memory, they stay in the
+	// message store.
+	m_messages.Assign(std::vector<MessagePtr>(entries.begin() + lowestIndex, entries.begin() + highestIndex + 1));
+	RecalculateMemoryUsage();
+	RebuildMentionIndex();
+	NoteReset();
+
+	if (trimBelow && !MessageRunList::IsMarker(*lowest))
+	{
+		auto msg = MakeMessage();
+		msg->m_author = GetFrontend()->GetPleaseWaitText();
+		msg->m_type = MessageType::GAP_UP;
+		msg->m_anchor = lowestMsg;
+		msg->m_snowflake = lowestMsg - 1;
+		PutEntry(msg);
+	}
+
+	if (trimAbove && !highest->IsLoadGap())
+	{
+		auto msg = MakeMessage();
+		msg->m_author = GetFrontend()->GetPleaseWaitText();
+		msg->m_type = MessageType::GAP_DOWN;
+		msg->m_anchor = highestMsg;
+		msg->m_snowflake = highestMsg + 1;
+		PutEntry(msg);
+	}
+}
+
+bool MessageChunkList::UseStore()
+{
+	if (!m_channel || !GetLocalSettings()->EnableMessageStore())
+		return false;
+
+	if (m_bStoreSynced)
+		return true;
+
+	// Save the gaps and header that are already in the list, so that the
+	// store describes the same list.  Messages are saved as they're added.
+	m_bStoreSynced = true;
+
+	for (auto& msg : m_messages.GetMarkers())
+	{
+		if (msg->IsLoadGap())
+			GetMessageStore()->PutGap(m_channel, *msg);
+		else
+			GetMessageStore()->PutHeader(m_channel);
+	}
+
+	return true;
+}
+
+bool MessageChunkList::HasStore() const
+{
+	return m_bStoreSynced && m_channel && GetLocalSettings()->EnableMessageStore();
+}
+
+void MessageChunkList::LoadFromStore(const std::string& channelName, Snowflake lastMessage)
+{
+	if (!GetLocalSettings()->EnableMessageStore())
+		return;
+
+	std::map<Snowflake, MessagePtr> stored;
+	if (!GetMessageStore()->LoadChannel(m_channel, m_guild, channelName, stored))
+		return;
+
+	std::vector<MessagePtr> entries;
+	entries.reserve(stored.size());
+	for (auto& msg : stored)
+		entries.push_back(msg.second);
+
+	m_messages.Assign(entries);
+	m_bStoreSynced = true;
+
+	for (auto& msg : entries)
+		GetSearchIndex()->AddMessage(m_channel, m_guild, *msg);
+
+	RecalculateMemoryUsage();
+	RebuildMentionIndex();
+	NoteReset();
+
+	// Messages may have been sent since the store was last written to.  If so,
+	// fetch them when scrolled to.
+	MessagePtr highest = m_messages.Highest();
+	if (!highest->IsLoadGap() && highest->m_snowflake < lastMessage)
+	{
+		auto msg = MakeMessage();
+		msg->m_author = GetFrontend()->GetPleaseWaitText();
+		msg->m_type = MessageType::GAP_DOWN;
+		msg->m_anchor = highest->m_snowflake;
+		msg->m_snowflake = highest->m_snowflake + 1;
+		PutEntry(msg);
+
+		GetMessageStore()->PutGap(m_channel, *msg);
+	}
+}
+
+void MessageChunkList::StoreMessage(nlohmann::json& data, bool bIsUpdate)
+{
+	// The rest is fetched when the channel is viewed, and stored then.
+	if (!HasStore())
+		return;
+
+	Snowflake messageId = GetSnowflake(data, "id");
+
+	if (!bIsUpdate) {
+		GetMessageStore()->PutMessage(m_channel, messageId, data.dump());
+		return;
+	}
+
+	// Merge the update into the stored message.  Null fields are skipped, as
+	// they may have been added while the update was parsed.
+	std::string storedData;
+	if (!GetMessageStore()->GetMessageData(m_channel, messageId, storedData))
+		return;
+
+	json stored = json::parse(storedData, nullptr, false);
+	if (stored.is_discarded() || !stored.is_object())
+		return;
+
+	for (auto iter = data.begin(); iter != data.end(); ++iter)
+	{
+		if (!iter.value().is_null())
+			stored[iter.key()] = iter.value();
+	}
+
+	GetMessageStore()->PutMessage(m_channel, messageId, stored.dump());
 }
 
 void MessageChunkList::ProcessRequest(ScrollDir::eScrollDir sd, Snowflake gap, json& j, const std::string& channelName)
 {
 	Snowflake lowestMsg = (Snowflake) -1LL, highestMsg = 0;
 
-	bool addedMessages = false;
+	bool useStore = UseStore();
 
-	// remove the anchor
-	auto iter = m_messages.find(gap);
-	if (iter != m_messages.end())
+	// remove the anchor.  This merges the runs on either side of it
+	MessagePtr anchor = m_messages.Find(gap);
+	if (anchor && anchor->IsLoadGap())
 	{
-		if (iter->second->IsLoadGap())
-			m_messages.erase(iter);
+		EraseEntry(gap);
+
+		if (useStore)
+			GetMessageStore()->Erase(m_channel, gap);
 	}
 
 	// for each message
-	int receivedMessages = 0;
+	std::vector<MessagePtr> received;
+	received.reserve(j.size());
+
 	for (json& data : j)
 	{
+		// N.B. Save it before parsing it, parsing adds empty fields.
+		if (useStore)
+			GetMessageStore()->PutMessage(m_channel, GetSnowflake(data, "id"), data.dump());
+
 		auto msg = MakeMessage();
 		msg->Load(data, m_guild);
-
-		if (!addedMessages)
-		{
-			if (m_messages.find(msg->m_snowflake) == m_messages.end())
-				addedMessages = true;
-		}
-
-		m_messages[msg->m_snowflake] = msg;
-		receivedMessages++;
+		m_memoryUsage += msg->GetMemoryUsage();
+		received.push_back(msg);
 
 		if (lowestMsg > msg->m_snowflake)
 			lowestMsg = msg->m_snowflake;
@@ -123,6 +547,26 @@ void MessageChunkList::ProcessRequest(ScrollDir::eScrollDir sd, Snowflake gap, j
 			highestMsg = msg->m_snowflake;
 	}
 
+	// Discord sends them newest first.
+	std::sort(received.begin(), received.end(), [](const MessagePtr& a, const MessagePtr& b) {
+		return a->m_snowflake < b->m_snowflake;
+	});
+
+	std::vector<MessagePtr> replaced;
+	m_messages.PutSorted(received, replaced);
+
+	for (auto& msg : replaced)
+		m_memoryUsage -= msg->GetMemoryUsage();
+
+	for (auto& msg : received) {
+		NoteChange(msg->m_snowflake);
+		IndexMentions(*msg);
+		GetSearchIndex()->AddMessage(m_channel, m_guild, *msg);
+	}
+
+	int receivedMessages = int(received.size());
+	bool addedMessages = replaced.size() < received.size();
+
 	bool addBefore = sd != ScrollDir::AFTER && receivedMessages >= MESSAGES_PER_REQUEST;
 	bool addAfter  = sd != ScrollDir::BEFORE;
 
@@ -132,7 +576,10 @@ void MessageChunkList::ProcessRequest(ScrollDir::eScrollDir sd, Snowflake gap, j
 		msg->m_type = MessageType::CHANNEL_HEADER;
 		msg->m_snowflake = 1;
 		msg->m_author = channelName;
-		m_messages[msg->m_snowflake] = msg;
+		PutEntry(msg);
+
+		if (useStore)
+			GetMessageStore()->PutHeader(m_channel);
 	}
 
 	if (addBefore && addedMessages)
@@ -142,7 +589,10 @@ void MessageChunkList::ProcessRequest(ScrollDir::eScrollDir sd, Snowflake gap, j
 		msg->m_type = MessageType::GAP_UP;
 		msg->m_anchor = lowestMsg;
 		msg->m_snowflake = lowestMsg - 1;
-		m_messages[msg->m_snowflake] = msg;
+		PutEntry(msg);
+
+		if (useStore)
+			GetMessageStore()->PutGap(m_channel, *msg);
 	}
 
 	if (addAfter && addedMessages)
@@ -152,54 +602,54 @@ void MessageChunkList::ProcessRequest(ScrollDir::eScrollDir sd, Snowflake gap, j
 		msg->m_type = MessageType::GAP_DOWN;
 		msg->m_anchor = highestMsg;
 		msg->m_snowflake = highestMsg + 1;
-		m_messages[msg->m_snowflake] = std::move(msg);
+
+		if (useStore)
+			GetMessageStore()->PutGap(m_channel, *msg);
+
+		PutEntry(msg);
 	}
 
 	GetDiscordInstance()->OnFetchedMessages(gap, sd);
 }
 
-void MessageChunkList::AddMessage(const Message& msg)
+void MessageChunkList::AddMessage(const MessagePtr& msg)
 {
-	if (msg.m_anchor)
-		DeleteMessage(msg.m_anchor);
+	if (msg->m_anchor)
+		DeleteMessage(msg->m_anchor);
 
-	m_messages[msg.m_snowflake] = std::make_shared<Message>(msg);
+	PutEntry(msg);
 }
 
-void MessageChunkList::EditMessage(const Message& msg)
+void MessageChunkList::EditMessage(const MessagePtr& msg)
 {
-	DeleteMessage(msg.m_snowflake);
-	m_messages[msg.m_snowflake] = std::make_shared<Message>(msg);
+	// N.B. Not via DeleteMessage, that would erase it from the store.
+	PutEntry(msg);
 }
 
 void MessageChunkList::DeleteMessage(Snowflake message)
 {
-	auto iter = m_messages.find(message);
-	if (m_messages.end() != iter)
-		m_messages.erase(iter);
+	EraseEntry(message);
+	GetSearchIndex()->RemoveMessage(message);
+
+	if (HasStore())
+		GetMessageStore()->Erase(m_channel, message);
 }
 
 int MessageChunkList::GetMentionCountSince(Snowflake message, Snowflake user)
 {
-	int mentCount = 0;
-
-	for (auto& msg : m_messages)
-	{
-		if (msg.first < message)
-			continue;
-
-		if (msg.second->CheckWasMentioned(user, m_guild))
-			mentCount++;
+	if (user != m_mentionUser) {
+		m_mentionUser = user;
+		RebuildMentionIndex();
 	}
 
-	return mentCount;
+	if (GetDiscordInstance()->IsUserBlocked(user))
+		return 0;
+
+	auto iter = std::lower_bound(m_mentions.begin(), m_mentions.end(), message);
+	return int(m_mentions.end() - iter);
 }
 
 MessagePtr MessageChunkList::GetLoadedMessage(Snowflake message)
 {
-	auto iter = m_messages.find(message);
-	if (m_messages.end() == iter)
-		return nullptr;
-
-	return iter->second;
+	return m_messages.Find(message);
 }
@@ -2,26 +2,93 @@
 
 #include <map>
 #include <list>
+#include <set>
+#include <vector>
 #include <nlohmann/json.h>
 #include "../models/Snowflake.hpp"
 #include "../models/ScrollDir.hpp"
 #include "../models/Message.hpp"
+#include "MessageRunList.hpp"
+
+// Amount of entries kept on either side of the viewed message when a channel's
+// message list is trimmed to fit the message cache budget.
+#define C_MESSAGE_CACHE_TRIM_KEEP (200)
+
+// Amount of changes remembered per channel for GetChangesSince.
+#define C_MAX_MESSAGE_CHANGES (512)
 
 struct MessageChunkList
 {
-	// int - Offset. How many messages ago was this message posted
-	std::map<Snowflake, MessagePtr> m_messages;
+	MessageRunList m_messages;
 
 	bool m_lastMessagesLoaded = false;
 	Snowflake m_guild = 0;
+	Snowflake m_channel = 0;
+
+	// Whether the message store mirrors this list.  Until it does, the first
+	// write to the store saves the gaps and header already in the list.
+	bool m_bStoreSynced = false;
+
+	// Estimated memory used by the messages in this list.
+	size_t m_memoryUsage = 0;
+
+	// When the list was last viewed, for the LRU.
+	uint64_t m_lastUsed = 0;
+
+	// The message the user is looking at.  Zero means the newest message.
+	Snowflake m_viewedMessage = 0;
+
+	// Version of the list, bumped on every change.  The versions come from a
+	// counter shared by all lists, so they're never reused.
+	uint64_t m_version = 0;
+
+	// The changes made since m_oldestVersion, and the versions they were
+	// made in.
+	std::vector<std::pair<uint64_t, Snowflake>> m_changes;
+	uint64_t m_oldestVersion = 0;
+
+	// Sorted snowflakes of the messages that mention m_mentionUser.  Messages
+	// that mention roles, but not the user directly, are also kept in
+	// m_roleMentions, so they can be rechecked when the user's roles change.
+	std::vector<Snowflake> m_mentions;
+	std::vector<Snowflake> m_roleMentions;
+	Snowflake m_mentionUser = 0;
 
 	MessageChunkList();
+	void LoadFromStore(const std::string& channelName, Snowflake lastMessage);
 	void ProcessRequest(ScrollDir::eScrollDir sd, Snowflake anchor, nlohmann::json& j, const std::string& channelName);
-	void AddMessage(const Message& msg);
-	void EditMessage(const Message& msg);
+	void AddMessage(const MessagePtr& msg);
+	void EditMessage(const MessagePtr& msg);
 	void DeleteMessage(Snowflake message);
+	void StoreMessage(nlohmann::json& data, bool bIsUpdate);
 	int GetMentionCountSince(Snowflake message, Snowflake user);
 	MessagePtr GetLoadedMessage(Snowflake message);
+
+	// Drops the entries more than 'keep' entries away from the viewed message,
+	// leaving gaps in their place.
+	void Trim(size_t keep);
+
+	bool GetChangesSince(uint64_t version, std::set<Snowflake>& changed) const;
+
+	// Rechecks the messages that mention roles.
+	void RefreshRoleMentions();
+
+private:
+	// Starts mirroring the list in the message store, if enabled.  Only done
+	// when history is fetched, so that channels that are only heard about
+	// from the gateway don't each get a store.
+	bool UseStore();
+
+	// Whether the list is mirrored in the message store already.
+	bool HasStore() const;
+	void PutEntry(const MessagePtr& msg);
+	void EraseEntry(Snowflake sf);
+	void RecalculateMemoryUsage();
+	void NoteChange(Snowflake sf);
+	void NoteReset();
+	void IndexMentions(const Message& msg);
+	void UnindexMentions(Snowflake sf);
+	void RebuildMentionIndex();
 };
 
 class MessageCache
@@ -29,22 +96,84 @@ class MessageCache
 public:
 	MessageCache();
 	
-	void GetLoadedMessages(Snowflake channel, Snowflake guild, std::list<MessagePtr>& out);
+	// Gets the loaded messages of a channel, gaps and header included.  The
+	// list is owned by the cache, and its iterators are invalidated by any
+	// change to it.
+	const MessageRunList& GetLoadedMessages(Snowflake channel, Snowflake guild);
+
+	// Gets the version of a channel's message list.  It changes whenever the
+	// list does.
+	uint64_t GetVersion(Snowflake channel);
+
+	// Gets the snowflakes of the entries added, changed or removed since the
+	// given version.  Returns false if that version is too old, or from before
+	// the list was last reloaded; in that case anything may have changed.
+	bool GetChangesSince(Snowflake channel, uint64_t version, std::set<Snowflake>& changed);
 
 	// note: scroll dir used to add gap message
 	void ProcessRequest(Snowflake channel, ScrollDir::eScrollDir sd, Snowflake anchor, nlohmann::json& j, const std::string& channelName);
 
-	void AddMessage(Snowflake channel, const Message& msg);
-	void EditMessage(Snowflake channel, const Message& msg);
+	// N.B. The cache keeps the message itself, which must not be changed
+	// afterwards.  To update a message, replace it with a changed copy.
+	void AddMessage(Snowflake channel, const MessagePtr& msg);
+	void EditMessage(Snowflake channel, const MessagePtr& msg);
 	void DeleteMessage(Snowflake channel, Snowflake message);
+
+	// Writes a message received from the gateway to the message store.  Partial
+	// updates are merged into the stored message.
+	void StoreMessage(Snowflake channel, nlohmann::json& data, bool bIsUpdate);
+
 	int GetMentionCountSince(Snowflake channel, Snowflake message, Snowflake user);
 	void ClearAllChannels();
 	bool IsMessageLoaded(Snowflake channel, Snowflake message);
 
 	MessagePtr GetLoadedMessage(Snowflake channel, Snowflake message);
 
+	// Tells the cache which message is being viewed in a channel.  The
+	// messages around it are the last to be evicted.
+	void SetViewedMessage(Snowflake channel, Snowflake message);
+
+	size_t GetMemoryUsage() const;
+
+	// Called when the current user's roles in a guild change.
+	void OnRolesChanged(Snowflake guild);
+
+	// Calls func with the guild and snowflake of each user that the loaded
+	// messages show: their authors, the authors they reply to, and the users
+	// they mention.  The same user may be passed many times.
+	template <typename Func>
+	void ForEachUser(Func func) const
+	{
+		for (auto& lst : m_mapMessages)
+		{
+			Snowflake guild = lst.second.m_guild;
+			lst.second.m_messages.ForEach(0, [&](const MessagePtr& msg) {
+				if (msg->m_author_snowflake)
+					func(guild, msg->m_author_snowflake);
+
+				for (Snowflake user : msg->m_userMentions)
+					func(guild, user);
+
+				if (msg->m_pReferencedMessage && msg->m_pReferencedMessage->m_author_snowflake)
+					func(guild, msg->m_pReferencedMessage->m_author_snowflake);
+			});
+		}
+	}
+
 private:
+	// Gets a channel's message list.  When it's created, it's filled in with
+	// what's in the message store.
+	MessageChunkList& GetChunkList(Snowflake channel);
+
+	void Touch(MessageChunkList& lst);
+
+	// Evicts messages until the cache fits in its budget.  Whole channels,
+	// least recently viewed first, then the messages far away from the viewed
+	// ones.
+	void EnforceBudget();
+
 	std::map <Snowflake, MessageChunkList> m_mapMessages;
+	uint64_t m_useCounter = 0;
 };
 
 MessageCache* GetMessageCache();
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <iterator>
+#include "MessageRunList.hpp"
+
+static bool CompareMessageSnowflake(const MessagePtr& msg, Snowflake sf)
+{
+	return msg->m_snowflake < sf;
+}
+
+MessageRunList::Run::const_iterator MessageRunList::LowerBound(const Run& run, Snowflake sf)
+{
+	return std::lower_bound(run.begin(), run.end(), sf, CompareMessageSnowflake);
+}
+
+MessageRunList::Run::iterator MessageRunList::LowerBound(Run& run, Snowflake sf)
+{
+	return std::lower_bound(run.begin(), run.end(), sf, CompareMessageSnowflake);
+}
+
+size_t MessageRunList::GetRunIndex(Snowflake sf) const
+{
+	return size_t(LowerBound(m_markers, sf) - m_markers.begin());
+}
+
+bool MessageRunList::IsMarkerAt(size_t index, Snowflake sf) const
+{
+	return index < m_markers.size() && m_markers[index]->m_snowflake == sf;
+}
+
+MessageRunList::const_iterator& MessageRunList::const_iterator::operator++()
+{
+	if (m_pos < m_pList->m_runs[m_run].size()) {
+		m_pos++;
+	}
+	else {
+		// Past the marker, into the next run.
+		m_run++;
+		m_pos = 0;
+	}
+
+	return *this;
+}
+
+MessageRunList::const_iterator& MessageRunList::const_iterator::operator--()
+{
+	if (m_pos > 0) {
+		m_pos--;
+	}
+	else {
+		// Back to the marker before this run.
+		m_run--;
+		m_pos = m_pList->m_runs[m_run].size();
+	}
+
+	return *this;
+}
+
+MessageRunList::const_iterator MessageRunList::LowerBound(Snowflake sf) const
+{
+	size_t index = GetRunIndex(sf);
+	const Run& run = m_runs[index];
+	return const_iterator(this, index, size_t(LowerBound(run, sf) - run.begin()));
+}
+
+MessageRunList::const_iterator MessageRunList::FindEntry(Snowflake sf) const
+{
+	const_iterator iter = LowerBound(sf);
+	if (iter == end() || (*iter)->m_snowflake != sf)
+		return end();
+
+	return iter;
+}
+
+MessagePtr MessageRunList::Find(Snowflake sf) const
+{
+	size_t index = GetRunIndex(sf);
+	if (IsMarkerAt(index, sf))
+		return m_markers[index];
+
+	const Run& run = m_runs[index];
+	auto iter = LowerBound(run, sf);
+	if (iter == run.end() || (*iter)->m_snowflake != sf)
+		return nullptr;
+
+	return *iter;
+}
+
+MessagePtr MessageRunList::Put(const MessagePtr& msg)
+{
+	if (IsMarker(*msg))
+		return PutMarker(msg);
+
+	Snowflake sf = msg->m_snowflake;
+	size_t index = GetRunIndex(sf);
+
+	MessagePtr old;
+	if (IsMarkerAt(index, sf)) {
+		old = m_markers[index];
+		EraseMarker(index);
+	}
+
+	Run& run = m_runs[index];
+
+	// New messages usually go at the end.
+	if (run.empty() || run.back()->m_snowflake < sf) {
+		run.push_back(msg);
+		m_size++;
+		return old;
+	}
+
+	auto iter = LowerBound(run, sf);
+	if (iter != run.end() && (*iter)->m_snowflake == sf) {
+		old = *iter;
+		*iter = msg;
+		return old;
+	}
+
+	run.insert(iter, msg);
+	m_size++;
+	return old;
+}
+
+MessagePtr MessageRunList::PutMarker(const MessagePtr& msg)
+{
+	Snowflake sf = msg->m_snowflake;
+	size_t index = GetRunIndex(sf);
+
+	if (IsMarkerAt(index, sf)) {
+		MessagePtr old = m_markers[index];
+		m_markers[index] = msg;
+		return old;
+	}
+
+	// Split the run around the marker.  A message with the same snowflake is
+	// replaced by the marker.
+	MessagePtr old;
+	Run& run = m_runs[index];
+	auto iter = LowerBound(run, sf);
+	if (iter != run.end() && (*iter)->m_snowflake == sf) {
+		old = *iter;
+		iter = run.erase(iter);
+		m_size--;
+	}
+
+	Run upper(std::make_move_iterator(iter), std::make_move_iterator(run.end()));
+	run.erase(iter, run.end());
+
+	m_runs.insert(m_runs.begin() + index + 1, std::move(upper));
+	m_markers.insert(m_markers.begin() + index, msg);
+	m_size++;
+	return old;
+}
+
+void MessageRunList::EraseMarker(size_t index)
+{
+	// Merge the runs on either side of the marker.
+	Run& lower = m_runs[index];
+	Run& upper = m_runs[index + 1];
+
+	if (lower.empty())
+		lower.swap(upper);
+	else
+		lower.insert(lower.end(), std::make_move_iterator(upper.begin()), std::make_move_iterator(upper.end()));
+
+	m_runs.erase(m_runs.begin() + index + 1);
+	m_markers.erase(m_markers.begin() + index);
+	m_size--;
+}
+
+MessagePtr MessageRunList::Erase(Snowflake sf)
+{
+	size_t index = GetRunIndex(sf);
+	if (IsMarkerAt(index, sf)) {
+		MessagePtr old = m_markers[index];
+		EraseMarker(index);
+		return old;
+	}
+
+	Run& run = m_runs[index];
+	auto iter = LowerBound(run, sf);
+	if (iter == run.end() || (*iter)->m_snowflake != sf)
+		return nullptr;
+
+	MessagePtr old = *iter;
+	run.erase(iter);
+	m_size--;
+	return old;
+}
+
+void MessageRunList::PutSorted(const std::vector<MessagePtr>& msgs, std::vector<MessagePtr>& replaced)
+{
+	auto iter = msgs.begin();
+	while (iter != msgs.end())
+	{
+		Snowflake sf = (*iter)->m_snowflake;
+		size_t index = GetRunIndex(sf);
+
+		if (IsMarker(**iter) || IsMarkerAt(index, sf))
+		{
+			MessagePtr old = Put(*iter);
+			if (old)
+				replaced.push_back(old);
+
+			++iter;
+			continue;
+		}
+
+		// Take every message that goes into the same run, and merge them in at once.
+		auto end = iter + 1;
+		while (end != msgs.end() && !IsMarker(**end) && GetRunIndex((*end)->m_snowflake) == index && !IsMarkerAt(index, (*end)->m_snowflake))
+			++end;
+
+		MergeInto(m_runs[index], iter, end, replaced);
+		iter = end;
+	}
+}
+
+void MessageRunList::MergeInto(Run& run, Run::const_iterator begin, Run::const_iterator end, std::vector<MessagePtr>& replaced)
+{
+	size_t count = size_t(end - begin);
+
+	if (run.empty() || run.back()->m_snowflake < (*begin)->m_snowflake) {
+		run.insert(run.end(), begin, end);
+		m_size += count;
+		return;
+	}
+
+	Run merged;
+	merged.reserve(run.size() + count);
+
+	auto iter = run.begin();
+	while (iter != run.end() && begin != end)
+	{
+		if ((*iter)->m_snowflake < (*begin)->m_snowflake) {
+			merged.push_back(std::move(*iter));
+			++iter;
+		}
+		else if ((*begin)->m_snowflake < (*iter)->m_snowflake) {
+			merged.push_back(*begin);
+			++begin;
+			m_size++;
+		}
+		else {
+			replaced.push_back(std::move(*iter));
+			merged.push_back(*begin);
+			++iter;
+			++begin;
+		}
+	}
+
+	for (; iter != run.end(); ++iter)
+		merged.push_back(std::move(*iter));
+
+	for (; begin != end; ++begin) {
+		merged.push_back(*begin);
+		m_size++;
+	}
+
+	run.swap(merged);
+}
+
+void MessageRunList::Assign(const std::vector<MessagePtr>& entries)
+{
+	m_runs.clear();
+	m_markers.clear();
+	m_runs.push_back(Run());
+	m_size = entries.size();
+
+	for (auto& msg : entries)
+	{
+		if (IsMarker(*msg)) {
+			m_markers.push_back(msg);
+			m_runs.push_back(Run());
+		}
+		else {
+			m_runs.back().push_back(msg);
+		}
+	}
+}
+
+void MessageRunList::GetEntries(std::vector<MessagePtr>& out) const
+{
+	out.reserve(out.size() + m_size);
+	ForEach(0, [&out](const MessagePtr& msg) {
+		out.push_back(msg);
+	});
+}
+
+MessagePtr MessageRunList::Lowest() const
+{
+	if (!m_runs.front().empty())
+		return m_runs.front().front();
+	if (!m_markers.empty())
+		return m_markers.front();
+
+	return nullptr;
+}
+
+MessagePtr MessageRunList::Highest() const
+{
+	if (!m_runs.back().empty())
+		return m_runs.back().back();
+	if (!m_markers.empty())
+		return m_markers.back();
+
+	return nullptr;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include <cstddef>
+#include "../models/Snowflake.hpp"
+#include "../models/Message.hpp"
+
+// Sorted list of a channel's loaded messages.  The messages are kept in runs:
+// vectors of messages that were loaded contiguously.  The runs are separated
+// by markers - the load gaps and the channel header - so that run i holds the
+// messages between marker i - 1 and marker i.  Filling a gap removes its marker
+// and merges the runs on either side of it.
+class MessageRunList
+{
+public:
+	// Walks the entries in order, markers included.  Invalidated by any change
+	// to the list.
+	class const_iterator
+	{
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef MessagePtr value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const MessagePtr* pointer;
+		typedef const MessagePtr& reference;
+
+		const_iterator() {}
+
+		reference operator*() const {
+			const Run& run = m_pList->m_runs[m_run];
+			return m_pos < run.size() ? run[m_pos] : m_pList->m_markers[m_run];
+		}
+		pointer operator->() const {
+			return &**this;
+		}
+
+		const_iterator& operator++();
+		const_iterator& operator--();
+
+		const_iterator operator++(int) {
+			const_iterator old = *this;
+			++*this;
+			return old;
+		}
+		const_iterator operator--(int) {
+			const_iterator old = *this;
+			--*this;
+			return old;
+		}
+
+		bool operator==(const const_iterator& oth) const {
+			return m_run == oth.m_run && m_pos == oth.m_pos;
+		}
+		bool operator!=(const const_iterator& oth) const {
+			return !(*this == oth);
+		}
+
+	private:
+		friend class MessageRunList;
+
+		// Position 'm_pos' within run 'm_run'.  One past the end of a run
+		// is the marker after it, or the end of the list after the last run.
+		const_iterator(const MessageRunList* pList, size_t run, size_t pos) :
+			m_pList(pList), m_run(run), m_pos(pos) {}
+
+		const MessageRunList* m_pList = nullptr;
+		size_t m_run = 0;
+		size_t m_pos = 0;
+	};
+
+	MessageRunList() : m_runs(1) {}
+
+	const_iterator begin() const {
+		return const_iterator(this, 0, 0);
+	}
+	const_iterator end() const {
+		return const_iterator(this, m_runs.size() - 1, m_runs.back().size());
+	}
+
+	// Gets the first entry whose snowflake is at least 'sf'.
+	const_iterator LowerBound(Snowflake sf) const;
+
+	// Gets the entry with this snowflake, or end().
+	const_iterator FindEntry(Snowflake sf) const;
+
+	static bool IsMarker(const Message& msg) {
+		return msg.IsLoadGap() || msg.m_type == MessageType::CHANNEL_HEADER;
+	}
+
+	MessagePtr Find(Snowflake sf) const;
+
+	// Adds an entry, or replaces the one with the same snowflake.  Returns the
+	// replaced entry, if any.
+	MessagePtr Put(const MessagePtr& msg);
+
+	// Adds a batch of entries sorted by snowflake.  Replaced entries are added
+	// to 'replaced'.
+	void PutSorted(const std::vector<MessagePtr>& msgs, std::vector<MessagePtr>& replaced);
+
+	// Removes an entry.  Returns it, if there was one.
+	MessagePtr Erase(Snowflake sf);
+
+	// Replaces all entries with the given ones, sorted by snowflake.
+	void Assign(const std::vector<MessagePtr>& entries);
+
+	// Gets all entries, sorted by snowflake.
+	void GetEntries(std::vector<MessagePtr>& out) const;
+
+	const std::vector<MessagePtr>& GetMarkers() const {
+		return m_markers;
+	}
+	size_t Size() const {
+		return m_size;
+	}
+	bool Empty() const {
+		return m_size == 0;
+	}
+
+	MessagePtr Lowest() const;
+	MessagePtr Highest() const;
+
+	// Calls func for each entry whose snowflake is at least 'from', in order.
+	template <typename Func>
+	void ForEach(Snowflake from, Func func) const
+	{
+		size_t index = GetRunIndex(from);
+		const std::vector<MessagePtr>& first = m_runs[index];
+
+		for (auto iter = LowerBound(first, from); iter != first.end(); ++iter)
+			func(*iter);
+
+		for (size_t i = index; i < m_markers.size(); i++)
+		{
+			func(m_markers[i]);
+
+			for (auto& msg : m_runs[i + 1])
+				func(msg);
+		}
+	}
+
+private:
+	typedef std::vector<MessagePtr> Run;
+
+	static Run::const_iterator LowerBound(const Run& run, Snowflake sf);
+	static Run::iterator LowerBound(Run& run, Snowflake sf);
+
+	// Gets the index of the run, or marker, where this snowflake belongs.
+	size_t GetRunIndex(Snowflake sf) const;
+	bool IsMarkerAt(size_t index, Snowflake sf) const;
+
+	MessagePtr PutMarker(const MessagePtr& msg);
+	void EraseMarker(size_t index);
+	void MergeInto(Run& run, Run::const_iterator begin, Run::const_iterator end, std::vector<MessagePtr>& replaced);
+
+	std::vector<Run> m_runs;
+	std::vector<MessagePtr> m_markers;
+	size_t m_size = 0;
+};
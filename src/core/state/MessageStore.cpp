@@ -0,0 +1,445 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <iterator>
+#include <nlohmann/json.h>
+#include "MessageStore.hpp"
+#include "../utils/Util.hpp"
+#include "../Frontend.hpp"
+
+using nlohmann::json;
+
+// Size a new store file starts out with.
+#define C_MESSAGE_STORE_INITIAL_SIZE (64 * 1024)
+
+#define C_MESSAGE_STORE_MAGIC   (0x534D4D44) // "DMMS"
+#define C_MESSAGE_STORE_VERSION (1)
+
+namespace
+{
+	enum eRecordKind
+	{
+		REC_MESSAGE = 1, // payload: the message's JSON
+		REC_GAP,         // a load gap, anchored to a message
+		REC_HEADER,      // the channel header.  The channel has no older messages
+		REC_ERASE,       // the entry with this snowflake was removed
+	};
+
+	struct StoreHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_version;
+		uint64_t m_used;
+		uint64_t m_recordCount;
+		uint64_t m_reserved;
+	};
+
+	// Followed by m_size bytes of payload, padded to a multiple of 8 bytes.
+	struct RecordHeader
+	{
+		uint32_t m_size;
+		uint8_t  m_kind;
+		uint8_t  m_msgType;
+		uint16_t m_reserved;
+		uint64_t m_snowflake;
+		uint64_t m_anchor;
+	};
+
+	size_t GetRecordSize(size_t payloadSize)
+	{
+		return sizeof(RecordHeader) + ((payloadSize + 7) & ~size_t(7));
+	}
+
+	void WriteRecord(uint8_t* pDest, int kind, int msgType, Snowflake snowflake, Snowflake anchor, const char* pData, size_t size)
+	{
+		RecordHeader rh;
+		rh.m_size = uint32_t(size);
+		rh.m_kind = uint8_t(kind);
+		rh.m_msgType = uint8_t(msgType);
+		rh.m_reserved = 0;
+		rh.m_snowflake = snowflake;
+		rh.m_anchor = anchor;
+
+		memcpy(pDest, &rh, sizeof rh);
+		if (size)
+			memcpy(pDest + sizeof rh, pData, size);
+
+		size_t padding = GetRecordSize(size) - sizeof rh - size;
+		if (padding)
+			memset(pDest + sizeof rh + size, 0, padding);
+	}
+}
+
+static MessageStore g_MessageStore;
+
+MessageStore* GetMessageStore()
+{
+	return &g_MessageStore;
+}
+
+MessageStore::~MessageStore()
+{
+	CloseAll();
+}
+
+std::string MessageStore::GetStorePath(Snowflake channel)
+{
+	return GetCachePath() + "\\msgs_" + std::to_string(channel) + ".dms";
+}
+
+void MessageStore::CloseAll()
+{
+	m_stores.clear();
+}
+
+MessageStore::ChannelStore* MessageStore::OpenStore(Snowflake channel, bool bCreate)
+{
+	auto iter = m_stores.find(channel);
+	if (iter != m_stores.end()) {
+		iter->second->m_lastUsed = ++m_useCounter;
+		return iter->second.get();
+	}
+
+	std::string path = GetStorePath(channel);
+
+	if (!bCreate)
+	{
+		// Don't create a file for every channel that's looked at.
+		FILE* f = fopen(path.c_str(), "rb");
+		if (!f)
+			return nullptr;
+		fclose(f);
+	}
+
+	// Close the least recently used store to make room.
+	if (m_stores.size() >= C_MAX_OPEN_MESSAGE_STORES)
+	{
+		auto oldest = m_stores.begin();
+		for (auto it = m_stores.begin(); it != m_stores.end(); ++it)
+		{
+			if (oldest->second->m_lastUsed > it->second->m_lastUsed)
+				oldest = it;
+		}
+
+		m_stores.erase(oldest);
+	}
+
+	std::unique_ptr<ChannelStore> pStore(new ChannelStore);
+	if (!pStore->m_file.Open(path) || !ReadStore(pStore.get())) {
+		DbgPrintF("Could not open message store %s", path.c_str());
+		return nullptr;
+	}
+
+	pStore->m_lastUsed = ++m_useCounter;
+
+	ChannelStore* pResult = pStore.get();
+	m_stores[channel] = std::move(pStore);
+	return pResult;
+}
+
+bool MessageStore::ReadStore(ChannelStore* pStore)
+{
+	MappedFile& file = pStore->m_file;
+
+	StoreHeader hdr;
+	bool valid = file.GetSize() >= sizeof hdr;
+
+	if (valid)
+	{
+		memcpy(&hdr, file.GetData(), sizeof hdr);
+		valid = hdr.m_magic == C_MESSAGE_STORE_MAGIC &&
+			hdr.m_version == C_MESSAGE_STORE_VERSION &&
+			hdr.m_used >= sizeof hdr &&
+			hdr.m_used <= file.GetSize();
+	}
+
+	pStore->m_index.clear();
+	pStore->m_recordCount = 0;
+
+	if (!valid)
+	{
+		// New or unreadable file, start over.
+		if (file.GetSize() < C_MESSAGE_STORE_INITIAL_SIZE && !file.Resize(C_MESSAGE_STORE_INITIAL_SIZE))
+			return false;
+
+		hdr.m_magic = C_MESSAGE_STORE_MAGIC;
+		hdr.m_version = C_MESSAGE_STORE_VERSION;
+		hdr.m_used = sizeof hdr;
+		hdr.m_recordCount = 0;
+		hdr.m_reserved = 0;
+		memcpy(file.GetData(), &hdr, sizeof hdr);
+
+		pStore->m_used = sizeof hdr;
+		return true;
+	}
+
+	// Replay the log.  If the last record was only partially written, it's
+	// dropped.
+	const uint8_t* pData = file.GetData();
+	size_t offset = sizeof hdr;
+
+	while (offset + sizeof(RecordHeader) <= hdr.m_used)
+	{
+		RecordHeader rh;
+		memcpy(&rh, pData + offset, sizeof rh);
+
+		size_t end = offset + GetRecordSize(rh.m_size);
+		if (end > hdr.m_used)
+			break;
+
+		if (rh.m_kind == REC_ERASE)
+			pStore->m_index.erase(rh.m_snowflake);
+		else
+			pStore->m_index[rh.m_snowflake] = offset;
+
+		pStore->m_recordCount++;
+		offset = end;
+	}
+
+	pStore->m_used = offset;
+	return true;
+}
+
+bool MessageStore::Append(ChannelStore* pStore, int kind, int msgType, Snowflake snowflake, Snowflake anchor, const char* pData, size_t size)
+{
+	MappedFile& file = pStore->m_file;
+	size_t recordSize = GetRecordSize(size);
+
+	if (pStore->m_used + recordSize > file.GetSize())
+	{
+		size_t newSize = file.GetSize() * 2;
+		if (newSize < pStore->m_used + recordSize + C_MESSAGE_STORE_INITIAL_SIZE)
+			newSize = pStore->m_used + recordSize + C_MESSAGE_STORE_INITIAL_SIZE;
+
+		if (!file.Resize(newSize))
+			return false;
+	}
+
+	size_t offset = pStore->m_used;
+	WriteRecord(file.GetData() + offset, kind, msgType, snowflake, anchor, pData, size);
+
+	pStore->m_used += recordSize;
+	pStore->m_recordCount++;
+
+	if (kind == REC_ERASE)
+		pStore->m_index.erase(snowflake);
+	else
+		pStore->m_index[snowflake] = offset;
+
+	// Only now that the record is complete, commit it.
+	StoreHeader hdr;
+	memcpy(&hdr, file.GetData(), sizeof hdr);
+	hdr.m_used = pStore->m_used;
+	hdr.m_recordCount = pStore->m_recordCount;
+	memcpy(file.GetData(), &hdr, sizeof hdr);
+	return true;
+}
+
+void MessageStore::Compact(ChannelStore* pStore)
+{
+	MappedFile& file = pStore->m_file;
+	const uint8_t* pData = file.GetData();
+
+	auto first = pStore->m_index.begin();
+	bool trimmed = false;
+	if (pStore->m_index.size() > C_MAX_STORED_MESSAGES) {
+		std::advance(first, pStore->m_index.size() - C_MAX_STORED_MESSAGES);
+		trimmed = true;
+	}
+
+	std::vector<uint8_t> live;
+	for (auto iter = first; iter != pStore->m_index.end(); ++iter)
+	{
+		RecordHeader rh;
+		memcpy(&rh, pData + iter->second, sizeof rh);
+
+		// If older messages were dropped, the oldest one left needs a gap
+		// above it, so that the rest can be fetched again.
+		if (trimmed && iter == first && rh.m_kind == REC_MESSAGE)
+		{
+			size_t offset = live.size();
+			live.resize(offset + GetRecordSize(0));
+			WriteRecord(live.data() + offset, REC_GAP, MessageType::GAP_UP, iter->first - 1, iter->first, nullptr, 0);
+		}
+
+		size_t recordSize = GetRecordSize(rh.m_size);
+		live.insert(live.end(), pData + iter->second, pData + iter->second + recordSize);
+	}
+
+	size_t used = sizeof(StoreHeader) + live.size();
+	size_t newSize = used + used / 2;
+	if (newSize < C_MESSAGE_STORE_INITIAL_SIZE)
+		newSize = C_MESSAGE_STORE_INITIAL_SIZE;
+
+	if (!file.Resize(newSize))
+		return;
+
+	StoreHeader hdr;
+	memcpy(&hdr, file.GetData(), sizeof hdr);
+	memcpy(file.GetData() + sizeof hdr, live.data(), live.size());
+	hdr.m_used = used;
+	memcpy(file.GetData(), &hdr, sizeof hdr);
+
+	DbgPrintF("Compacted message store from %d to %d records", int(pStore->m_recordCount), int(pStore->m_index.size()));
+	ReadStore(pStore);
+}
+
+void MessageStore::PutMessage(Snowflake channel, Snowflake message, const std::string& data)
+{
+	ChannelStore* pStore = OpenStore(channel, true);
+	if (!pStore)
+		return;
+
+	Append(pStore, REC_MESSAGE, MessageType::DEFAULT, message, 0, data.data(), data.size());
+}
+
+void MessageStore::PutGap(Snowflake channel, const Message& gap)
+{
+	ChannelStore* pStore = OpenStore(channel, true);
+	if (!pStore)
+		return;
+
+	Append(pStore, REC_GAP, gap.m_type, gap.m_snowflake, gap.m_anchor, nullptr, 0);
+}
+
+void MessageStore::PutHeader(Snowflake channel)
+{
+	ChannelStore* pStore = OpenStore(channel, true);
+	if (!pStore)
+		return;
+
+	Append(pStore, REC_HEADER, MessageType::CHANNEL_HEADER, 1, 0, nullptr, 0);
+}
+
+void MessageStore::Erase(Snowflake channel, Snowflake snowflake)
+{
+	ChannelStore* pStore = OpenStore(channel, false);
+	if (!pStore || !pStore->m_index.count(snowflake))
+		return;
+
+	Append(pStore, REC_ERASE, 0, snowflake, 0, nullptr, 0);
+}
+
+bool MessageStore::GetMessageData(Snowflake channel, Snowflake message, std::string& data)
+{
+	ChannelStore* pStore = OpenStore(channel, false);
+	if (!pStore)
+		return false;
+
+	auto iter = pStore->m_index.find(message);
+	if (iter == pStore->m_index.end())
+		return false;
+
+	const uint8_t* pRecord = pStore->m_file.GetData() + iter->second;
+	RecordHeader rh;
+	memcpy(&rh, pRecord, sizeof rh);
+
+	if (rh.m_kind != REC_MESSAGE)
+		return false;
+
+	data.assign((const char*) pRecord + sizeof rh, rh.m_size);
+	return true;
+}
+
+bool MessageStore::GetAllMessageData(Snowflake channel, std::vector<std::pair<Snowflake, std::string>>& out)
+{
+	ChannelStore* pStore = OpenStore(channel, false);
+	if (!pStore)
+		return false;
+
+	const uint8_t* pData = pStore->m_file.GetData();
+	out.reserve(out.size() + pStore->m_index.size());
+
+	for (auto& entry : pStore->m_index)
+	{
+		RecordHeader rh;
+		memcpy(&rh, pData + entry.second, sizeof rh);
+
+		if (rh.m_kind == REC_MESSAGE)
+			out.push_back(std::make_pair(entry.first, std::string((const char*) pData + entry.second + sizeof rh, rh.m_size)));
+	}
+
+	return true;
+}
+
+bool MessageStore::LoadChannel(Snowflake channel, Snowflake guild, const std::string& channelName, std::map<Snowflake, MessagePtr>& out)
+{
+	ChannelStore* pStore = OpenStore(channel, false);
+	if (!pStore || pStore->m_index.empty())
+		return false;
+
+	// Get rid of the dead records every once in a while.
+	if (pStore->m_recordCount > 2 * pStore->m_index.size() + 64 || pStore->m_index.size() > C_MAX_STORED_MESSAGES)
+		Compact(pStore);
+
+	const uint8_t* pData = pStore->m_file.GetData();
+	int loaded = 0;
+	bool trimmed = false;
+	MessagePtr lowest;
+
+	for (auto iter = pStore->m_index.rbegin(); iter != pStore->m_index.rend(); ++iter)
+	{
+		if (loaded >= C_MAX_LOADED_STORED_MESSAGES) {
+			trimmed = true;
+			break;
+		}
+
+		RecordHeader rh;
+		memcpy(&rh, pData + iter->second, sizeof rh);
+
+		MessagePtr msg = MakeMessage();
+
+		switch (rh.m_kind)
+		{
+			case REC_MESSAGE:
+			{
+				const char* pJson = (const char*) pData + iter->second + sizeof rh;
+				json j = json::parse(pJson, pJson + rh.m_size, nullptr, false);
+				if (j.is_discarded())
+					continue;
+
+				try {
+					msg->Load(j, guild);
+				}
+				catch (json::exception&) {
+					continue;
+				}
+				break;
+			}
+			case REC_GAP:
+			{
+				msg->m_type = (MessageType::eType) rh.m_msgType;
+				msg->m_snowflake = rh.m_snowflake;
+				msg->m_anchor = rh.m_anchor;
+				msg->m_author = GetFrontend()->GetPleaseWaitText();
+				break;
+			}
+			case REC_HEADER:
+			{
+				msg->m_type = MessageType::CHANNEL_HEADER;
+				msg->m_snowflake = rh.m_snowflake;
+				msg->m_author = channelName;
+				break;
+			}
+			default:
+				continue;
+		}
+
+		out[msg->m_snowflake] = msg;
+		lowest = msg;
+		loaded++;
+	}
+
+	// The rest is fetched from the server when scrolled to.
+	if (trimmed && lowest && !lowest->IsLoadGap())
+	{
+		MessagePtr msg = MakeMessage();
+		msg->m_type = MessageType::GAP_UP;
+		msg->m_anchor = lowest->m_snowflake;
+		msg->m_snowflake = lowest->m_snowflake - 1;
+		msg->m_author = GetFrontend()->GetPleaseWaitText();
+		out[msg->m_snowflake] = msg;
+	}
+
+	return !out.empty();
+}
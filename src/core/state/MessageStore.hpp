@@ -0,0 +1,76 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../models/Snowflake.hpp"
+#include "../models/Message.hpp"
+#include "../utils/MappedFile.hpp"
+
+// Maximum amount of channel stores kept open at once.
+#define C_MAX_OPEN_MESSAGE_STORES (16)
+
+// Maximum amount of entries loaded from a channel's store when its message
+// list is created.  Anything older is fetched from the server again.
+#define C_MAX_LOADED_STORED_MESSAGES (100)
+
+// Maximum amount of entries kept in a channel's store.  The oldest ones are
+// dropped when the store is compacted.
+#define C_MAX_STORED_MESSAGES (1000)
+
+// Persistent message store.  Each channel has a memory mapped file in the
+// cache directory, holding an append-only log of changes to the channel's
+// message list: messages (as the JSON received from Discord), load gaps, the
+// channel header, and erasures.  Replaying the log gives back the message
+// list as it was, gaps included, so that only what's missing has to be
+// fetched from the server.
+class MessageStore
+{
+public:
+	~MessageStore();
+
+	void PutMessage(Snowflake channel, Snowflake message, const std::string& data);
+	void PutGap(Snowflake channel, const Message& gap);
+	void PutHeader(Snowflake channel);
+	void Erase(Snowflake channel, Snowflake snowflake);
+
+	// Gets the JSON of a stored message.
+	bool GetMessageData(Snowflake channel, Snowflake message, std::string& data);
+
+	// Gets the JSON of all messages stored for a channel.
+	bool GetAllMessageData(Snowflake channel, std::vector<std::pair<Snowflake, std::string>>& out);
+
+	// Loads the newest entries of a channel's message list.  Returns false if
+	// nothing was stored for this channel.
+	bool LoadChannel(Snowflake channel, Snowflake guild, const std::string& channelName, std::map<Snowflake, MessagePtr>& out);
+
+	// Whether the channel's store is open already, so reading it is cheap.
+	bool IsOpen(Snowflake channel) const {
+		return m_stores.count(channel) != 0;
+	}
+
+	void CloseAll();
+
+private:
+	struct ChannelStore
+	{
+		MappedFile m_file;
+		std::map<Snowflake, size_t> m_index; // snowflake -> offset of its latest record
+		size_t m_used = 0;
+		size_t m_recordCount = 0;
+		uint64_t m_lastUsed = 0;
+	};
+
+	ChannelStore* OpenStore(Snowflake channel, bool bCreate);
+	bool ReadStore(ChannelStore* pStore);
+	bool Append(ChannelStore* pStore, int kind, int msgType, Snowflake snowflake, Snowflake anchor, const char* pData, size_t size);
+	void Compact(ChannelStore* pStore);
+
+	static std::string GetStorePath(Snowflake channel);
+
+	std::map<Snowflake, std::unique_ptr<ChannelStore>> m_stores;
+	uint64_t m_useCounter = 0;
+};
+
+MessageStore* GetMessageStore();
@@ -8,26 +8,24 @@ NotificationManager::NotificationManager(DiscordInstance* pDiscord):
 {
 }
 
-void NotificationManager::OnMessageCreate(Snowflake guildID, Snowflake channelID, const Message& msg)
+void NotificationManager::OnMessageCreate(Snowflake guildID, Snowflake channelID, const MessagePtr& msg)
 {
-	if (!IsNotificationWorthy(guildID, channelID, msg))
+	if (!IsNotificationWorthy(guildID, channelID, *msg))
 		return;
 
-	if (GetDiscordInstance()->IsUserBlocked(msg.m_author_snowflake))
+	if (GetDiscordInstance()->IsUserBlocked(msg->m_author_snowflake))
 		return;
 
 	if (GetDiscordInstance()->IsChannelMuted(guildID, channelID))
 		return;
 
 	Notification notif;
-	notif.m_author = msg.m_author;
-	notif.m_contents = msg.m_message;
-	notif.m_avatarLnk = msg.m_avatar;
+	notif.m_pMessage = msg;
 	notif.m_sourceGuild = guildID;
 	notif.m_sourceChannel = channelID;
-	notif.m_sourceMessage = msg.m_snowflake;
-	notif.m_timeReceived = msg.m_dateTime;
-	notif.m_bIsReply = msg.m_type == MessageType::REPLY;
+	notif.m_sourceMessage = msg->m_snowflake;
+	notif.m_timeReceived = msg->m_dateTime;
+	notif.m_bIsReply = msg->m_type == MessageType::REPLY;
 
 	m_notifications.push_front(notif);
 	GetFrontend()->OnNotification();
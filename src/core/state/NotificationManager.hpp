@@ -9,9 +9,8 @@ class DiscordInstance;
 
 struct Notification
 {
-	std::string m_author;
-	std::string m_contents;
-	std::string m_avatarLnk;
+	// The message shown by the notification, shared with the message cache.
+	MessagePtr m_pMessage;
 	time_t m_timeReceived = 0;
 	Snowflake m_sourceGuild = 0, m_sourceChannel = 0, m_sourceMessage = 0;
 	bool m_bRead = false;
@@ -22,7 +21,7 @@ class NotificationManager
 {
 public:
 	NotificationManager(DiscordInstance*);
-	void OnMessageCreate(Snowflake guildID, Snowflake channelID, const Message& msg);
+	void OnMessageCreate(Snowflake guildID, Snowflake channelID, const MessagePtr& msg);
 	Notification* GetLatestNotification();
 	void MarkNotificationsRead(Snowflake channelID);
 
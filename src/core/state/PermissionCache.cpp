@@ -0,0 +1,98 @@
+#include "PermissionCache.hpp"
+#include "../models/Guild.hpp"
+#include "../DiscordInstance.hpp"
+
+uint64_t PermissionCache::GetCurrentUserPermissions(Guild* pGuild, const Channel* pChannel)
+{
+	if (pChannel->m_bCurrentUserPermsCalculated &&
+		pChannel->m_currentUserPermsGeneration == pGuild->m_permissionGeneration)
+		return pChannel->m_currentUserPerms;
+
+	Snowflake currUser = GetDiscordInstance()->m_mySnowflake;
+	pChannel->m_currentUserPerms = pChannel->ComputePermissionOverwrites(pGuild, currUser, pGuild->ComputeBasePermissions(currUser));
+	pChannel->m_currentUserPermsGeneration = pGuild->m_permissionGeneration;
+	pChannel->m_bCurrentUserPermsCalculated = true;
+	return pChannel->m_currentUserPerms;
+}
+
+uint64_t PermissionCache::GetUserPermissions(Guild* pGuild, const Channel* pChannel, Snowflake user)
+{
+	if (user == GetDiscordInstance()->m_mySnowflake)
+		return GetCurrentUserPermissions(pGuild, pChannel);
+
+	Key key(pChannel->m_snowflake, user);
+	auto iter = m_index.find(key);
+	if (iter != m_index.end())
+	{
+		auto entryIter = iter->second;
+		if (entryIter->m_generation == pGuild->m_permissionGeneration)
+		{
+			m_entries.splice(m_entries.begin(), m_entries, entryIter);
+			return entryIter->m_permissions;
+		}
+
+		Erase(entryIter);
+	}
+
+	Entry entry;
+	entry.m_guild = pGuild->m_snowflake;
+	entry.m_channel = pChannel->m_snowflake;
+	entry.m_user = user;
+	entry.m_generation = pGuild->m_permissionGeneration;
+	entry.m_permissions = pChannel->ComputePermissionOverwrites(pGuild, user, pGuild->ComputeBasePermissions(user));
+
+	m_entries.push_front(entry);
+	m_index[key] = m_entries.begin();
+
+	if (m_entries.size() > C_MAX_CACHED_USER_PERMS)
+		Erase(std::prev(m_entries.end()));
+
+	return entry.m_permissions;
+}
+
+void PermissionCache::InvalidateGuild(Guild* pGuild)
+{
+	pGuild->m_permissionGeneration = ++m_generation;
+}
+
+void PermissionCache::InvalidateChannel(const Channel* pChannel)
+{
+	pChannel->m_bCurrentUserPermsCalculated = false;
+
+	for (auto iter = m_entries.begin(); iter != m_entries.end(); )
+	{
+		auto next = std::next(iter);
+		if (iter->m_channel == pChannel->m_snowflake)
+			Erase(iter);
+		iter = next;
+	}
+}
+
+void PermissionCache::InvalidateMember(Guild* pGuild, Snowflake user)
+{
+	// The current user's permissions are stored in every channel of the guild.
+	if (user == GetDiscordInstance()->m_mySnowflake) {
+		InvalidateGuild(pGuild);
+		return;
+	}
+
+	for (auto iter = m_entries.begin(); iter != m_entries.end(); )
+	{
+		auto next = std::next(iter);
+		if (iter->m_user == user && iter->m_guild == pGuild->m_snowflake)
+			Erase(iter);
+		iter = next;
+	}
+}
+
+void PermissionCache::Clear()
+{
+	m_entries.clear();
+	m_index.clear();
+}
+
+void PermissionCache::Erase(std::list<Entry>::iterator iter)
+{
+	m_index.erase(Key(iter->m_channel, iter->m_user));
+	m_entries.erase(iter);
+}
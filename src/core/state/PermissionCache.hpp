@@ -0,0 +1,57 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include "../models/Snowflake.hpp"
+
+// Maximum amount of permission sets of other users that are cached.
+#define C_MAX_CACHED_USER_PERMS (1024)
+
+struct Guild;
+struct Channel;
+
+// Caches the permissions users have in channels.  The current user's are kept
+// in the channels themselves, and other users' in a list of the most recently
+// used ones.  Both are tagged with the guild's permission generation, which is
+// bumped whenever its roles or owner change.
+//
+// N.B. Only used from the main thread.
+class PermissionCache
+{
+public:
+	uint64_t GetCurrentUserPermissions(Guild* pGuild, const Channel* pChannel);
+	uint64_t GetUserPermissions(Guild* pGuild, const Channel* pChannel, Snowflake user);
+
+	// The guild's roles or owner changed.
+	void InvalidateGuild(Guild* pGuild);
+
+	// The channel's permission overwrites changed.
+	void InvalidateChannel(const Channel* pChannel);
+
+	// A member of the guild got or lost roles.
+	void InvalidateMember(Guild* pGuild, Snowflake user);
+
+	void Clear();
+
+private:
+	struct Entry
+	{
+		Snowflake m_guild = 0;
+		Snowflake m_channel = 0;
+		Snowflake m_user = 0;
+		uint32_t m_generation = 0;
+		uint64_t m_permissions = 0;
+	};
+
+	typedef std::pair<Snowflake, Snowflake> Key; // channel, user
+
+	void Erase(std::list<Entry>::iterator iter);
+
+	// Most recently used entries first.
+	std::list<Entry> m_entries;
+	std::map<Key, std::list<Entry>::iterator> m_index;
+
+	// Handed out to guilds when their permissions change.  Never reused, so
+	// that a replaced guild doesn't match entries of the old one.
+	uint32_t m_generation = 0;
+};
@@ -1,8 +1,11 @@
 #include "../network/DiscordAPI.hpp"
 #include "ProfileCache.hpp"
+#include "MessageCache.hpp"
+#include "../config/LocalSettings.hpp"
 #include "../utils/Util.hpp"
 #include "../Frontend.hpp"
 #include "../network/DiscordRequest.hpp"
+#include "../network/HTTPCache.hpp"
 #include "../DiscordInstance.hpp"
 
 static ProfileCache g_ProfileCache;
@@ -12,16 +15,32 @@ ProfileCache* GetProfileCache()
 	return &g_ProfileCache;
 }
 
+ProfileCache::ProfileCache() :
+	m_profilePool(sizeof(Profile))
+{
+}
+
 ProfileCache::~ProfileCache()
 {
+	ClearAll();
 }
 
 Profile* ProfileCache::LookupProfile(Snowflake user, const std::string& username, const std::string& globalName, const std::string& avatarLink, bool bRequestServer)
 {
-	Profile* pProf = &m_profileSets[user];
-
-	if (!pProf->m_bUsingDefaultData)
-		return pProf;
+	Profile* pProf;
+	Profile** ppProf = m_profiles.Find(user);
+	if (ppProf)
+	{
+		pProf = *ppProf;
+		if (!pProf->m_bUsingDefaultData)
+			return pProf;
+	}
+	else
+	{
+		pProf = new (m_profilePool.Allocate()) Profile;
+		m_profiles.Insert(user, pProf);
+		m_addedSinceCheck++;
+	}
 
 	pProf->m_snowflake = user;
 
@@ -36,7 +55,7 @@ Profile* ProfileCache::LookupProfile(Snowflake user, const std::string& username
 	}
 
 	if (bRequestServer)
-		RequestLoadProfile(user);
+		RequestProfile(user, 0, DEMAND_VISIBLE);
 
 	return pProf;
 }
@@ -59,9 +78,7 @@ Profile* ProfileCache::LoadProfile(Snowflake user, const nlohmann::json& jx)
 	std::string oldAvatar = pf->m_avatarlnk;
 	bool oldIsBot = pf->m_bIsBot;
 
-	auto iter = m_processingRequests.find(user);
-	if (iter != m_processingRequests.end())
-		m_processingRequests.erase(iter);
+	GetDiscordInstance()->m_profileFetchScheduler.OnProfileLoaded(user);
 
 	const auto& userData = jx.contains("user") ? jx["user"] : jx;
 
@@ -112,16 +129,33 @@ Profile* ProfileCache::LoadProfile(Snowflake user, const nlohmann::json& jx)
 
 void ProfileCache::ClearAll()
 {
-	m_profileSets.clear();
-	m_processingRequests.clear();
+	std::vector<Profile*> profiles;
+	profiles.reserve(m_profiles.Size());
+	m_profiles.ForEach([&](Snowflake, Profile* pProf) {
+		profiles.push_back(pProf);
+	});
+
+	for (Profile* pProf : profiles) {
+		pProf->~Profile();
+		m_profilePool.Free(pProf);
+	}
+
+	m_memberTables.ForEach([](Snowflake, GuildMemberTable* pTable) {
+		delete pTable;
+	});
+
+	m_profiles.Clear();
+	m_memberTables.Clear();
 }
 
 void ProfileCache::ProfileDoesntExist(Snowflake user, Snowflake guild)
 {
-	Profile* pf = &m_profileSets[user];
-	pf->m_guildMembers[guild].m_bIsLoadedFromChunk = true;
-	pf->m_guildMembers[guild].m_bIsGroup = false;
-	pf->m_guildMembers[guild].m_bExists = false;
+	GuildMember member = LookupGuildMember(user, guild);
+	member.SetLoadedFromChunk(true);
+	member.SetGroup(false);
+	member.SetExists(false);
+
+	GetDiscordInstance()->m_profileFetchScheduler.OnProfileLoaded(user);
 }
 
 bool ProfileCache::NeedRequestGuildMember(Snowflake user, Snowflake guild)
@@ -131,26 +165,234 @@ bool ProfileCache::NeedRequestGuildMember(Snowflake user, Snowflake guild)
 
 	// TODO: Deleted User
 
-	Profile* pf = LookupProfile(user, "", "", "", false);
-	if (!pf->HasGuildMemberProfile(guild))
-		return true;
-	
-	if (!pf->m_guildMembers[guild].m_bIsLoadedFromChunk)
-		return true;
+	GuildMember member = FindGuildMember(user, guild);
+	if (member.IsValid() && member.IsLoadedFromChunk())
+		return false;
 
-	return false;
+	return !GetDiscordInstance()->m_memberRequestTracker.IsPending(guild, user);
 }
 
 void ProfileCache::ForgetProfile(Snowflake user)
 {
-	auto iter = m_profileSets.find(user);
-	if (iter != m_profileSets.end())
-		m_profileSets.erase(iter);
+	Profile** ppProf = m_profiles.Find(user);
+	if (!ppProf)
+		return;
+
+	Profile* pProf = *ppProf;
+	m_profiles.Erase(user);
+	pProf->~Profile();
+	m_profilePool.Free(pProf);
+}
+
+GuildMember ProfileCache::LookupGuildMember(Snowflake user, Snowflake guild)
+{
+	GuildMemberTable* pTable = GetMemberTable(guild);
+	size_t oldSize = pTable->Size();
+	GuildMember member = pTable->Lookup(user);
+
+	if (pTable->Size() != oldSize)
+		m_addedSinceCheck++;
+
+	return member;
+}
+
+GuildMember ProfileCache::FindGuildMember(Snowflake user, Snowflake guild)
+{
+	GuildMemberTable** ppTable = m_memberTables.Find(guild);
+	if (!ppTable)
+		return GuildMember();
+
+	return (*ppTable)->Find(user);
 }
 
-void ProfileCache::RequestExtraData(Snowflake user, Snowflake guild, bool mutualGuilds, bool mutualFriends)
+void ProfileCache::ForgetGuildMember(Snowflake user, Snowflake guild)
 {
-	RequestLoadProfile(user, guild, mutualGuilds, mutualFriends);
+	GuildMemberTable** ppTable = m_memberTables.Find(guild);
+	if (ppTable)
+		(*ppTable)->Remove(user);
+}
+
+GuildMemberTable* ProfileCache::GetMemberTable(Snowflake guild)
+{
+	GuildMemberTable** ppTable = m_memberTables.Find(guild);
+	if (ppTable)
+		return *ppTable;
+
+	GuildMemberTable* pTable = new GuildMemberTable(guild);
+	m_memberTables.Insert(guild, pTable);
+	return pTable;
+}
+
+void ProfileCache::RequestProfile(Snowflake user, Snowflake guild, eProfileDemand demand)
+{
+	// A visible member of a guild is fetched with a member request, which
+	// brings their guild member data along with the basic profile.
+	if (demand == DEMAND_VISIBLE && guild)
+	{
+		if (!NeedRequestGuildMember(user, guild))
+			return;
+	}
+	else
+	{
+		Profile** ppProf = m_profiles.Find(user);
+		if (ppProf)
+		{
+			Profile* pProf = *ppProf;
+			if (demand == DEMAND_VISIBLE ? !pProf->m_bUsingDefaultData : pProf->m_bExtraDataFetched)
+				return;
+		}
+	}
+
+	GetDiscordInstance()->m_profileFetchScheduler.Request(user, guild, demand);
+}
+
+void ProfileCache::PinProfile(Snowflake user)
+{
+	int* pCount = m_pins.Find(user);
+	if (pCount)
+		(*pCount)++;
+	else
+		m_pins.Insert(user, 1);
+}
+
+void ProfileCache::UnpinProfile(Snowflake user)
+{
+	int* pCount = m_pins.Find(user);
+	assert(pCount);
+	if (!pCount)
+		return;
+
+	if (--(*pCount) == 0)
+		m_pins.Erase(user);
+}
+
+void ProfileCache::TrimIfNeeded()
+{
+	if (m_addedSinceCheck < C_PROFILE_CACHE_CHECK_INTERVAL)
+		return;
+
+	m_addedSinceCheck = 0;
+
+	size_t budget = size_t(GetLocalSettings()->GetProfileCacheBudget()) * 1024 * 1024;
+	if (budget == 0)
+		return;
+
+	if (GetMemoryUsage() <= budget)
+		return;
+
+	// N.B. Only needed for the print, which release builds leave out.
+#ifdef USE_DEBUG_PRINTS
+	ProfileCacheStats before = m_stats;
+#endif
+
+	Evict();
+
+	DbgPrintF(
+		"Profile cache trimmed to %d KB (budget %d KB).  Evicted %d profiles and %d guild members, %d trims so far",
+		int(GetMemoryUsage() / 1024),
+		int(budget / 1024),
+		int(m_stats.m_evictedProfiles - before.m_evictedProfiles),
+		int(m_stats.m_evictedMembers - before.m_evictedMembers),
+		int(m_stats.m_trims)
+	);
+}
+
+void ProfileCache::Evict()
+{
+	DiscordInstance* pInst = GetDiscordInstance();
+	SnowflakeMap<bool> keep;
+
+	keep.Insert(pInst->m_mySnowflake, true);
+	m_pins.ForEach([&](Snowflake user, int) {
+		keep.Insert(user, true);
+	});
+
+	// Keep the guild members that are shown in the member lists or by the
+	// loaded messages.  The current user's are needed to check permissions.
+	m_memberTables.ForEach([&](Snowflake, GuildMemberTable* pTable) {
+		pTable->ClearMarks();
+		keep.ForEach([&](Snowflake user, bool) {
+			pTable->Mark(user);
+		});
+	});
+
+	for (auto& guild : pInst->m_guilds)
+	{
+		GuildMemberTable** ppTable = m_memberTables.Find(guild.m_snowflake);
+		if (!ppTable)
+			continue;
+
+		guild.m_members.ForEach([&](Snowflake member, bool bIsGroup) {
+			(*ppTable)->Mark(member);
+		});
+	}
+
+	GetMessageCache()->ForEachUser([&](Snowflake guild, Snowflake user) {
+		GuildMemberTable** ppTable = m_memberTables.Find(guild);
+		if (ppTable)
+			(*ppTable)->Mark(user);
+
+		keep.Insert(user, true);
+	});
+
+	m_memberTables.ForEach([&](Snowflake, GuildMemberTable* pTable) {
+		m_stats.m_evictedMembers += pTable->RemoveUnmarked();
+		pTable->ForEachUser([&](Snowflake user) {
+			keep.Insert(user, true);
+		});
+	});
+
+	// Keep the profiles of the remaining members, and of the users in DMs
+	// and relationships.
+	for (auto& chan : pInst->m_dmGuild.m_channels)
+	{
+		for (Snowflake user : chan.m_recipients)
+			keep.Insert(user, true);
+	}
+
+	for (auto& rel : pInst->m_relationships)
+		keep.Insert(rel.m_userID, true);
+
+	std::vector<Snowflake> evicted;
+	m_profiles.ForEach([&](Snowflake user, Profile*) {
+		if (!keep.Find(user))
+			evicted.push_back(user);
+	});
+
+	for (Snowflake user : evicted)
+		ForgetProfile(user);
+
+	m_stats.m_evictedProfiles += evicted.size();
+	m_stats.m_trims++;
+}
+
+size_t ProfileCache::GetMemoryUsage() const
+{
+	size_t size = m_profilePool.GetMemoryUsage() + m_profiles.GetMemoryUsage() + m_memberTables.GetMemoryUsage();
+
+	// The pool already counts the profiles themselves.
+	m_profiles.ForEach([&](Snowflake, Profile* pProf) {
+		size += pProf->GetMemoryUsage() - sizeof(Profile);
+	});
+
+	m_memberTables.ForEach([&](Snowflake, GuildMemberTable* pTable) {
+		size += sizeof(GuildMemberTable) + pTable->GetMemoryUsage();
+	});
+
+	return size;
+}
+
+ProfileCacheStats ProfileCache::GetStats() const
+{
+	ProfileCacheStats stats = m_stats;
+	stats.m_profiles = m_profiles.Size();
+	stats.m_memoryUsage = GetMemoryUsage();
+
+	m_memberTables.ForEach([&](Snowflake, GuildMemberTable* pTable) {
+		stats.m_members += pTable->Size();
+	});
+
+	return stats;
 }
 
 void ProfileCache::RequestNote(Snowflake user)
@@ -173,6 +415,8 @@ void ProfileCache::PutNote(Snowflake user, const std::string& note) const
 	nlohmann::json j;
 	j["note"] = note;
 
+	GetHTTPCache()->Invalidate(GetDiscordAPI() + "users/@me/notes/" + std::to_string(user), GetDiscordInstance()->GetToken());
+
 	GetHTTPClient()->PerformRequest(
 		true,
 		NetRequest::PUT_JSON,
@@ -183,36 +427,3 @@ void ProfileCache::PutNote(Snowflake user, const std::string& note) const
 		GetDiscordInstance()->GetToken()
 	);
 }
-
-void ProfileCache::RequestLoadProfile(Snowflake user, Snowflake guild, bool mutualGuilds, bool mutualFriends)
-{
-	if (!user)
-		return;
-
-	if (m_processingRequests.find(user) != m_processingRequests.end())
-		return;
-
-	m_processingRequests.insert(user);
-
-	std::string additionalData = "";
-	std::string userSource = "";
-	
-	additionalData += "&with_mutual_guilds=" + std::string(mutualGuilds ? "true" : "false");
-	additionalData += "&with_mutual_friends=" + std::string(mutualFriends ? "true" : "false");
-	additionalData += "&with_mutual_friends_count=" + std::string(mutualFriends ? "true" : "false");
-	if (guild) additionalData += "&guild_id=" + std::to_string(guild);
-
-	if (!additionalData.empty() && additionalData[0] == '&')
-		additionalData[0] = '?';
-
-	GetHTTPClient()->PerformRequest(
-		true,
-		NetRequest::GET,
-		GetDiscordAPI() + "users/" + std::to_string(user) + "/profile",
-		DiscordRequest::PROFILE,
-		user,
-		additionalData,
-		GetDiscordInstance()->GetToken(),
-		"0"
-	);
-}
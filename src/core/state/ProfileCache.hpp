@@ -4,15 +4,43 @@
 #include <nlohmann/json.h>
 #include "../models/Profile.hpp"
 #include "../models/Guild.hpp"
+#include "../models/SnowflakeMap.hpp"
+#include "../utils/FixedPool.hpp"
+#include "ProfileFetchScheduler.hpp"
 
+// Amount of profiles and guild members added between checks of whether the
+// profile cache is over its budget.
+#define C_PROFILE_CACHE_CHECK_INTERVAL (1024)
+
+struct ProfileCacheStats
+{
+	size_t m_profiles = 0;
+	size_t m_members = 0;
+	size_t m_memoryUsage = 0;
+
+	// Since the start of the session.
+	size_t m_trims = 0;
+	size_t m_evictedProfiles = 0;
+	size_t m_evictedMembers = 0;
+};
+
+// Keeps the profiles of users, and the members of each guild.  Profiles are
+// found through a hash table, and stay at the same address until forgotten.
+// The members of each guild are kept in their own GuildMemberTable.
+//
+// When the cache goes over its budget, the profiles and members that nothing
+// shows are evicted: those that aren't in a member list, in the loaded
+// messages, in a DM or a relationship, and aren't pinned.
 class ProfileCache
 {
 public:
+	ProfileCache();
 	~ProfileCache();
 	
 	// Looks up a profile.
 	// Username and globalname are filled in to create a default profile if the profile is not cached.
 	// Returns NULL if the Discord servers have reported that the user does not exist.
+	// If bRequestServer is set, a profile that isn't cached is fetched as a visible one.
 	Profile* LookupProfile(Snowflake user, const std::string& username, const std::string& globalName, const std::string& avatarLink, bool bRequestServer = true);
 	Profile* LoadProfile(Snowflake user, const nlohmann::json& j);
 
@@ -21,27 +49,63 @@ public:
 	// Let the profile cache know that the specified profile doesn't exist in this guild
 	void ProfileDoesntExist(Snowflake user, Snowflake guild);
 
-	// Check if the guild member needs to be requested
+	// Check if the guild member needs to be requested, and isn't already
+	// being requested
 	bool NeedRequestGuildMember(Snowflake user, Snowflake guild);
 
 	// Forget a profile.
 	void ForgetProfile(Snowflake user);
 
-	// Request extra data from a profile.
-	void RequestExtraData(Snowflake user, Snowflake guild = 0, bool mutualGuilds = true, bool mutualFriends = true);
+	// Gets a member of a guild, adding them if needed.
+	GuildMember LookupGuildMember(Snowflake user, Snowflake guild);
+
+	// Returns an invalid handle if the member isn't known.
+	GuildMember FindGuildMember(Snowflake user, Snowflake guild);
+
+	// Forget a member of a guild.  Handles to them must not be used afterwards.
+	void ForgetGuildMember(Snowflake user, Snowflake guild);
+
+	// Gets the table of a guild's members, creating it if needed.
+	GuildMemberTable* GetMemberTable(Snowflake guild);
+
+	// Fetches a profile, unless what the demand needs is already cached.  A
+	// visible user only needs the basic profile, or their guild member data if
+	// a guild is given, others the extra data too.
+	void RequestProfile(Snowflake user, Snowflake guild, eProfileDemand demand);
 
 	// Request note data from a profile.
 	void RequestNote(Snowflake user);
 
+	// Keeps the user's profile and guild members from being evicted, for as
+	// long as they're kept on screen.  Every pin must be undone by an unpin.
+	void PinProfile(Snowflake user);
+	void UnpinProfile(Snowflake user);
+
+	// Evicts what's not in use if the cache is over its budget.  Profile and
+	// GuildMember pointers that aren't pinned are invalidated, so this is
+	// only called before handling a gateway message or a response.
+	void TrimIfNeeded();
+
+	size_t GetMemoryUsage() const;
+	ProfileCacheStats GetStats() const;
+
 protected:
 	friend struct Profile;
 	void PutNote(Snowflake user, const std::string& note) const;
 
 private:
-	void RequestLoadProfile(Snowflake user, Snowflake guild = 0, bool mutualGuilds = true, bool mutualFriends = true);
+	void Evict();
+
+	SnowflakeMap<Profile*> m_profiles;
+	FixedPool m_profilePool;
+
+	SnowflakeMap<GuildMemberTable*> m_memberTables;
+
+	// Pin counts, by user.
+	SnowflakeMap<int> m_pins;
 
-	std::map<Snowflake, Profile> m_profileSets;
-	std::set<Snowflake> m_processingRequests;
+	size_t m_addedSinceCheck = 0;
+	ProfileCacheStats m_stats;
 };
 
 ProfileCache* GetProfileCache();
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include "../network/DiscordAPI.hpp"
+#include "ProfileFetchScheduler.hpp"
+#include "../network/DiscordRequest.hpp"
+#include "../network/HTTPClient.hpp"
+#include "../DiscordInstance.hpp"
+#include "../Frontend.hpp"
+#include "../utils/Util.hpp"
+
+void ProfileFetchScheduler::Request(Snowflake user, Snowflake guild, eProfileDemand demand)
+{
+	if (!user)
+		return;
+
+	// Fetches for visible users only bring the basic profile, and not the
+	// extra data the popout shows.
+	const InFlight* pInFlight = m_inFlight.Find(user);
+	if (pInFlight && (demand == DEMAND_VISIBLE || pInFlight->m_demand != DEMAND_VISIBLE))
+		return;
+
+	const Pending* pOld = m_pending.Find(user);
+	if (pOld && pOld->m_demand >= demand)
+		return;
+
+	Pending pending;
+	pending.m_guild = guild;
+	pending.m_demand = demand;
+	if (!guild && pOld)
+		pending.m_guild = pOld->m_guild;
+
+	m_pending.Insert(user, pending);
+	GetQueue(pending).push_back(user);
+
+	// Give the other users on screen a moment to be asked for, so that they
+	// can share a member request.
+	if (UseMemberRequest(pending)) {
+		ScheduleTimer(GetTimeMs() + C_PROFILE_MEMBER_BATCH_DELAY_MS);
+		return;
+	}
+
+	Pump();
+}
+
+void ProfileFetchScheduler::Pump()
+{
+	uint64_t now = GetTimeMs();
+	if (now - m_windowStart >= 1000)
+	{
+		m_windowStart = now;
+		m_restRequestsSent = 0;
+		m_memberRequestsSent = 0;
+		ExpireInFlight(now);
+	}
+
+	PumpRestRequests(now);
+	PumpMemberRequests(now);
+
+	// Whatever was held back by the limits goes out in the next window, or
+	// once the rate limit is over.  Member requests wait for the gateway to
+	// connect instead, which pumps the queue again.
+	bool bRestWaiting = false;
+	for (auto& queue : m_restQueues)
+		bRestWaiting |= !queue.empty();
+
+	bool bMembersWaiting = !m_memberQueue.empty() && GetDiscordInstance()->IsGatewayConnected();
+	if (!bRestWaiting && !bMembersWaiting)
+		return;
+
+	uint64_t dueAt = m_windowStart + 1000;
+	if (!bMembersWaiting)
+		dueAt = std::max(dueAt, m_restBlockedUntil);
+
+	ScheduleTimer(dueAt);
+}
+
+void ProfileFetchScheduler::OnTimer()
+{
+	m_timerDueAt = 0;
+	Pump();
+}
+
+void ProfileFetchScheduler::OnProfileLoaded(Snowflake user)
+{
+	const Pending* pPending = m_pending.Find(user);
+	if (pPending && pPending->m_demand == DEMAND_VISIBLE)
+		m_pending.Erase(user);
+
+	const InFlight* pInFlight = m_inFlight.Find(user);
+	if (pInFlight && !pInFlight->m_bRest)
+		m_inFlight.Erase(user);
+}
+
+void ProfileFetchScheduler::OnRequestDone(Snowflake user)
+{
+	const InFlight* pInFlight = m_inFlight.Find(user);
+	if (pInFlight && pInFlight->m_bRest)
+		m_inFlight.Erase(user);
+}
+
+void ProfileFetchScheduler::OnRateLimited(Snowflake user, uint64_t retryAfterMs)
+{
+	DbgPrintF("Profile requests are rate limited for %d ms", int(retryAfterMs));
+	m_restBlockedUntil = GetTimeMs() + retryAfterMs;
+
+	const InFlight* pInFlight = m_inFlight.Find(user);
+	if (!pInFlight || !pInFlight->m_bRest)
+		return;
+
+	Pending pending;
+	pending.m_guild = pInFlight->m_guild;
+	pending.m_demand = pInFlight->m_demand;
+	m_inFlight.Erase(user);
+
+	if (m_pending.Find(user))
+		return;
+
+	m_pending.Insert(user, pending);
+	GetQueue(pending).push_front(user);
+}
+
+void ProfileFetchScheduler::Clear()
+{
+	m_pending.Clear();
+	m_inFlight.Clear();
+
+	for (auto& queue : m_restQueues)
+		queue.clear();
+
+	m_memberQueue.clear();
+	m_restBlockedUntil = 0;
+
+	if (m_timerDueAt) {
+		m_timerDueAt = 0;
+		GetFrontend()->SetProfileFetchTimer(0);
+	}
+}
+
+std::deque<Snowflake>& ProfileFetchScheduler::GetQueue(const Pending& pending)
+{
+	return UseMemberRequest(pending) ? m_memberQueue : m_restQueues[pending.m_demand];
+}
+
+bool ProfileFetchScheduler::PopQueued(std::deque<Snowflake>& queue, Snowflake& user, Pending& pending)
+{
+	while (!queue.empty())
+	{
+		user = queue.front();
+		queue.pop_front();
+
+		// Skip users that were fetched or moved to another queue since.
+		const Pending* pPending = m_pending.Find(user);
+		if (!pPending || &GetQueue(*pPending) != &queue)
+			continue;
+
+		pending = *pPending;
+		m_pending.Erase(user);
+		return true;
+	}
+
+	return false;
+}
+
+void ProfileFetchScheduler::PumpRestRequests(uint64_t now)
+{
+	if (now < m_restBlockedUntil)
+		return;
+
+	for (int demand = DEMAND_COUNT - 1; demand >= 0; demand--)
+	{
+		// Popouts were opened by the user, so they're never held back.
+		bool bLimited = demand != DEMAND_POPOUT;
+
+		Snowflake user;
+		Pending pending;
+		while (!(bLimited && m_restRequestsSent >= C_MAX_PROFILE_REQUESTS_PER_SECOND) &&
+			PopQueued(m_restQueues[demand], user, pending))
+		{
+			SendRestRequest(user, pending, now);
+
+			if (bLimited)
+				m_restRequestsSent++;
+		}
+	}
+}
+
+void ProfileFetchScheduler::PumpMemberRequests(uint64_t now)
+{
+	if (!GetDiscordInstance()->IsGatewayConnected())
+		return;
+
+	while (m_memberRequestsSent < C_MAX_PROFILE_MEMBER_REQUESTS_PER_SECOND && !m_memberQueue.empty())
+	{
+		// Batch the users of the guild first in the queue.  Users of other
+		// guilds keep their places.
+		Snowflake guild = 0;
+		std::set<Snowflake> users;
+		std::deque<Snowflake> skipped;
+
+		Snowflake user;
+		Pending pending;
+		while (users.size() < C_MAX_MEMBER_REQUEST_USERS && PopQueued(m_memberQueue, user, pending))
+		{
+			if (users.empty())
+				guild = pending.m_guild;
+
+			if (pending.m_guild != guild) {
+				m_pending.Insert(user, pending);
+				skipped.push_back(user);
+				continue;
+			}
+
+			InFlight inFlight;
+			inFlight.m_sentAt = now;
+			inFlight.m_guild = guild;
+			inFlight.m_demand = pending.m_demand;
+			inFlight.m_bRest = false;
+			m_inFlight.Insert(user, inFlight);
+			users.insert(user);
+		}
+
+		m_memberQueue.insert(m_memberQueue.begin(), skipped.begin(), skipped.end());
+
+		if (users.empty())
+			break;
+
+		GetDiscordInstance()->RequestGuildMembers(guild, users, false);
+		m_memberRequestsSent++;
+	}
+}
+
+void ProfileFetchScheduler::ScheduleTimer(uint64_t dueAt)
+{
+	// An earlier timer will schedule the next one itself.
+	if (m_timerDueAt && m_timerDueAt <= dueAt)
+		return;
+
+	uint64_t now = GetTimeMs();
+	m_timerDueAt = dueAt;
+	GetFrontend()->SetProfileFetchTimer(dueAt > now ? int(dueAt - now) : 1);
+}
+
+void ProfileFetchScheduler::SendRestRequest(Snowflake user, const Pending& pending, uint64_t now)
+{
+	InFlight inFlight;
+	inFlight.m_sentAt = now;
+	inFlight.m_guild = pending.m_guild;
+	inFlight.m_demand = pending.m_demand;
+	inFlight.m_bRest = true;
+	m_inFlight.Insert(user, inFlight);
+
+	// Mutual guilds and friends are only shown in the popout.
+	bool bMutuals = pending.m_demand != DEMAND_VISIBLE;
+
+	std::string params = "";
+	params += "?with_mutual_guilds=" + std::string(bMutuals ? "true" : "false");
+	params += "&with_mutual_friends=" + std::string(bMutuals ? "true" : "false");
+	params += "&with_mutual_friends_count=" + std::string(bMutuals ? "true" : "false");
+	if (pending.m_guild) params += "&guild_id=" + std::to_string(pending.m_guild);
+
+	GetHTTPClient()->PerformRequest(
+		pending.m_demand != DEMAND_VISIBLE,
+		NetRequest::GET,
+		GetDiscordAPI() + "users/" + std::to_string(user) + "/profile",
+		DiscordRequest::PROFILE,
+		user,
+		params,
+		GetDiscordInstance()->GetToken(),
+		"0"
+	);
+}
+
+void ProfileFetchScheduler::ExpireInFlight(uint64_t now)
+{
+	std::vector<Snowflake> expired;
+	m_inFlight.ForEach([&](Snowflake user, const InFlight& inFlight) {
+		if (now - inFlight.m_sentAt >= C_PROFILE_FETCH_TIMEOUT_MS)
+			expired.push_back(user);
+	});
+
+	for (Snowflake user : expired)
+		m_inFlight.Erase(user);
+
+	if (!expired.empty()) {
+		DbgPrintF("Gave up on %d profile fetches", int(expired.size()));
+	}
+}
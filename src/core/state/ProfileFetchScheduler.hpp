@@ -0,0 +1,127 @@
+#pragma once
+
+#include <deque>
+#include <set>
+#include <vector>
+#include <cstdint>
+#include "../models/Snowflake.hpp"
+#include "../models/SnowflakeMap.hpp"
+#include "MemberRequestTracker.hpp"
+
+// Maximum amount of profile requests sent to the REST API per second.  Those
+// for open profile popouts aren't limited.
+#define C_MAX_PROFILE_REQUESTS_PER_SECOND (4)
+
+// Maximum amount of member requests (gateway op 8) sent per second to fetch
+// profiles.
+#define C_MAX_PROFILE_MEMBER_REQUESTS_PER_SECOND (2)
+
+// Time after which a fetch that wasn't answered is given up on, in
+// milliseconds.  The user may be fetched again afterwards.
+#define C_PROFILE_FETCH_TIMEOUT_MS (30000)
+
+// Time a member request waits for more users of the guild to be asked for,
+// in milliseconds, so that they go out together.
+#define C_PROFILE_MEMBER_BATCH_DELAY_MS (100)
+
+// How much a user's profile is needed.  Profiles that are needed more are
+// fetched first.
+enum eProfileDemand
+{
+	DEMAND_VISIBLE, // The user is shown somewhere, e.g. as a DM recipient.
+	DEMAND_HOVERED, // The mouse is over the user, their popout may be next.
+	DEMAND_POPOUT,  // The user's profile popout is open.
+	DEMAND_COUNT,
+};
+
+// Decides when, and how, profiles are fetched.
+//
+// Profiles for popouts are requested from the REST API right away.  The rest
+// are queued, and sent a few per second, most needed first.  Visible members
+// of a guild are fetched with member requests over the gateway, up to
+// C_MAX_MEMBER_REQUEST_USERS at a time; other profiles need a REST request
+// each.  When a profile request is rate limited, REST requests are held off
+// for as long as the server asks.  While fetches are held back, the frontend's
+// profile fetch timer makes sure they go out eventually.
+//
+// N.B. Only used from the main thread.
+class ProfileFetchScheduler
+{
+public:
+	// Queues a fetch of the user's profile.  Asking again with a higher demand
+	// moves the user up the queue.
+	void Request(Snowflake user, Snowflake guild, eProfileDemand demand);
+
+	// Sends as many queued fetches as the limits allow.  Called whenever the
+	// client handles a gateway message or a response.
+	void Pump();
+
+	// The frontend's profile fetch timer went off.
+	void OnTimer();
+
+	// The user's profile was loaded, from anywhere.  Fetches that only needed
+	// the basic profile are dropped.
+	void OnProfileLoaded(Snowflake user);
+
+	// A REST profile request finished, successfully or not.
+	void OnRequestDone(Snowflake user);
+
+	// A REST profile request was rate limited.  The user is queued again.
+	void OnRateLimited(Snowflake user, uint64_t retryAfterMs);
+
+	void Clear();
+
+private:
+	struct Pending
+	{
+		Snowflake m_guild = 0;
+		eProfileDemand m_demand = DEMAND_VISIBLE;
+	};
+
+	struct InFlight
+	{
+		uint64_t m_sentAt = 0;
+		Snowflake m_guild = 0;
+		eProfileDemand m_demand = DEMAND_VISIBLE;
+		bool m_bRest = false;
+	};
+
+	static bool UseMemberRequest(const Pending& pending) {
+		return pending.m_demand == DEMAND_VISIBLE && pending.m_guild != 0;
+	}
+
+	// Gets the queue a pending fetch belongs in.
+	std::deque<Snowflake>& GetQueue(const Pending& pending);
+
+	// Takes the next user that is still waiting in the queue, and stops
+	// tracking them as pending.
+	bool PopQueued(std::deque<Snowflake>& queue, Snowflake& user, Pending& pending);
+
+	void PumpRestRequests(uint64_t now);
+	void PumpMemberRequests(uint64_t now);
+
+	// Makes sure Pump is called again by this time.
+	void ScheduleTimer(uint64_t dueAt);
+	void SendRestRequest(Snowflake user, const Pending& pending, uint64_t now);
+	void ExpireInFlight(uint64_t now);
+
+	SnowflakeMap<Pending> m_pending;
+	SnowflakeMap<InFlight> m_inFlight;
+
+	// Users waiting for a REST request, by demand, and users waiting for a
+	// member request.  Users whose demand changed are left behind in the old
+	// queue, and skipped.
+	std::deque<Snowflake> m_restQueues[DEMAND_COUNT];
+	std::deque<Snowflake> m_memberQueue;
+
+	// Requests sent in the current one second window.
+	uint64_t m_windowStart = 0;
+	int m_restRequestsSent = 0;
+	int m_memberRequestsSent = 0;
+
+	// No REST requests are sent before this time.
+	uint64_t m_restBlockedUntil = 0;
+
+	// When the profile fetch timer goes off, or 0 if it isn't set.
+	uint64_t m_timerDueAt = 0;
+};
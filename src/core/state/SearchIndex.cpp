@@ -0,0 +1,644 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include "SearchIndex.hpp"
+#include "MessageStore.hpp"
+#include "../utils/Util.hpp"
+
+using nlohmann::json;
+
+// January 1, 2015 in UNIX epoch, in milliseconds.
+#define C_DISCORD_EPOCH (1420070400000LL)
+
+SearchIndex* GetSearchIndex()
+{
+	static SearchIndex instance;
+	return &instance;
+}
+
+// Decodes the UTF-8 character at text[i] and moves past it.  Malformed
+// sequences are skipped one byte at a time, and decode to U+FFFD.
+static uint32_t DecodeUtf8(const std::string& text, size_t& i)
+{
+	uint8_t c = uint8_t(text[i++]);
+	if (c < 0x80)
+		return c;
+
+	int extra;
+	uint32_t cp, minimum;
+	if ((c & 0xE0) == 0xC0) {
+		extra = 1;
+		cp = c & 0x1F;
+		minimum = 0x80;
+	}
+	else if ((c & 0xF0) == 0xE0) {
+		extra = 2;
+		cp = c & 0x0F;
+		minimum = 0x800;
+	}
+	else if ((c & 0xF8) == 0xF0) {
+		extra = 3;
+		cp = c & 0x07;
+		minimum = 0x10000;
+	}
+	else {
+		return 0xFFFD;
+	}
+
+	size_t j = i;
+	for (int k = 0; k < extra; k++, j++)
+	{
+		if (j >= text.size() || (uint8_t(text[j]) & 0xC0) != 0x80)
+			return 0xFFFD;
+
+		cp = (cp << 6) | (uint8_t(text[j]) & 0x3F);
+	}
+
+	if (cp < minimum || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+		return 0xFFFD;
+
+	i = j;
+	return cp;
+}
+
+static void EncodeUtf8(std::string& out, uint32_t cp)
+{
+	if (cp < 0x80) {
+		out += char(cp);
+	}
+	else if (cp < 0x800) {
+		out += char(0xC0 | (cp >> 6));
+		out += char(0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000) {
+		out += char(0xE0 | (cp >> 12));
+		out += char(0x80 | ((cp >> 6) & 0x3F));
+		out += char(0x80 | (cp & 0x3F));
+	}
+	else {
+		out += char(0xF0 | (cp >> 18));
+		out += char(0x80 | ((cp >> 12) & 0x3F));
+		out += char(0x80 | ((cp >> 6) & 0x3F));
+		out += char(0x80 | (cp & 0x3F));
+	}
+}
+
+static bool IsTokenChar(uint32_t cp)
+{
+	if (cp < 0x80)
+		return (cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z');
+
+	// Other characters count as letters, except for the blocks of
+	// punctuation, symbols, emoji and formatting characters.
+	return !(
+		(cp <= 0xBF && cp != 0xAA && cp != 0xB5 && cp != 0xBA) || // Latin-1 punctuation, NBSP
+		cp == 0xD7 || cp == 0xF7 ||           // multiplication and division signs
+		(cp >= 0x2000 && cp <= 0x2BFF) ||     // general punctuation, arrows, math, shapes, dingbats
+		(cp >= 0x2E00 && cp <= 0x2E7F) ||     // supplemental punctuation
+		(cp >= 0x3000 && cp <= 0x303F) ||     // CJK symbols and punctuation
+		(cp >= 0xFE00 && cp <= 0xFE0F) ||     // variation selectors
+		(cp >= 0xFE10 && cp <= 0xFE6F) ||     // vertical, CJK compatibility and small forms
+		(cp >= 0xFF00 && cp <= 0xFF0F) ||     // fullwidth punctuation
+		(cp >= 0xFF1A && cp <= 0xFF20) ||
+		(cp >= 0xFF3B && cp <= 0xFF40) ||
+		(cp >= 0xFF5B && cp <= 0xFF65) ||
+		(cp >= 0xFFF0 && cp <= 0xFFFF) ||     // specials, including U+FFFD
+		(cp >= 0x1F000 && cp <= 0x1FAFF) ||   // emoji and pictographs
+		(cp >= 0xE0000 && cp <= 0xE007F)      // tags
+	);
+}
+
+static uint32_t FoldCase(uint32_t cp)
+{
+	if ((cp >= 'A' && cp <= 'Z') ||
+		(cp >= 0xC0 && cp <= 0xDE) ||     // Latin-1
+		(cp >= 0x391 && cp <= 0x3AB) ||   // Greek
+		(cp >= 0x410 && cp <= 0x42F))     // Cyrillic
+		return cp + 0x20;
+
+	if (cp >= 0x400 && cp <= 0x40F)
+		return cp + 0x50;
+
+	return cp;
+}
+
+void SearchIndex::Tokenize(const std::string& text, std::vector<std::string>& tokens)
+{
+	std::string token;
+	size_t i = 0;
+
+	while (true)
+	{
+		uint32_t cp = i < text.size() ? DecodeUtf8(text, i) : 0;
+
+		if (cp && IsTokenChar(cp))
+		{
+			// Leave out what doesn't fit, without splitting a character.
+			size_t size = token.size();
+			EncodeUtf8(token, FoldCase(cp));
+			if (token.size() > C_MAX_TOKEN_LENGTH)
+				token.resize(size);
+
+			continue;
+		}
+
+		if (!token.empty()) {
+			tokens.push_back(token);
+			token.clear();
+		}
+
+		if (i >= text.size())
+			break;
+	}
+}
+
+static void AppendText(std::string& text, const std::string& part)
+{
+	if (part.empty())
+		return;
+
+	text += ' ';
+	text += part;
+}
+
+static void GetExtrasText(json& data, std::string& text)
+{
+	if (data.contains("attachments") && data["attachments"].is_array())
+	{
+		for (auto& att : data["attachments"])
+			AppendText(text, GetFieldSafe(att, "filename"));
+	}
+
+	if (data.contains("embeds") && data["embeds"].is_array())
+	{
+		for (auto& emb : data["embeds"])
+		{
+			AppendText(text, GetFieldSafe(emb, "title"));
+			AppendText(text, GetFieldSafe(emb, "description"));
+		}
+	}
+}
+
+static void GetMessageText(const Message& msg, std::string& text)
+{
+	text = msg.m_message;
+
+	if (!msg.m_pExtras)
+		return;
+
+	// Don't decode the attachments and embeds just to index them.
+	if (!msg.m_pExtras->IsDecoded())
+	{
+		json data = msg.m_pExtras->Decode();
+		GetExtrasText(data, text);
+		return;
+	}
+
+	for (auto& att : msg.GetAttachments())
+		AppendText(text, att.m_fileName);
+
+	for (auto& emb : msg.GetEmbeds())
+	{
+		AppendText(text, emb.m_title);
+		AppendText(text, emb.m_description);
+	}
+}
+
+static void GetMessageText(json& data, std::string& text)
+{
+	text = GetFieldSafe(data, "content");
+	GetExtrasText(data, text);
+}
+
+static void WriteVarInt(std::vector<uint8_t>& data, uint64_t value)
+{
+	while (value >= 0x80) {
+		data.push_back(uint8_t(value | 0x80));
+		value >>= 7;
+	}
+
+	data.push_back(uint8_t(value));
+}
+
+static uint64_t ReadVarInt(const uint8_t*& pData)
+{
+	uint64_t value = 0;
+	int shift = 0;
+
+	while (*pData & 0x80) {
+		value |= uint64_t(*pData++ & 0x7F) << shift;
+		shift += 7;
+	}
+
+	value |= uint64_t(*pData++) << shift;
+	return value;
+}
+
+static Snowflake TimeToSnowflake(time_t t)
+{
+	int64_t ms = int64_t(t) * 1000 - C_DISCORD_EPOCH;
+	if (ms < 0)
+		return 0;
+
+	return Snowflake(ms) << 22;
+}
+
+void SearchIndex::AddMessage(Snowflake channel, Snowflake guild, const Message& msg)
+{
+	if (!msg.m_snowflake ||
+		msg.IsLoadGap() ||
+		msg.m_type == MessageType::CHANNEL_HEADER ||
+		msg.m_type == MessageType::SENDING_MESSAGE)
+		return;
+
+	Document doc;
+	doc.m_channel = channel;
+	doc.m_guild = guild;
+	doc.m_author = msg.m_author_snowflake;
+
+	std::string text;
+	GetMessageText(msg, text);
+	AddDocument(msg.m_snowflake, doc, text);
+
+	TouchChannel(channel);
+	EnforceLimit(channel);
+}
+
+void SearchIndex::AddStoredChannel(Snowflake channel, Snowflake guild)
+{
+	IndexedChannel& chan = TouchChannel(channel);
+	if (chan.m_bStoreAdded)
+		return;
+
+	chan.m_bStoreAdded = true;
+
+	std::vector<std::pair<Snowflake, std::string>> stored;
+	if (!GetMessageStore()->GetAllMessageData(channel, stored))
+		return;
+
+	std::string text;
+	for (auto& msg : stored)
+	{
+		// What's in the message cache is at least as recent.
+		if (m_documents.count(msg.first))
+			continue;
+
+		json data = json::parse(msg.second, nullptr, false);
+		if (data.is_discarded() || !data.is_object())
+			continue;
+
+		Document doc;
+		doc.m_channel = channel;
+		doc.m_guild = guild;
+		if (data.contains("author") && data["author"].is_object())
+			doc.m_author = GetSnowflake(data["author"], "id");
+
+		GetMessageText(data, text);
+		AddDocument(msg.first, doc, text);
+	}
+
+	EnforceLimit(channel);
+}
+
+void SearchIndex::RemoveChannel(Snowflake channel)
+{
+	auto chanIter = m_channels.find(channel);
+	if (chanIter == m_channels.end())
+		return;
+
+	m_channels.erase(chanIter);
+
+	// Count the stale postings first, so that each list is rebuilt once at
+	// most.
+	std::unordered_map<uint32_t, uint32_t> staleTerms;
+	for (auto iter = m_documents.begin(); iter != m_documents.end(); )
+	{
+		if (iter->second.m_channel != channel) {
+			++iter;
+			continue;
+		}
+
+		for (uint32_t term : iter->second.m_terms)
+			staleTerms[term]++;
+
+		iter = m_documents.erase(iter);
+	}
+
+	for (auto& term : staleTerms)
+		MarkStale(term.first, term.second);
+}
+
+void SearchIndex::Clear()
+{
+	m_documents.clear();
+	m_termIds.clear();
+	m_postings.clear();
+	m_freeTermIds.clear();
+	m_channels.clear();
+}
+
+SearchIndex::IndexedChannel& SearchIndex::TouchChannel(Snowflake channel)
+{
+	IndexedChannel& chan = m_channels[channel];
+	chan.m_lastUsed = ++m_useCounter;
+	return chan;
+}
+
+void SearchIndex::EnforceLimit(Snowflake keepChannel)
+{
+	while (m_documents.size() > C_MAX_INDEXED_MESSAGES)
+	{
+		Snowflake oldest = 0;
+		uint64_t oldestUse = UINT64_MAX;
+		for (auto& chan : m_channels)
+		{
+			if (chan.first != keepChannel && chan.second.m_documents && chan.second.m_lastUsed < oldestUse) {
+				oldest = chan.first;
+				oldestUse = chan.second.m_lastUsed;
+			}
+		}
+
+		if (!oldest)
+			break;
+
+		RemoveChannel(oldest);
+	}
+}
+
+void SearchIndex::AddDocument(Snowflake message, Document& doc, const std::string& text)
+{
+	std::vector<std::string> tokens;
+	Tokenize(text, tokens);
+
+	for (auto& token : tokens)
+		doc.m_terms.push_back(GetTermId(token, true));
+
+	std::sort(doc.m_terms.begin(), doc.m_terms.end());
+	doc.m_terms.erase(std::unique(doc.m_terms.begin(), doc.m_terms.end()), doc.m_terms.end());
+
+	std::vector<uint32_t> oldTerms;
+	auto iter = m_documents.find(message);
+	if (iter != m_documents.end())
+		oldTerms = std::move(iter->second.m_terms);
+	else
+		m_channels[doc.m_channel].m_documents++;
+
+	// N.B. The document is updated first, so that rebuilt posting lists
+	// leave out the terms it no longer has.
+	Document& newDoc = m_documents[message];
+	newDoc = std::move(doc);
+
+	std::vector<uint32_t> removed, added;
+	std::set_difference(oldTerms.begin(), oldTerms.end(), newDoc.m_terms.begin(), newDoc.m_terms.end(), std::back_inserter(removed));
+	std::set_difference(newDoc.m_terms.begin(), newDoc.m_terms.end(), oldTerms.begin(), oldTerms.end(), std::back_inserter(added));
+
+	for (uint32_t term : removed)
+		MarkStale(term);
+
+	for (uint32_t term : added)
+		AddPosting(term, message);
+}
+
+void SearchIndex::RemoveMessage(Snowflake message)
+{
+	auto iter = m_documents.find(message);
+	if (iter == m_documents.end())
+		return;
+
+	std::vector<uint32_t> terms = std::move(iter->second.m_terms);
+
+	auto chanIter = m_channels.find(iter->second.m_channel);
+	if (chanIter != m_channels.end() && chanIter->second.m_documents)
+		chanIter->second.m_documents--;
+
+	m_documents.erase(iter);
+
+	for (uint32_t term : terms)
+		MarkStale(term);
+}
+
+uint32_t SearchIndex::GetTermId(const std::string& term, bool bCreate)
+{
+	auto iter = m_termIds.find(term);
+	if (iter != m_termIds.end())
+		return iter->second;
+
+	if (!bCreate)
+		return UINT32_MAX;
+
+	uint32_t id;
+	if (!m_freeTermIds.empty()) {
+		id = m_freeTermIds.back();
+		m_freeTermIds.pop_back();
+	}
+	else {
+		id = uint32_t(m_postings.size());
+		m_postings.push_back(PostingList());
+	}
+
+	m_termIds[term] = id;
+	m_postings[id].m_term = term;
+	return id;
+}
+
+bool SearchIndex::DocumentHasTerm(Snowflake message, uint32_t term) const
+{
+	auto iter = m_documents.find(message);
+	if (iter == m_documents.end())
+		return false;
+
+	auto& terms = iter->second.m_terms;
+	return std::binary_search(terms.begin(), terms.end(), term);
+}
+
+void SearchIndex::AddPosting(uint32_t term, Snowflake message)
+{
+	PostingList& list = m_postings[term];
+	list.m_count++;
+
+	if (list.m_data.empty() || message > list.m_last)
+	{
+		WriteVarInt(list.m_data, message - list.m_last);
+		list.m_last = message;
+		return;
+	}
+
+	list.m_pending.push_back(message);
+
+	if (list.m_pending.size() > C_MAX_PENDING_POSTINGS)
+		RebuildPostings(term);
+}
+
+void SearchIndex::MarkStale(uint32_t term, uint32_t count)
+{
+	PostingList& list = m_postings[term];
+	list.m_stale += count;
+
+	// N.B. Also when no posting is left, so that the term is forgotten.
+	if (list.m_stale >= list.m_count || list.m_stale > list.m_count / 2 + 16)
+		RebuildPostings(term);
+}
+
+void SearchIndex::GetPostings(const PostingList& list, std::vector<Snowflake>& out) const
+{
+	out.reserve(out.size() + list.m_count);
+
+	const uint8_t* pData = list.m_data.data();
+	const uint8_t* pEnd = pData + list.m_data.size();
+	Snowflake sf = 0;
+
+	while (pData < pEnd) {
+		sf += ReadVarInt(pData);
+		out.push_back(sf);
+	}
+
+	out.insert(out.end(), list.m_pending.begin(), list.m_pending.end());
+}
+
+void SearchIndex::RebuildPostings(uint32_t term)
+{
+	PostingList& list = m_postings[term];
+
+	std::vector<Snowflake> postings;
+	GetPostings(list, postings);
+	std::sort(postings.begin(), postings.end());
+	postings.erase(std::unique(postings.begin(), postings.end()), postings.end());
+
+	list.m_data.clear();
+	list.m_pending.clear();
+	list.m_last = 0;
+	list.m_count = 0;
+	list.m_stale = 0;
+
+	for (Snowflake sf : postings)
+	{
+		if (!DocumentHasTerm(sf, term))
+			continue;
+
+		WriteVarInt(list.m_data, sf - list.m_last);
+		list.m_last = sf;
+		list.m_count++;
+	}
+
+	if (list.m_count == 0)
+	{
+		// No message has the term anymore.
+		m_termIds.erase(list.m_term);
+		m_freeTermIds.push_back(term);
+		list = PostingList();
+		return;
+	}
+
+	list.m_data.shrink_to_fit();
+}
+
+size_t SearchIndex::Search(const SearchQuery& query, std::vector<SearchResult>& results)
+{
+	Snowflake minSf = query.m_after ? TimeToSnowflake(query.m_after) : 0;
+	Snowflake maxSf = query.m_before ? TimeToSnowflake(query.m_before) : Snowflake(-1LL);
+
+	auto matchesFilters = [&](Snowflake message, const Document& doc) {
+		return
+			message >= minSf && message < maxSf &&
+			(!query.m_guild || doc.m_guild == query.m_guild) &&
+			(!query.m_channel || doc.m_channel == query.m_channel) &&
+			(!query.m_author || doc.m_author == query.m_author);
+	};
+
+	std::vector<std::string> tokens;
+	Tokenize(query.m_text, tokens);
+	std::sort(tokens.begin(), tokens.end());
+	tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+
+	std::vector<SearchResult> matches;
+
+	if (tokens.empty())
+	{
+		// Filters only.
+		for (auto& doc : m_documents)
+		{
+			if (!matchesFilters(doc.first, doc.second))
+				continue;
+
+			SearchResult res;
+			res.m_message = doc.first;
+			res.m_channel = doc.second.m_channel;
+			res.m_guild = doc.second.m_guild;
+			res.m_author = doc.second.m_author;
+			matches.push_back(res);
+		}
+	}
+	else
+	{
+		std::unordered_map<Snowflake, float> scores;
+		std::vector<Snowflake> postings;
+		float documentCount = float(m_documents.size());
+
+		for (auto& token : tokens)
+		{
+			uint32_t term = GetTermId(token, false);
+			if (term == UINT32_MAX)
+				continue;
+
+			PostingList& list = m_postings[term];
+			uint32_t live = list.m_count > list.m_stale ? list.m_count - list.m_stale : 1;
+
+			// Rarer terms weigh more.
+			float weight = std::log(1.0f + documentCount / float(live));
+
+			postings.clear();
+			GetPostings(list, postings);
+			if (!list.m_pending.empty()) {
+				std::sort(postings.begin(), postings.end());
+				postings.erase(std::unique(postings.begin(), postings.end()), postings.end());
+			}
+
+			auto begin = std::lower_bound(postings.begin(), postings.end(), minSf);
+			for (auto iter = begin; iter != postings.end() && *iter < maxSf; ++iter)
+			{
+				auto docIter = m_documents.find(*iter);
+				if (docIter == m_documents.end())
+					continue;
+
+				auto& terms = docIter->second.m_terms;
+				if (!std::binary_search(terms.begin(), terms.end(), term))
+					continue;
+
+				if (!matchesFilters(*iter, docIter->second))
+					continue;
+
+				scores[*iter] += weight;
+			}
+		}
+
+		matches.reserve(scores.size());
+		for (auto& score : scores)
+		{
+			const Document& doc = m_documents[score.first];
+
+			SearchResult res;
+			res.m_message = score.first;
+			res.m_channel = doc.m_channel;
+			res.m_guild = doc.m_guild;
+			res.m_author = doc.m_author;
+			res.m_score = score.second;
+			matches.push_back(res);
+		}
+	}
+
+	size_t total = matches.size();
+	size_t end = std::min(total, query.m_offset + query.m_limit);
+	if (query.m_offset >= end)
+		return total;
+
+	auto compare = [](const SearchResult& a, const SearchResult& b) {
+		if (a.m_score != b.m_score)
+			return a.m_score > b.m_score;
+		return a.m_message > b.m_message;
+	};
+
+	// Only the requested page has to be in order.
+	std::partial_sort(matches.begin(), matches.begin() + end, matches.end(), compare);
+	results.insert(results.end(), matches.begin() + query.m_offset, matches.begin() + end);
+	return total;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <nlohmann/json.h>
+#include "../models/Snowflake.hpp"
+#include "../models/Message.hpp"
+
+// Maximum amount of postings added out of order to a term before its list is
+// rebuilt.
+#define C_MAX_PENDING_POSTINGS (64)
+
+// Longest token that is indexed, in bytes.
+#define C_MAX_TOKEN_LENGTH (64)
+
+// Maximum amount of messages indexed.  Past that, the channels that were
+// added to the longest ago are dropped from the index.
+#define C_MAX_INDEXED_MESSAGES (100000)
+
+struct SearchQuery
+{
+	std::string m_text;
+	Snowflake m_guild = 0;   // 0 for any guild.  To search DMs, filter by channel
+	Snowflake m_channel = 0; // 0 for any channel
+	Snowflake m_author = 0;  // 0 for any author
+	time_t m_after = 0;      // 0 for no lower bound
+	time_t m_before = 0;     // 0 for no upper bound
+	size_t m_offset = 0;
+	size_t m_limit = 25;
+};
+
+struct SearchResult
+{
+	Snowflake m_message = 0;
+	Snowflake m_channel = 0;
+	Snowflake m_guild = 0;
+	Snowflake m_author = 0;
+	float m_score = 0.0f;
+};
+
+// Local full text index over the messages in the message cache and store.
+//
+// Text is split into tokens on anything that isn't a letter or digit, i.e.
+// spaces, punctuation, symbols and emoji, and Latin, Greek and Cyrillic
+// letters are folded to lower case.  Each token has a posting list: the
+// snowflakes of the messages containing it, ascending, stored as variable
+// length deltas.  Postings are never removed in place.  Instead, each message
+// remembers its tokens, and a posting only counts if its message still has
+// that token.  Lists with too many stale postings are rebuilt.  Tokens that
+// no message has anymore are forgotten, and their ids reused.
+class SearchIndex
+{
+public:
+	void AddMessage(Snowflake channel, Snowflake guild, const Message& msg);
+	void RemoveMessage(Snowflake message);
+
+	// Adds the messages persisted in a channel's message store.  Only done
+	// once per channel, until the channel is removed.
+	void AddStoredChannel(Snowflake channel, Snowflake guild);
+
+	// Drops a channel's messages, e.g. when the message cache evicts it.
+	void RemoveChannel(Snowflake channel);
+
+	void Clear();
+
+	// Finds the messages matching the query, best first.  Messages matching
+	// more, and rarer, tokens rank higher; ties go to the newest message.
+	// Returns the amount of matches in total, before pagination.
+	size_t Search(const SearchQuery& query, std::vector<SearchResult>& results);
+
+	static void Tokenize(const std::string& text, std::vector<std::string>& tokens);
+
+private:
+	struct Document
+	{
+		Snowflake m_channel = 0;
+		Snowflake m_guild = 0;
+		Snowflake m_author = 0;
+		std::vector<uint32_t> m_terms; // sorted
+	};
+
+	struct IndexedChannel
+	{
+		size_t m_documents = 0;
+		uint64_t m_lastUsed = 0;
+		bool m_bStoreAdded = false;
+	};
+
+	struct PostingList
+	{
+		std::vector<uint8_t> m_data; // ascending snowflakes, as varint deltas
+		Snowflake m_last = 0;
+		std::vector<Snowflake> m_pending; // added out of order
+		uint32_t m_count = 0;
+		uint32_t m_stale = 0;
+		std::string m_term;
+	};
+
+	void AddDocument(Snowflake message, Document& doc, const std::string& text);
+	IndexedChannel& TouchChannel(Snowflake channel);
+
+	// Drops the least recently used channels until the index fits.
+	void EnforceLimit(Snowflake keepChannel);
+	uint32_t GetTermId(const std::string& term, bool bCreate);
+	bool DocumentHasTerm(Snowflake message, uint32_t term) const;
+
+	void AddPosting(uint32_t term, Snowflake message);
+	void MarkStale(uint32_t term, uint32_t count = 1);
+	void GetPostings(const PostingList& list, std::vector<Snowflake>& out) const;
+	void RebuildPostings(uint32_t term);
+
+	std::unordered_map<Snowflake, Document> m_documents;
+	std::unordered_map<std::string, uint32_t> m_termIds;
+	std::vector<PostingList> m_postings;
+	std::vector<uint32_t> m_freeTermIds;
+	std::unordered_map<Snowflake, IndexedChannel> m_channels;
+	uint64_t m_useCounter = 0;
+};
+
+SearchIndex* GetSearchIndex();
@@ -0,0 +1,148 @@
+#include <cassert>
+#include "FixedPool.hpp"
+
+// Blocks are aligned to this many bytes.
+#define C_POOL_ALIGNMENT (8)
+
+static size_t AlignUp(size_t size)
+{
+	return (size + C_POOL_ALIGNMENT - 1) & ~size_t(C_POOL_ALIGNMENT - 1);
+}
+
+struct FixedPool::Slab
+{
+	Slab* m_pPrev = nullptr;
+	Slab* m_pNext = nullptr;
+	bool m_bLinked = false;
+
+	// Freed blocks, linked through their first bytes.
+	void* m_pFreeList = nullptr;
+
+	// Blocks that were never handed out start at this index.
+	uint32_t m_carved = 0;
+	uint32_t m_used = 0;
+};
+
+// Each block begins with a pointer to its slab, padded to the alignment.
+#define C_BLOCK_HEADER_SIZE AlignUp(sizeof(void*))
+#define C_SLAB_HEADER_SIZE AlignUp(sizeof(Slab))
+
+FixedPool::FixedPool(size_t blockSize)
+{
+	if (blockSize < sizeof(void*))
+		blockSize = sizeof(void*);
+
+	m_blockSize = C_BLOCK_HEADER_SIZE + AlignUp(blockSize);
+	m_slabSize = C_SLAB_HEADER_SIZE + m_blockSize * C_POOL_SLAB_BLOCKS;
+}
+
+FixedPool::~FixedPool()
+{
+	// N.B. Slabs with blocks still in use are leaked.
+	if (m_pSpare)
+		::operator delete(m_pSpare);
+}
+
+FixedPool::Slab* FixedPool::AllocateSlab()
+{
+	if (m_pSpare) {
+		Slab* pSlab = m_pSpare;
+		m_pSpare = nullptr;
+		return pSlab;
+	}
+
+	Slab* pSlab = new (::operator new(m_slabSize)) Slab;
+	m_slabCount++;
+	return pSlab;
+}
+
+void FixedPool::LinkSlab(Slab* pSlab)
+{
+	assert(!pSlab->m_bLinked);
+	pSlab->m_bLinked = true;
+	pSlab->m_pPrev = nullptr;
+	pSlab->m_pNext = m_pFirstFree;
+
+	if (m_pFirstFree)
+		m_pFirstFree->m_pPrev = pSlab;
+
+	m_pFirstFree = pSlab;
+}
+
+void FixedPool::UnlinkSlab(Slab* pSlab)
+{
+	assert(pSlab->m_bLinked);
+	pSlab->m_bLinked = false;
+
+	if (pSlab->m_pPrev)
+		pSlab->m_pPrev->m_pNext = pSlab->m_pNext;
+	else
+		m_pFirstFree = pSlab->m_pNext;
+
+	if (pSlab->m_pNext)
+		pSlab->m_pNext->m_pPrev = pSlab->m_pPrev;
+
+	pSlab->m_pPrev = pSlab->m_pNext = nullptr;
+}
+
+void* FixedPool::Allocate()
+{
+	if (!m_pFirstFree)
+		LinkSlab(AllocateSlab());
+
+	Slab* pSlab = m_pFirstFree;
+	uint8_t* pBlock;
+
+	if (pSlab->m_pFreeList) {
+		pBlock = static_cast<uint8_t*>(pSlab->m_pFreeList) - C_BLOCK_HEADER_SIZE;
+		pSlab->m_pFreeList = *static_cast<void**>(pSlab->m_pFreeList);
+	}
+	else {
+		pBlock = reinterpret_cast<uint8_t*>(pSlab) + C_SLAB_HEADER_SIZE + pSlab->m_carved * m_blockSize;
+		pSlab->m_carved++;
+	}
+
+	pSlab->m_used++;
+	if (pSlab->m_used == C_POOL_SLAB_BLOCKS)
+		UnlinkSlab(pSlab);
+
+	*reinterpret_cast<Slab**>(pBlock) = pSlab;
+	return pBlock + C_BLOCK_HEADER_SIZE;
+}
+
+void FixedPool::Free(void* p)
+{
+	if (!p)
+		return;
+
+	uint8_t* pBlock = static_cast<uint8_t*>(p) - C_BLOCK_HEADER_SIZE;
+	Slab* pSlab = *reinterpret_cast<Slab**>(pBlock);
+
+	assert(pSlab->m_used > 0);
+	pSlab->m_used--;
+
+	if (pSlab->m_used == 0)
+	{
+		// The whole slab is free.
+		if (pSlab->m_bLinked)
+			UnlinkSlab(pSlab);
+
+		if (m_pSpare) {
+			pSlab->~Slab();
+			::operator delete(pSlab);
+			m_slabCount--;
+		}
+		else {
+			pSlab->~Slab();
+			m_pSpare = new (pSlab) Slab;
+		}
+
+		return;
+	}
+
+	*static_cast<void**>(p) = pSlab->m_pFreeList;
+	pSlab->m_pFreeList = p;
+
+	if (!pSlab->m_bLinked)
+		LinkSlab(pSlab);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Amount of blocks in each slab of a FixedPool.
+#define C_POOL_SLAB_BLOCKS (64)
+
+// Hands out blocks of one size, carved out of slabs of C_POOL_SLAB_BLOCKS
+// blocks each.  Blocks allocated one after another end up next to each other,
+// and a slab is given back as soon as all of its blocks are freed, so objects
+// created together, like a page of messages, also go away together.
+//
+// N.B. Only used from the main thread.
+class FixedPool
+{
+public:
+	FixedPool(size_t blockSize);
+	~FixedPool();
+
+	void* Allocate();
+	void Free(void* p);
+
+	size_t GetSlabCount() const {
+		return m_slabCount;
+	}
+	size_t GetMemoryUsage() const {
+		return m_slabCount * m_slabSize;
+	}
+
+private:
+	struct Slab;
+
+	Slab* AllocateSlab();
+	void LinkSlab(Slab* pSlab);
+	void UnlinkSlab(Slab* pSlab);
+
+	// The size of a block, including the pointer to its slab in front of it.
+	size_t m_blockSize;
+	size_t m_slabSize;
+	size_t m_slabCount = 0;
+
+	// Slabs with free blocks.  Blocks are taken from the first one.
+	Slab* m_pFirstFree = nullptr;
+
+	// An empty slab kept around, so that a block being allocated and freed
+	// over and over doesn't allocate a slab every time.
+	Slab* m_pSpare = nullptr;
+};
+
+// Allocator for std::allocate_shared, which places objects in a FixedPool.  One
+// pool exists per allocated type.
+template <typename T>
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+
+	PoolAllocator() {}
+
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		if (n != 1)
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+
+		return static_cast<T*>(GetPool().Allocate());
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		if (n != 1)
+			::operator delete(p);
+		else
+			GetPool().Free(p);
+	}
+
+	static FixedPool& GetPool()
+	{
+		// N.B. Never destroyed, as pooled objects may be held by other objects
+		// with static storage duration.
+		static FixedPool* pPool = new FixedPool(sizeof(T));
+		return *pPool;
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+	return false;
+}
@@ -0,0 +1,93 @@
+#include <unordered_map>
+#include "InternedString.hpp"
+
+typedef std::unordered_map<std::string, size_t> InternPool;
+
+static InternPool& GetPool()
+{
+	// N.B. Never destroyed, as interned strings may be held by other objects
+	// with static storage duration.
+	static InternPool* pPool = new InternPool;
+	return *pPool;
+}
+
+static const std::string g_emptyString;
+
+InternedString::InternedString(const std::string& str)
+{
+	if (str.empty())
+		return;
+
+	auto& entry = *GetPool().emplace(str, 0).first;
+	entry.second++;
+	m_pEntry = &entry;
+}
+
+InternedString::InternedString(const char* str) :
+	InternedString(std::string(str ? str : ""))
+{
+}
+
+InternedString::InternedString(const InternedString& oth) :
+	m_pEntry(oth.m_pEntry)
+{
+	if (m_pEntry)
+		m_pEntry->second++;
+}
+
+InternedString::InternedString(InternedString&& oth) noexcept :
+	m_pEntry(oth.m_pEntry)
+{
+	oth.m_pEntry = nullptr;
+}
+
+InternedString::~InternedString()
+{
+	Release();
+}
+
+InternedString& InternedString::operator=(const InternedString& oth)
+{
+	Entry* pEntry = oth.m_pEntry;
+	if (pEntry)
+		pEntry->second++;
+
+	Release();
+	m_pEntry = pEntry;
+	return *this;
+}
+
+InternedString& InternedString::operator=(InternedString&& oth) noexcept
+{
+	if (this != &oth) {
+		Release();
+		m_pEntry = oth.m_pEntry;
+		oth.m_pEntry = nullptr;
+	}
+
+	return *this;
+}
+
+void InternedString::Release()
+{
+	if (!m_pEntry)
+		return;
+
+	if (--m_pEntry->second == 0)
+	{
+		InternPool& pool = GetPool();
+		pool.erase(pool.find(m_pEntry->first));
+	}
+
+	m_pEntry = nullptr;
+}
+
+const std::string& InternedString::str() const
+{
+	return m_pEntry ? m_pEntry->first : g_emptyString;
+}
+
+size_t InternedString::GetPoolSize()
+{
+	return GetPool().size();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <utility>
+
+// An immutable string kept in a global, reference counted pool.  Equal strings
+// share one copy, so copying one is a reference count bump and comparing two is
+// a pointer compare.  Meant for strings repeated across many objects, such as
+// author names and avatar hashes.
+//
+// N.B. Like the rest of the state in core, these may only be created, copied
+// and destroyed on the main thread.
+class InternedString
+{
+public:
+	InternedString() {}
+	InternedString(const std::string& str);
+	InternedString(const char* str);
+	InternedString(const InternedString& oth);
+	InternedString(InternedString&& oth) noexcept;
+	~InternedString();
+
+	InternedString& operator=(const InternedString& oth);
+	InternedString& operator=(InternedString&& oth) noexcept;
+
+	const std::string& str() const;
+	operator const std::string&() const {
+		return str();
+	}
+
+	const char* c_str() const {
+		return str().c_str();
+	}
+	size_t size() const {
+		return str().size();
+	}
+	bool empty() const {
+		return m_pEntry == nullptr;
+	}
+
+	bool operator==(const InternedString& oth) const {
+		return m_pEntry == oth.m_pEntry;
+	}
+	bool operator!=(const InternedString& oth) const {
+		return m_pEntry != oth.m_pEntry;
+	}
+
+	// Amount of distinct strings in the pool.
+	static size_t GetPoolSize();
+
+private:
+	typedef std::pair<const std::string, size_t> Entry;
+
+	void Release();
+
+	// Null for the empty string.
+	Entry* m_pEntry = nullptr;
+};
+
+inline std::string operator+(const InternedString& a, const std::string& b) {
+	return a.str() + b;
+}
+inline std::string operator+(const std::string& a, const InternedString& b) {
+	return a + b.str();
+}
+inline std::string operator+(const InternedString& a, const char* b) {
+	return a.str() + b;
+}
+inline std::string operator+(const char* a, const InternedString& b) {
+	return a + b.str();
+}
+inline bool operator==(const InternedString& a, const std::string& b) {
+	return a.str() == b;
+}
+inline bool operator!=(const InternedString& a, const std::string& b) {
+	return a.str() != b;
+}
@@ -0,0 +1,220 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#undef  WIN32_LEAN_AND_MEAN
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& fileName)
+{
+	Close();
+
+	HANDLE hFile = CreateFileA(
+		fileName.c_str(),
+		GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD sizeHigh = 0;
+	DWORD sizeLow = GetFileSize(hFile, &sizeHigh);
+	if (sizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+		CloseHandle(hFile);
+		return false;
+	}
+
+	m_hFile = hFile;
+	m_size = size_t((uint64_t(sizeHigh) << 32) | sizeLow);
+	m_bOpen = true;
+
+	if (!Map()) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!m_bOpen)
+		return;
+
+	Unmap();
+	CloseHandle((HANDLE) m_hFile);
+
+	m_hFile = nullptr;
+	m_size = 0;
+	m_bOpen = false;
+}
+
+bool MappedFile::Map()
+{
+	// Empty files can't be mapped.
+	if (m_size == 0)
+		return true;
+
+	uint64_t size = m_size;
+	HANDLE hMapping = CreateFileMapping((HANDLE) m_hFile, NULL, PAGE_READWRITE, DWORD(size >> 32), DWORD(size), NULL);
+	if (!hMapping)
+		return false;
+
+	void* pData = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, m_size);
+	if (!pData) {
+		CloseHandle(hMapping);
+		return false;
+	}
+
+	m_hMapping = hMapping;
+	m_pData = (uint8_t*) pData;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping)
+		CloseHandle((HANDLE) m_hMapping);
+
+	m_pData = nullptr;
+	m_hMapping = nullptr;
+}
+
+bool MappedFile::Resize(size_t size)
+{
+	if (!m_bOpen)
+		return false;
+
+	Unmap();
+
+	LONG sizeHigh = LONG(uint64_t(size) >> 32);
+	DWORD result = SetFilePointer((HANDLE) m_hFile, LONG(size), &sizeHigh, FILE_BEGIN);
+	if (result == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
+		Map();
+		return false;
+	}
+
+	if (!SetEndOfFile((HANDLE) m_hFile)) {
+		Map();
+		return false;
+	}
+
+	m_size = size;
+	return Map();
+}
+
+void MappedFile::Flush()
+{
+	if (m_pData)
+		FlushViewOfFile(m_pData, 0);
+}
+
+#else // _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& fileName)
+{
+	Close();
+
+	int fd = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+
+	m_fd = fd;
+	m_size = size_t(st.st_size);
+	m_bOpen = true;
+
+	if (!Map()) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!m_bOpen)
+		return;
+
+	Unmap();
+	close(m_fd);
+
+	m_fd = -1;
+	m_size = 0;
+	m_bOpen = false;
+}
+
+bool MappedFile::Map()
+{
+	// Empty files can't be mapped.
+	if (m_size == 0)
+		return true;
+
+	void* pData = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (pData == MAP_FAILED)
+		return false;
+
+	m_pData = (uint8_t*) pData;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if (m_pData)
+		munmap(m_pData, m_size);
+
+	m_pData = nullptr;
+}
+
+bool MappedFile::Resize(size_t size)
+{
+	if (!m_bOpen)
+		return false;
+
+	Unmap();
+
+	if (ftruncate(m_fd, off_t(size)) != 0) {
+		Map();
+		return false;
+	}
+
+	m_size = size;
+	return Map();
+}
+
+void MappedFile::Flush()
+{
+	if (m_pData)
+		msync(m_pData, m_size, MS_ASYNC);
+}
+
+#endif // _WIN32
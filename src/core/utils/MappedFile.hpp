@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// A file mapped into memory for reading and writing.  The mapping covers the
+// whole file.  Use Resize() to grow or shrink it; this remaps the file, so
+// pointers obtained from GetData() become invalid.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Opens the file, creating it if it doesn't exist.
+	bool Open(const std::string& fileName);
+	void Close();
+
+	bool Resize(size_t size);
+
+	// Writes the modified pages back to the disk.
+	void Flush();
+
+	bool IsOpen() const {
+		return m_bOpen;
+	}
+	uint8_t* GetData() {
+		return m_pData;
+	}
+	const uint8_t* GetData() const {
+		return m_pData;
+	}
+	size_t GetSize() const {
+		return m_size;
+	}
+
+private:
+	bool Map();
+	void Unmap();
+
+	uint8_t* m_pData = nullptr;
+	size_t m_size = 0;
+	bool m_bOpen = false;
+
+#ifdef _WIN32
+	void* m_hFile = nullptr;
+	void* m_hMapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
@@ -0,0 +1,135 @@
+#include <cstdio>
+#include "TimeFormatCache.hpp"
+#include "Util.hpp"
+#include "../Frontend.hpp"
+
+TimeFormatCache* GetTimeFormatCache()
+{
+	static TimeFormatCache instance;
+	return &instance;
+}
+
+void TimeFormatCache::Clear()
+{
+	m_minutes.clear();
+	m_days.clear();
+	m_bLoadedFormats = false;
+}
+
+void TimeFormatCache::LoadFormats()
+{
+	if (m_bLoadedFormats)
+		return;
+
+	Frontend* pFrontend = GetFrontend();
+	m_todayAtFormat = pFrontend->GetTodayAtText();
+	m_yesterdayAtFormat = pFrontend->GetYesterdayAtText();
+	m_longFormat = pFrontend->GetFormatTimeLongText();
+	m_shorterFormat = pFrontend->GetFormatTimeShorterText();
+	m_dateFormat = pFrontend->GetFormatDateOnlyText();
+	m_bLoadedFormats = true;
+}
+
+void TimeFormatCache::CheckDayRollover()
+{
+	time_t now = time(NULL);
+	if (now >= m_todayStart && now < m_tomorrowStart)
+		return;
+
+	struct tm today = *localtime(&now);
+	today.tm_hour = today.tm_min = today.tm_sec = 0;
+	today.tm_isdst = -1;
+
+	struct tm yesterday = today;
+	yesterday.tm_mday--;
+
+	struct tm tomorrow = today;
+	tomorrow.tm_mday++;
+
+	m_todayStart = mktime(&today);
+	m_yesterdayStart = mktime(&yesterday);
+	m_tomorrowStart = mktime(&tomorrow);
+
+	// The relative strings are stale now.
+	m_minutes.clear();
+}
+
+const InternedString& TimeFormatCache::GetDate(const struct tm& ptime)
+{
+	int key = (ptime.tm_year + 1900) * 400 + ptime.tm_yday;
+
+	auto iter = m_days.find(key);
+	if (iter != m_days.end())
+		return iter->second;
+
+	if (m_days.size() >= C_MAX_CACHED_DAYS)
+		m_days.clear();
+
+	char buff[256];
+	snprintf(
+		buff,
+		sizeof buff,
+		m_dateFormat.c_str(),
+		GetMonthName(ptime.tm_mon).c_str(),
+		ptime.tm_mday,
+		GetDaySuffix(ptime.tm_mday),
+		ptime.tm_year + 1900
+	);
+	buff[sizeof buff - 1] = 0;
+
+	return m_days[key] = InternedString(buff);
+}
+
+TimeFormatCache::MinuteEntry& TimeFormatCache::GetMinute(time_t time)
+{
+	LoadFormats();
+	CheckDayRollover();
+
+	// N.B. Time zones are offset by whole minutes, so minutes line up with
+	// local ones.
+	int64_t key = int64_t(time) / 60 - (time < 0 && time % 60 != 0 ? 1 : 0);
+
+	auto iter = m_minutes.find(key);
+	if (iter != m_minutes.end())
+		return iter->second;
+
+	if (m_minutes.size() >= C_MAX_CACHED_MINUTES)
+		m_minutes.clear();
+
+	struct tm ptime = *localtime(&time);
+
+	const std::string* pLongFormat = &m_longFormat;
+	if (time >= m_todayStart && time < m_tomorrowStart)
+		pLongFormat = &m_todayAtFormat;
+	else if (time >= m_yesterdayStart && time < m_todayStart)
+		pLongFormat = &m_yesterdayAtFormat;
+
+	MinuteEntry& entry = m_minutes[key];
+	char buff[256];
+
+	strftime(buff, sizeof buff, pLongFormat->c_str(), &ptime);
+	buff[sizeof buff - 1] = 0;
+	entry.m_long = InternedString(buff);
+
+	strftime(buff, sizeof buff, m_shorterFormat.c_str(), &ptime);
+	buff[sizeof buff - 1] = 0;
+	entry.m_shorter = InternedString(buff);
+
+	entry.m_date = GetDate(ptime);
+	return entry;
+}
+
+const InternedString& TimeFormatCache::FormatTimeLong(time_t time)
+{
+	return GetMinute(time).m_long;
+}
+
+const InternedString& TimeFormatCache::FormatTimeShorter(time_t time)
+{
+	return GetMinute(time).m_shorter;
+}
+
+const InternedString& TimeFormatCache::FormatDate(time_t time)
+{
+	return GetMinute(time).m_date;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include "InternedString.hpp"
+
+// Maximum amount of minutes whose strings are cached.
+#define C_MAX_CACHED_MINUTES (4096)
+
+// Maximum amount of days whose strings are cached.
+#define C_MAX_CACHED_DAYS (1024)
+
+// Caches the dates shown with messages.  Messages sent in the same minute
+// share their strings, so dating a page of messages mostly takes lookups.
+// Strings relative to the current day, such as "Today at", are regenerated
+// once the day rolls over.
+//
+// N.B. Only used from the main thread.
+class TimeFormatCache
+{
+public:
+	// Same as FormatTimeLong(time, true).
+	const InternedString& FormatTimeLong(time_t time);
+	// Same as FormatTimeShorter(time).
+	const InternedString& FormatTimeShorter(time_t time);
+	// Same as FormatDate(time).
+	const InternedString& FormatDate(time_t time);
+
+	// Forgets all strings, for when the formats change.
+	void Clear();
+
+private:
+	struct MinuteEntry
+	{
+		InternedString m_long;
+		InternedString m_shorter;
+		InternedString m_date;
+	};
+
+	MinuteEntry& GetMinute(time_t time);
+	const InternedString& GetDate(const struct tm& ptime);
+	void CheckDayRollover();
+	void LoadFormats();
+
+	std::unordered_map<int64_t, MinuteEntry> m_minutes;
+	std::unordered_map<int, InternedString> m_days;
+
+	// The current day, and the days before and after it, in local time.
+	time_t m_yesterdayStart = 0;
+	time_t m_todayStart = 0;
+	time_t m_tomorrowStart = 0;
+
+	bool m_bLoadedFormats = false;
+	std::string m_todayAtFormat;
+	std::string m_yesterdayAtFormat;
+	std::string m_longFormat;
+	std::string m_shorterFormat;
+	std::string m_dateFormat;
+};
+
+TimeFormatCache* GetTimeFormatCache();
@@ -331,75 +331,103 @@ const char* GetDaySuffix(int day)
 	return "th";
 }
 
-time_t ParseTime(const std::string& iso8601)
+// Reads a fixed amount of digits.
+static bool ParseDigits(const char*& str, const char* end, int count, int& out)
 {
-	// tokenize date
-	std::vector<std::string> dateTokens;
-	std::string currentToken = "";
-	bool encounteredT = false;
-	for (auto c : iso8601)
+	if (end - str < count)
+		return false;
+
+	int value = 0;
+	for (int i = 0; i < count; i++)
 	{
-		if (c == 'T' || c == 'Z' || c == '+' || (c == '-' && encounteredT)) {
-			dateTokens.push_back(currentToken);
-			currentToken.clear();
-		}
-		if (c == 'T') encounteredT = true;
-		currentToken += c;
+		if (str[i] < '0' || str[i] > '9')
+			return false;
+
+		value = value * 10 + (str[i] - '0');
 	}
 
-	if (!currentToken.empty())
-		dateTokens.push_back(currentToken);
+	str += count;
+	out = value;
+	return true;
+}
 
-	struct tm ptime { 0 };
+static bool ParseChar(const char*& str, const char* end, char c)
+{
+	if (str == end || *str != c)
+		return false;
+
+	str++;
+	return true;
+}
+
+// Days between January 1, 1970 and the given date.
+static int64_t DaysFromCivil(int y, int m, int d)
+{
+	y -= m <= 2;
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int yoe = int(y - era * 400);
+	int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
 
+time_t ParseTime(const std::string& iso8601)
+{
 	// Date string format: yyyy-mm-ddThh:mm:ss.wwwzzz+oo:pp
 	// w - millisecond, z - microsecond (0)
 	// oo - offset hr
 	// pp - offset min
+	const char* str = iso8601.c_str();
+	const char* end = str + iso8601.size();
+
+	int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+	if (!ParseDigits(str, end, 4, year) || !ParseChar(str, end, '-') ||
+		!ParseDigits(str, end, 2, month) || !ParseChar(str, end, '-') ||
+		!ParseDigits(str, end, 2, day))
+		return 0;
 
-	for (auto& tk : dateTokens)
+	if (str != end)
 	{
-		if (tk.empty())
-			continue;
-
-		if (tk[0] == 'T') {
-			// time mode
-			int h = 0, m = 0, s = 0;
-			sscanf(tk.c_str() + 1, "%d:%d:%d", &h, &m, &s);
-			ptime.tm_hour = h;
-			ptime.tm_min  = m;
-			ptime.tm_sec  = s;
-			continue;
+		if (!(ParseChar(str, end, 'T') || ParseChar(str, end, ' ')) ||
+			!ParseDigits(str, end, 2, hour) || !ParseChar(str, end, ':') ||
+			!ParseDigits(str, end, 2, minute) || !ParseChar(str, end, ':') ||
+			!ParseDigits(str, end, 2, second))
+			return 0;
+
+		// Fractions of a second are ignored.
+		if (ParseChar(str, end, '.')) {
+			while (str != end && *str >= '0' && *str <= '9')
+				str++;
 		}
+	}
 
-		if (tk[0] == '+' || tk[0] == '-') {
-			// time zone offset mode TODO
-			continue;
-		}
+	int offset = 0;
+	if (str != end && (*str == '+' || *str == '-'))
+	{
+		int sign = *str == '-' ? -1 : 1;
+		int offsetHour = 0, offsetMinute = 0;
+		str++;
 
-		if (isdigit(tk[0])) {
-			// date mode
-			int y = 0, m = 0, d = 0;
-			sscanf(tk.c_str(), "%d-%d-%d", &y, &m, &d);
-			ptime.tm_year = y - 1900;
-			ptime.tm_mon  = m - 1;
-			ptime.tm_mday = d;
-			continue;
-		}
+		if (!ParseDigits(str, end, 2, offsetHour))
+			return 0;
 
-		assert(!"unknown date mode");
+		ParseChar(str, end, ':');
+		if (!ParseDigits(str, end, 2, offsetMinute))
+			return 0;
+
+		offset = sign * (offsetHour * 3600 + offsetMinute * 60);
 	}
 
-	// Convert to time_t
-	// XXX timegm on linux
-#ifdef _WIN32
-	extern time_t MakeGMTime(const tm* ptime);
-	time_t t = MakeGMTime(&ptime);
-	//time_t t = _mkgmtime(&ptime);
-#else
-	time_t t = timegm(&ptime);
-#endif
-	return t;
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+		return 0;
+
+	int64_t t = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+
+	// N.B. time_t may be 32-bit.
+	if (sizeof(time_t) < sizeof(int64_t) && t > INT32_MAX)
+		t = INT32_MAX;
+
+	return time_t(t);
 }
 
 std::string FormatDate(time_t time)
@@ -433,7 +461,7 @@ std::string FormatTimeLong(time_t time, bool relativity)
 		todaytime -= 86400;
 		struct tm ydaytm = *localtime(&todaytime); // fetch yesterday's time
 		istoday = todaytm.tm_yday == ptime.tm_yday && todaytm.tm_year == ptime.tm_year;
-		isyday  = todaytm.tm_yday == ptime.tm_yday && ydaytm.tm_year  == ptime.tm_year;
+		isyday  = ydaytm.tm_yday  == ptime.tm_yday && ydaytm.tm_year  == ptime.tm_year;
 	}
 
 	/**/ if (istoday) strftime(buff, sizeof buff, GetFrontend()->GetTodayAtText().c_str(), &ptime);
@@ -39,7 +39,7 @@ bool GetFieldSafeBool(const nlohmann::json& j, const std::string& key, bool defa
 std::string GetFieldSafe(const nlohmann::json& j, const std::string& key);
 std::string GetMonthName(int mon);
 const char* GetDaySuffix(int day);
-time_t ParseTime(const std::string& iso8601);
+time_t ParseTime(const std::string& iso8601); // returns 0 if the timestamp is invalid
 std::string FormatDate(time_t time); // January 1, 1970
 std::string FormatTimeLong(time_t time, bool relativity = false); // relativity=true means "Today at" and "Yesterday at" show
 std::string FormatTimeShort(time_t time);
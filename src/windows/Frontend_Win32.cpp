@@ -37,7 +37,7 @@ void Frontend_Win32::OnConnected()
 	SendMessage(g_Hwnd, WM_CONNECTED, 0, 0);
 }
 
-void Frontend_Win32::OnAddMessage(Snowflake channelID, const Message& msg)
+void Frontend_Win32::OnAddMessage(Snowflake channelID, const MessagePtr& msg)
 {
 	AddMessageParams parms;
 	parms.channel = channelID;
@@ -45,7 +45,7 @@ void Frontend_Win32::OnAddMessage(Snowflake channelID, const Message& msg)
 	SendMessage(g_Hwnd, WM_ADDMESSAGE, 0, (LPARAM)&parms);
 }
 
-void Frontend_Win32::OnUpdateMessage(Snowflake channelID, const Message& msg)
+void Frontend_Win32::OnUpdateMessage(Snowflake channelID, const MessagePtr& msg)
 {
 	AddMessageParams parms;
 	parms.channel = channelID;
@@ -263,9 +263,24 @@ void Frontend_Win32::UpdateChannelList()
 	SendMessage(g_Hwnd, WM_UPDATECHANLIST, 0, 0);
 }
 
-void Frontend_Win32::UpdateMemberList()
+void Frontend_Win32::UpdateMemberList(Snowflake guild, size_t start, size_t end, bool bResized)
 {
-	SendMessage(g_Hwnd, WM_UPDATEMEMBERLIST, 0, 0);
+	UpdateMemberListParams parms;
+	parms.m_guild = guild;
+	parms.m_start = start;
+	parms.m_end = end;
+	parms.m_bResized = bResized;
+	SendMessage(g_Hwnd, WM_UPDATEMEMBERLIST, 0, (LPARAM) &parms);
+}
+
+void Frontend_Win32::SpliceMemberList(Snowflake guild, size_t index, size_t erased, size_t inserted)
+{
+	SpliceMemberListParams parms;
+	parms.m_guild = guild;
+	parms.m_index = index;
+	parms.m_erased = erased;
+	parms.m_inserted = inserted;
+	SendMessage(g_Hwnd, WM_SPLICEMEMBERLIST, 0, (LPARAM) &parms);
 }
 
 void Frontend_Win32::UpdateChannelAcknowledge(Snowflake channelID, Snowflake messageID)
@@ -470,6 +485,11 @@ void Frontend_Win32::SetHeartbeatInterval(int timeMs)
 	::SetHeartbeatInterval(timeMs);
 }
 
+void Frontend_Win32::SetProfileFetchTimer(int timeMs)
+{
+	::SetProfileFetchTimer(timeMs);
+}
+
 void Frontend_Win32::LaunchURL(const std::string& url)
 {
 	::LaunchURL(url);
@@ -13,8 +13,8 @@ public:
 	void OnSessionClosed(int errorCode) override;
 	void OnConnecting() override;
 	void OnConnected() override;
-	void OnAddMessage(Snowflake channelID, const Message& msg) override;
-	void OnUpdateMessage(Snowflake channelID, const Message& msg) override;
+	void OnAddMessage(Snowflake channelID, const MessagePtr& msg) override;
+	void OnUpdateMessage(Snowflake channelID, const MessagePtr& msg) override;
 	void OnDeleteMessage(Snowflake messageInCurrentChannel) override;
 	void OnStartTyping(Snowflake userID, Snowflake guildID, Snowflake channelID, time_t startTime) override;
 	void OnRequestDone(NetRequest* pRequest) override;
@@ -37,7 +37,8 @@ public:
 	void UpdateSelectedGuild() override;
 	void UpdateSelectedChannel() override;
 	void UpdateChannelList() override;
-	void UpdateMemberList() override;
+	void UpdateMemberList(Snowflake guild, size_t start, size_t end, bool bResized) override;
+	void SpliceMemberList(Snowflake guild, size_t index, size_t erased, size_t inserted) override;
 	void UpdateChannelAcknowledge(Snowflake channelID, Snowflake messageID) override;
 	void UpdateProfileAvatar(Snowflake userID, const std::string& resid) override;
 	void UpdateProfilePopout(Snowflake userID) override;
@@ -53,6 +54,7 @@ public:
 	void OnWebsocketClose(int gatewayID, int errorCode, const std::string& message) override;
 	void OnWebsocketFail(int gatewayID, int errorCode, const std::string& message, bool isTLSError, bool mayRetry) override;
 	void SetHeartbeatInterval(int timeMs) override;
+	void SetProfileFetchTimer(int timeMs) override;
 	void LaunchURL(const std::string& url) override;
 	void RegisterIcon(Snowflake sf, const std::string& avatarlnk) override;
 	void RegisterAvatar(Snowflake sf, const std::string& avatarlnk) override;
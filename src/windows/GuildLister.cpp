@@ -349,7 +349,7 @@ void GuildLister::ShowMenu(Snowflake guild, POINT pt)
 		PERM_MANAGE_GUILD_EXPRESSIONS |
 		PERM_MANAGE_CHANNELS |
 		PERM_MANAGE_ROLES;
-	for (auto& rolid : pf->m_guildMembers[guild].m_roles)
+	for (auto& rolid : pGuild->GetGuildMember(pf->m_snowflake).GetRoles())
 	{
 		GuildRole& rol = pGuild->m_roles[rolid];
 
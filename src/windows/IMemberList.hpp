@@ -13,6 +13,12 @@ public:
 
 	virtual void SetGuild(Snowflake sf) = 0;
 	virtual void Update() = 0;
+	// Entries [start, end) of the guild's member list were replaced, without
+	// any being added or removed.
+	virtual void UpdateRange(Snowflake guild, size_t start, size_t end) = 0;
+	// 'erased' members at this position of the guild's member list were
+	// replaced by 'inserted' new ones.  Group headers are left as they were.
+	virtual void Splice(Snowflake guild, size_t index, size_t erased, size_t inserted) = 0;
 	virtual void UpdateMembers(std::set<Snowflake>& mems) = 0;
 	virtual void OnUpdateAvatar(Snowflake sf, bool bAlsoUpdateText = false) = 0;
 	virtual void ClearMembers() = 0;
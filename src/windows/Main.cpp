@@ -955,10 +955,29 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			if (!pGuild)
 				break;
 
+			// Entries that were only replaced don't need the whole list rebuilt.
+			// Without params, e.g. when the guild changed, rebuild it anyway.
+			UpdateMemberListParams* pParms = (UpdateMemberListParams*) lParam;
+			if (pParms && !pParms->m_bResized && pParms->m_guild == pGuild->m_snowflake) {
+				g_pMemberList->UpdateRange(pParms->m_guild, pParms->m_start, pParms->m_end);
+				break;
+			}
+
 			g_pMemberList->SetGuild(pGuild->m_snowflake);
 			g_pMemberList->Update();
 			break;
 		}
+		case WM_SPLICEMEMBERLIST:
+		{
+			// Other guilds' member lists aren't shown.
+			Guild* pGuild = GetDiscordInstance()->GetCurrentGuild();
+			SpliceMemberListParams* pParms = (SpliceMemberListParams*) lParam;
+			if (!pGuild || pParms->m_guild != pGuild->m_snowflake)
+				break;
+
+			g_pMemberList->Splice(pParms->m_guild, pParms->m_index, pParms->m_erased, pParms->m_inserted);
+			break;
+		}
 		case WM_TOGGLEMEMBERS:
 		{
 			g_bMemberListVisible ^= 1;
@@ -1072,13 +1091,26 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 		// wParam = request code, lParam = Request*
 		case WM_REQUESTDONE:
 		{
-			NetRequest cloneReq = * (NetRequest*) lParam;
+			NetRequest* pRequest = (NetRequest*) lParam;
+
+			// Progress reports are handled in place.  The networker thread waits
+			// for us to return and then checks m_bCancelOp.
+			if (pRequest->result == HTTP_PROGRESS) {
+				GetDiscordInstance()->HandleRequest(pRequest);
+				break;
+			}
+
+			// Take over the request's buffers instead of copying them, so that
+			// the networker thread can move on right away.
+			NetRequest* pOwnReq = NetRequest::Acquire();
+			std::swap(*pOwnReq, *pRequest);
 
 			// Round-trip time should probably be low to avoid stalling.
 			if (InSendMessage())
 				ReplyMessage(0);
 
-			GetDiscordInstance()->HandleRequest(&cloneReq);
+			GetDiscordInstance()->HandleRequest(pOwnReq);
+			NetRequest::Release(pOwnReq);
 			break;
 		}
 		case WM_ADDMESSAGE:
@@ -1089,8 +1121,8 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 			if (g_pMessageList->GetCurrentChannel() == pParms->channel)
 			{
-				g_pMessageList->AddMessage(pParms->msg.m_snowflake, GetForegroundWindow() == hWnd);
-				OnStopTyping(pParms->channel, pParms->msg.m_author_snowflake);
+				g_pMessageList->AddMessage(pParms->msg->m_snowflake, GetForegroundWindow() == hWnd);
+				OnStopTyping(pParms->channel, pParms->msg->m_author_snowflake);
 			}
 
 			Channel* pChan = GetDiscordInstance()->GetChannel(pParms->channel);
@@ -1111,7 +1143,7 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			GetMessageCache()->EditMessage(pParms->channel, pParms->msg);
 
 			if (g_pMessageList->GetCurrentChannel() == pParms->channel)
-				g_pMessageList->EditMessage(pParms->msg.m_snowflake);
+				g_pMessageList->EditMessage(pParms->msg->m_snowflake);
 
 			break;
 		}
@@ -1638,9 +1670,9 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 				ProgressDialog::Show("Test!", 1234, false, g_Hwnd);
 			}
 			if (wParam == VK_F11) {
-				Message msg;
-				msg.m_author = "Test Author";
-				msg.m_message = "Test message!!";
+				MessagePtr msg = MakeMessage();
+				msg->m_author = "Test Author";
+				msg->m_message = "Test message!!";
 				GetNotificationManager()->OnMessageCreate(0, 1, msg);
 			}
 #endif
@@ -2209,3 +2241,30 @@ void SetHeartbeatInterval(int timeMs)
 		g_HeartbeatTimer = SetTimer(g_Hwnd, 0, timeMs, OnHeartbeatTimer);
 	}
 }
+
+UINT_PTR g_profileFetchTimer = 0;
+const UINT_PTR g_profileFetchTimerId = 123457;
+
+void CALLBACK OnProfileFetchTimer(HWND hWnd, UINT uMsg, UINT_PTR uTimerID, DWORD dwParam)
+{
+	if (uTimerID != g_profileFetchTimerId)
+		return;
+
+	KillTimer(hWnd, g_profileFetchTimer);
+	g_profileFetchTimer = 0;
+	GetDiscordInstance()->m_profileFetchScheduler.OnTimer();
+}
+
+void SetProfileFetchTimer(int timeMs)
+{
+	// Setting a timer with the same ID replaces it.
+	if (timeMs != 0) {
+		g_profileFetchTimer = SetTimer(g_Hwnd, g_profileFetchTimerId, timeMs, OnProfileFetchTimer);
+		return;
+	}
+
+	if (g_profileFetchTimer != 0) {
+		KillTimer(g_Hwnd, g_profileFetchTimer);
+		g_profileFetchTimer = 0;
+	}
+}
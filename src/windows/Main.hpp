@@ -116,6 +116,22 @@ struct UpdateProfileParams
 	std::string m_resId;
 };
 
+struct UpdateMemberListParams
+{
+	Snowflake m_guild;
+	size_t m_start;
+	size_t m_end;
+	bool m_bResized;
+};
+
+struct SpliceMemberListParams
+{
+	Snowflake m_guild;
+	size_t m_index;
+	size_t m_erased;
+	size_t m_inserted;
+};
+
 struct WebsocketMessageParams
 {
 	int m_gatewayId;
@@ -152,6 +168,7 @@ void OnUpdateAvatar(const std::string& resid);
 DiscordInstance* GetDiscordInstance();
 void WantQuit();
 void SetHeartbeatInterval(int timeMs);
+void SetProfileFetchTimer(int timeMs);
 int GetProfilePictureSize();
 HBITMAP GetDefaultBitmap();
 bool ShouldBlockDoubleBuffering();
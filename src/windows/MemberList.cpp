@@ -76,6 +76,11 @@ std::map<Snowflake, bool> mockOnlineStat;
 static TCHAR buff1[4096];
 static TCHAR buff2[4096];
 
+static std::string GetGroupHeaderText(Guild* pGuild, GuildMember& group)
+{
+	return pGuild->GetGroupName(group.GetGroupId()) + " - " + std::to_string(group.GetGroupCount());
+}
+
 void MemberList::Update()
 {
 	StartUpdate();
@@ -91,18 +96,18 @@ void MemberList::Update()
 	ri::GetScrollInfo(m_listHwnd, SB_VERT, &si);
 
 	// Add each group
-	for (auto& mem : pGuild->m_members)
+	pGuild->m_members.ForEach([&](Snowflake mem, bool bIsGroup)
 	{
-		GuildMember* pGroup = pGuild->GetGuildMember(mem);
-		if (!pGroup->m_bIsGroup)
-			continue;
+		if (!bIsGroup)
+			return;
 
-		if (pGroup->m_groupCount == 0)
+		GuildMember group = pGuild->GetGuildMember(mem);
+		if (group.GetGroupCount() == 0)
 			// not worth it
-			continue;
+			return;
 
 #ifdef UNICODE
-		LPTSTR strName = ConvertCppStringToTString(pGuild->GetGroupName(pGroup->m_groupId) + " - " + std::to_string(pGroup->m_groupCount));
+		LPTSTR strName = ConvertCppStringToTString(GetGroupHeaderText(pGuild, group));
 		LVGROUP grpz{};
 		grpz.cbSize = sizeof(LVGROUP);
 		grpz.mask = LVGF_HEADER | LVGF_GROUPID;
@@ -110,51 +115,236 @@ void MemberList::Update()
 		grpz.iGroupId = m_nextGroup;
 		ListView_InsertGroup(m_listHwnd, -1, &grpz);
 		free(strName);
-		m_groups.push_back(pGroup->m_groupId);
-		m_grpToGrpIdx[pGroup->m_groupId] = m_nextGroup;
+		m_groups.push_back(group.GetGroupId());
+		m_grpToGrpIdx[group.GetGroupId()] = m_nextGroup;
 		m_nextGroup++;
 #endif
+	});
+
+	// Now add each non-group member.  Placeholders for members that weren't
+	// loaded yet get an empty row, under the group header before them.
+	Snowflake currentGroup = 0;
+	pGuild->m_members.ForEach([&](Snowflake mem, bool bIsGroup)
+	{
+		if (bIsGroup) {
+			currentGroup = mem;
+			return;
+		}
+
+		if (mem)
+			m_usrToUsrIdx[mem] = m_nextItem;
+
+		InsertItem(m_nextItem, mem, currentGroup);
+	});
+
+	// Now restore the position
+	//ListView_Scroll(m_listHwnd, 0, si.nPos);
+
+	StopUpdate();
+
+	UpdateViewport();
+}
+
+void MemberList::UpdateRange(Snowflake guild, size_t start, size_t end)
+{
+	Guild* pGuild = GetDiscordInstance()->GetGuild(guild);
+	if (!pGuild)
+		return;
+
+	// Group headers map to list view groups, so rebuild if any was replaced,
+	// or if the items don't line up with the guild's list anymore.
+	const MemberListTree& members = pGuild->m_members;
+	bool bRebuild = m_guild != guild ||
+		end > members.Size() ||
+		m_items.size() != members.Size() - members.CountGroupsBefore(members.Size());
+
+	std::vector<Snowflake> replaced, groups;
+	if (!bRebuild)
+	{
+		members.ForEachInRange(start, end, [&](size_t index, Snowflake sf, bool bIsGroup) {
+			if (bIsGroup)
+				groups.push_back(sf);
+			else
+				replaced.push_back(sf);
+		});
+	}
+
+	// Only the counts of the group headers can be updated in place.
+	for (size_t i = 0; i < groups.size() && !bRebuild; i++)
+		bRebuild = !UpdateGroupHeader(pGuild, groups[i]);
+
+	if (bRebuild) {
+		SetGuild(guild);
+		Update();
+		return;
+	}
+
+	// Items only count the members, not the group headers before them.
+	int item = int(start - members.CountGroupsBefore(start));
+	for (Snowflake user : replaced)
+	{
+		auto iter = m_usrToUsrIdx.find(m_items[item]);
+		if (iter != m_usrToUsrIdx.end() && iter->second == item)
+			m_usrToUsrIdx.erase(iter);
+
+		m_items[item] = user;
+		if (user) {
+			m_usrToUsrIdx[user] = item;
+			OnUpdateAvatar(user, true);
+		}
+		else {
+			ListView_RedrawItems(m_listHwnd, item, item);
+		}
+		item++;
+	}
+}
+
+void MemberList::Splice(Snowflake guild, size_t index, size_t erased, size_t inserted)
+{
+	Guild* pGuild = GetDiscordInstance()->GetGuild(guild);
+	if (!pGuild)
+		return;
+
+	// The items must line up with the guild's list once the change is made to
+	// them, and group headers map to list view groups, so rebuild otherwise.
+	const MemberListTree& members = pGuild->m_members;
+	bool bRebuild = m_guild != guild ||
+		index + inserted > members.Size() ||
+		m_items.size() + inserted != members.Size() - members.CountGroupsBefore(members.Size()) + erased;
+
+	std::vector<std::pair<Snowflake, Snowflake>> added; // user, group
+	if (!bRebuild)
+	{
+		members.ForEachInRange(index, index + inserted, [&](size_t pos, Snowflake sf, bool bIsGroup) {
+			if (bIsGroup)
+				bRebuild = true;
+			else
+				added.push_back(std::make_pair(sf, members.GetGroupAt(pos)));
+		});
+	}
+
+	if (bRebuild) {
+		SetGuild(guild);
+		Update();
+		return;
 	}
 
-	// Now add each non-group member
-	for (auto& mem : pGuild->m_members)
+	// Items only count the members, not the group headers before them.
+	int item = int(index - members.CountGroupsBefore(index));
+	if (m_hotItem >= item)
+		m_hotItem = -1;
+
+	for (size_t i = 0; i < erased; i++)
 	{
-		GuildMember* pMember = pGuild->GetGuildMember(mem);
-		if (pMember->m_bIsGroup)
-			continue;
+		auto iter = m_usrToUsrIdx.find(m_items[item]);
+		if (iter != m_usrToUsrIdx.end() && iter->second == item)
+			m_usrToUsrIdx.erase(iter);
+
+		m_items.erase(m_items.begin() + item);
+		ListView_DeleteItem(m_listHwnd, item);
+		m_nextItem--;
+	}
+
+	for (size_t i = 0; i < added.size(); i++)
+		InsertItem(item + int(i), added[i].first, added[i].second);
+
+	// The items after them moved.
+	for (int i = item; i < int(m_items.size()); i++)
+	{
+		if (m_items[i])
+			m_usrToUsrIdx[m_items[i]] = i;
+	}
+
+	UpdateViewport();
+}
 
-		LVITEM lvi{};
-		int groupId = 0;
+void MemberList::InsertItem(int item, Snowflake user, Snowflake group)
+{
+	LVITEM lvi{};
+	int groupId = 0;
 #ifdef UNICODE
-		groupId = LVIF_GROUPID;
+	groupId = LVIF_GROUPID;
 #endif
 
-		TCHAR testStr[] = TEXT("");
-
-		lvi.mask = LVIF_TEXT | LVIF_STATE | LVIF_COLUMNS | groupId;
-		lvi.stateMask = LVIS_OVERLAYMASK;
-		lvi.pszText = testStr;
-		lvi.iItem = m_nextItem;
-		lvi.iSubItem = 0;
-		lvi.iImage = 0;
-		lvi.state = 0;
-		lvi.cColumns = _countof(g_columnIndices);
-		lvi.puColumns = g_columnIndices;
+	TCHAR testStr[] = TEXT("");
+
+	lvi.mask = LVIF_TEXT | LVIF_STATE | LVIF_COLUMNS | groupId;
+	lvi.stateMask = LVIS_OVERLAYMASK;
+	lvi.pszText = testStr;
+	lvi.iItem = item;
+	lvi.iSubItem = 0;
+	lvi.iImage = 0;
+	lvi.state = 0;
+	lvi.cColumns = _countof(g_columnIndices);
+	lvi.puColumns = g_columnIndices;
 #ifdef UNICODE
-		lvi.iGroupId = m_grpToGrpIdx[pMember->m_groupId];
+	lvi.iGroupId = m_grpToGrpIdx[group];
 #endif
 
-		m_usrToUsrIdx[pMember->m_user] = m_nextItem;
-		m_items.push_back(pMember->m_user);
-		m_nextItem++;
+	m_items.insert(m_items.begin() + item, user);
+	m_nextItem++;
+
+	ListView_InsertItem(m_listHwnd, &lvi);
+}
+
+bool MemberList::UpdateGroupHeader(Guild* pGuild, Snowflake groupId)
+{
+#ifdef UNICODE
+	// Groups without members have no header, see Update().
+	GuildMember group = pGuild->GetGuildMember(groupId);
+	auto iter = m_grpToGrpIdx.find(groupId);
+	if (group.GetGroupCount() == 0 ||
+		iter == m_grpToGrpIdx.end() ||
+		iter->second >= int(m_groups.size()) ||
+		m_groups[iter->second] != groupId)
+		return false;
+
+	LPTSTR strName = ConvertCppStringToTString(GetGroupHeaderText(pGuild, group));
+	LVGROUP grpz{};
+	grpz.cbSize = sizeof(LVGROUP);
+	grpz.mask = LVGF_HEADER;
+	grpz.pszHeader = strName;
+	ListView_SetGroupInfo(m_listHwnd, iter->second, &grpz);
+	free(strName);
+#endif
+	return true;
+}
 
-		ListView_InsertItem(m_listHwnd, &lvi);
+void MemberList::UpdateViewport()
+{
+	if (m_items.empty())
+		return;
+
+	Guild* pGuild = GetDiscordInstance()->GetGuild(m_guild);
+	if (!pGuild)
+		return;
+
+	// N.B. The top index isn't reliable with groups enabled, so hit test the
+	// top and bottom of the list instead.  Group headers don't hit any item.
+	RECT rc{};
+	GetClientRect(m_listHwnd, &rc);
+
+	int step = ScaleByDPI(8);
+	int first = -1, last = -1;
+	for (int y = rc.top; y < rc.bottom && first < 0; y += step)
+	{
+		LVHITTESTINFO hti{};
+		hti.pt = { rc.left + step, y };
+		first = ListView_HitTest(m_listHwnd, &hti);
+	}
+	for (int y = rc.bottom - 1; y >= rc.top && last < 0; y -= step)
+	{
+		LVHITTESTINFO hti{};
+		hti.pt = { rc.left + step, y };
+		last = ListView_HitTest(m_listHwnd, &hti);
 	}
 
-	// Now restore the position
-	//ListView_Scroll(m_listHwnd, 0, si.nPos);
+	if (first < 0 || last < first)
+		return;
 
-	StopUpdate();
+	// The items leave out the group headers, the server's positions don't.
+	const MemberListTree& members = pGuild->m_members;
+	GetDiscordInstance()->UpdateMemberListViewport(m_guild, members.FindMember(first), members.FindMember(last));
 }
 
 bool MemberList::OnNotify(LRESULT& out, WPARAM wParam, LPARAM lParam)
@@ -176,6 +366,10 @@ bool MemberList::OnNotify(LRESULT& out, WPARAM wParam, LPARAM lParam)
 			if (oldItem != m_hotItem) {
 				ListView_RedrawItems(m_listHwnd, oldItem,   oldItem);
 				ListView_RedrawItems(m_listHwnd, m_hotItem, m_hotItem);
+
+				// Get the profile ready in case its popout is opened.
+				if (m_hotItem >= 0 && m_hotItem < int(m_items.size()))
+					GetProfileCache()->RequestProfile(m_items[m_hotItem], m_guild, DEMAND_HOVERED);
 			}
 
 			TRACKMOUSEEVENT tme;
@@ -200,6 +394,8 @@ bool MemberList::OnNotify(LRESULT& out, WPARAM wParam, LPARAM lParam)
 			{
 				int itemID = lplv->iItem;
 				Snowflake sf = m_items[itemID];
+				if (!sf)
+					break; // not loaded yet
 
 				RECT rcItem{};
 				ListView_GetItemRect(m_listHwnd, itemID, &rcItem, LVIR_BOUNDS);
@@ -293,6 +489,15 @@ LRESULT MemberList::ListWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
 			ListView_RedrawItems(hWnd, oldItem, oldItem);
 			break;
 		}
+		case WM_VSCROLL:
+		case WM_MOUSEWHEEL:
+		case WM_KEYDOWN:
+		{
+			// Subscribe to the part of the list scrolled to.
+			LRESULT lres = CallWindowProc(pList->m_origListWndProc, hWnd, uMsg, wParam, lParam);
+			pList->UpdateViewport();
+			return lres;
+		}
 	}
 
 	return CallWindowProc(pList->m_origListWndProc, hWnd, uMsg, wParam, lParam);
@@ -321,6 +526,7 @@ LRESULT MemberList::WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			WORD wWidth  = LOWORD(lParam);
 			WORD wHeight = HIWORD(lParam);
 			MoveWindow(pList->m_listHwnd, 0, 0, wWidth, wHeight, TRUE);
+			pList->UpdateViewport();
 			break;
 		}
 
@@ -362,8 +568,18 @@ LRESULT MemberList::WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			bool compact = GetLocalSettings()->GetCompactMemberList();
 
 			Snowflake user = pList->m_items[lpdis->itemID];
+			if (!user) {
+				// Not loaded yet, as the server didn't send this part of the list.
+				FillRect(lpdis->hDC, &lpdis->rcItem, ri::GetSysColorBrush(COLOR_WINDOW));
+				break;
+			}
+
 			Profile* pf = GetProfileCache()->LookupProfile(user, "", "", "", false);
 
+			// Fetch what the server left out, along with the other visible members.
+			if (pf->m_bUsingDefaultData)
+				GetProfileCache()->RequestProfile(user, pList->m_guild, DEMAND_VISIBLE);
+
 			COLORREF nameTextColor = 0;
 			COLORREF statusTextColor = GetSysColor(COLOR_GRAYTEXT);
 			COLORREF backgdColor = GetSysColor(COLOR_WINDOW);
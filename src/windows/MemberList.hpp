@@ -31,6 +31,9 @@ public:
 	void ClearMembers() override;
 	void SetGuild(Snowflake g) override;
 	void Update() override;
+	void UpdateRange(Snowflake guild, size_t start, size_t end) override;
+	void Splice(Snowflake guild, size_t index, size_t erased, size_t inserted) override;
+	void UpdateViewport();
 	void OnUpdateAvatar(Snowflake user, bool bAlsoUpdateText = false) override;
 	void UpdateMembers(std::set<Snowflake>& mems) override;
 	HWND GetListHWND() override { return m_listHwnd; }
@@ -43,6 +46,11 @@ public:
 
 private:
 	void Initialize();
+	void InsertItem(int item, Snowflake user, Snowflake group);
+
+	// Updates the member count a group's header shows.  Returns false if the
+	// group has no header, so the list has to be laid out again.
+	bool UpdateGroupHeader(Guild* pGuild, Snowflake groupId);
 	bool OnNotify(LRESULT& out, WPARAM wParam, LPARAM lParam);
 
 	static LRESULT CALLBACK ListWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
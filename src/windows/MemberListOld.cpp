@@ -88,24 +88,26 @@ void MemberListOld::Update()
 	std::vector<Member> newMembers;
 
 	// Add each non-group member
-	for (auto& mem : pGuild->m_members)
+	pGuild->m_members.ForEach([&](Snowflake mem, bool bIsGroup)
 	{
-		GuildMember* pMember = pGuild->GetGuildMember(mem);
-		if (pMember->m_bIsGroup)
-			continue;
+		// Placeholders aren't loaded yet.
+		if (bIsGroup || !mem)
+			return;
+
+		GuildMember member = pGuild->GetGuildMember(mem);
 
-		Profile* pf = GetProfileCache()->LookupProfile(pMember->m_user, "", "", "", false);
+		Profile* pf = GetProfileCache()->LookupProfile(member.GetUser(), "", "", "", false);
 
 		// are they online
 		if (pf->m_activeStatus == STATUS_OFFLINE && !pf->m_bUsingDefaultData)
-			continue;
+			return;
 
 		Member m;
-		m.m_id = pMember->m_user;
+		m.m_id = member.GetUser();
 		m.m_name = pf->GetName(m_guild);
 
 		newMembers.push_back(m);
-	}
+	});
 
 	// make sure to sort the new member list by name, keeps things easy
 	std::sort(newMembers.begin(), newMembers.end());
@@ -152,6 +154,20 @@ void MemberListOld::Update()
 	m_members = std::move(newMembers);
 }
 
+void MemberListOld::UpdateRange(Snowflake guild, size_t start, size_t end)
+{
+	// Sorted by name, so entries may have moved anyway.  Update() only
+	// touches the rows that changed.
+	SetGuild(guild);
+	Update();
+}
+
+void MemberListOld::Splice(Snowflake guild, size_t index, size_t erased, size_t inserted)
+{
+	SetGuild(guild);
+	Update();
+}
+
 void MemberListOld::UpdateMembers(std::set<Snowflake>& mems)
 {
 	for (auto mem : mems) {
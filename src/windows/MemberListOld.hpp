@@ -24,6 +24,8 @@ public:
 
 	void SetGuild(Snowflake sf) override;
 	void Update() override;
+	void UpdateRange(Snowflake guild, size_t start, size_t end) override;
+	void Splice(Snowflake guild, size_t index, size_t erased, size_t inserted) override;
 	void UpdateMembers(std::set<Snowflake>& mems) override;
 	void OnUpdateAvatar(Snowflake sf, bool bAlsoUpdateText = false) override;
 	void ClearMembers() override;
@@ -530,7 +530,8 @@ void MessageItem::Update(Snowflake guildID)
 
 	m_bWasMentioned = !m_bIsBlockedMessage && m_msg->CheckWasMentioned(GetDiscordInstance()->GetUserID(), guildID);
 
-	size_t attachmentCount = m_msg->m_attachments.size();
+	const std::vector<Attachment>& attachments = m_msg->GetAttachments();
+	size_t attachmentCount = attachments.size();
 	if (m_bIsBlockedMessage)
 		attachmentCount = 0;
 
@@ -540,7 +541,7 @@ void MessageItem::Update(Snowflake guildID)
 	for (size_t i = 0; i < attachmentCount; i++)
 	{
 		auto& item = m_attachmentData[i];
-		item.m_pAttachment = &m_msg->m_attachments[i];
+		item.m_pAttachment = &attachments[i];
 		item.Update();
 	}
 
@@ -613,11 +614,12 @@ void MessageItem::Update(Snowflake guildID)
 	}
 
 	m_embedData.clear();
-	m_embedData.resize(m_msg->m_embeds.size());
-	for (size_t i = 0; i < m_msg->m_embeds.size(); i++)
+	const std::vector<RichEmbed>& embeds = m_msg->GetEmbeds();
+	m_embedData.resize(embeds.size());
+	for (size_t i = 0; i < embeds.size(); i++)
 	{
 		RichEmbedItem& item = m_embedData[i];
-		RichEmbed& embed = m_msg->m_embeds[i];
+		const RichEmbed& embed = embeds[i];
 
 		item.m_pEmbed = &embed;
 		item.Update();
@@ -670,10 +672,10 @@ void MessageItem::Update(Snowflake guildID)
 		}
 	}
 
-	if (m_msg->m_pMessagePoll) {
+	if (m_msg->GetPoll()) {
 		SAFE_DELETE(m_pMessagePollData);
 
-		m_pMessagePollData = new MessagePollData(m_msg->m_pMessagePoll);
+		m_pMessagePollData = new MessagePollData(m_msg->GetPoll());
 		m_pMessagePollData->Update();
 	}
 
@@ -781,7 +783,7 @@ void MessageList::DeleteMessage(Snowflake sf)
 
 	if (afteriter != m_messages.end())
 	{
-		std::string nm, av;
+		InternedString nm, av;
 		Snowflake sf = Snowflake(-1);
 		time_t tm = 0;
 		int pl = 0;
@@ -918,12 +920,16 @@ void MessageList::RefetchMessages(Snowflake gapCulprit, bool causedByLoad)
 		oldMessageKey[it->m_msg->m_snowflake] = &*it;
 	}
 
-	// this sucks, but eh
-	std::list<MessagePtr> msgs;
-	GetMessageCache()->GetLoadedMessages(m_channelID, m_guildID, msgs);
+	// N.B. This walks the cache's own list.  It must not be changed until we're done.
+	const MessageRunList& msgs = GetMessageCache()->GetLoadedMessages(m_channelID, m_guildID);
 
-	// If you can't read the message history, no */messages GET requests can be issued, so do this
-	// dumb hack to disable them
+	// If we know what changed since the last refetch, only those messages need updating.
+	std::set<Snowflake> changedMessages;
+	bool haveChanges = m_cacheVersion && GetMessageCache()->GetChangesSince(m_channelID, m_cacheVersion, changedMessages);
+	m_cacheVersion = GetMessageCache()->GetVersion(m_channelID);
+
+	// If you can't read the message history, no */messages GET requests can be issued, so the
+	// gaps are shown as placeholders instead, and don't bound the range that is shown.
 	Guild* pGuild = GetDiscordInstance()->GetGuild(m_guildID);
 	assert(pGuild);
 	Channel* pChannel = pGuild->GetChannel(m_channelID);
@@ -931,30 +937,14 @@ void MessageList::RefetchMessages(Snowflake gapCulprit, bool causedByLoad)
 
 	bool canViewMessageHistory = pChannel->HasPermission(PERM_READ_MESSAGE_HISTORY);
 
-	if (!canViewMessageHistory)
-	{
-		for (auto& msg : msgs)
-		{
-			if (msg->m_type == MessageType::GAP_UP || msg->m_type == MessageType::GAP_DOWN || msg->m_type == MessageType::GAP_AROUND)
-			{
-				msg->m_type = MessageType::CANT_VIEW_MSG_HISTORY;
-				msg->m_message = "";
-				msg->m_author = "#" + pChannel->m_name;
-			}
-		}
-	}
+	auto isLoadGap = [&](const MessagePtr& msg) {
+		return canViewMessageHistory && msg->IsLoadGap();
+	};
 	
-	std::list<MessagePtr>::iterator start = msgs.begin(), end = msgs.end();
-
-	Snowflake sf = anchor;
+	MessageRunList::const_iterator start = msgs.begin(), end = msgs.end();
 
 	// find the message that triggered the load
-	std::list<MessagePtr>::iterator it1;
-	for (it1 = msgs.begin(); it1 != msgs.end(); ++it1)
-	{
-		if ((*it1)->m_snowflake == sf)
-			break;
-	}
+	MessageRunList::const_iterator it1 = msgs.FindEntry(anchor);
 
 	// if it exists
 	if (it1 != msgs.end())
@@ -966,14 +956,14 @@ void MessageList::RefetchMessages(Snowflake gapCulprit, bool causedByLoad)
 		{
 			--start;
 			
-			if ((*start)->IsLoadGap())
+			if (isLoadGap(*start))
 				break;
 		}
 
 		// start scanning for the end
 		while (end != msgs.end())
 		{
-			if ((*end)->IsLoadGap())
+			if (isLoadGap(*end))
 				break;
 
 			++end;
@@ -1010,11 +1000,27 @@ void MessageList::RefetchMessages(Snowflake gapCulprit, bool causedByLoad)
 
 	for (auto iter = start; iter != end; ++iter)
 	{
-		auto& msg = *iter;
+		MessagePtr msg = *iter;
 
 		// If the message is already present:
 		auto oldMsg = oldMessageKey[msg->m_snowflake];
 
+		// N.B. The placeholder is a copy.  The cache's own gap must stay a gap.
+		if (!canViewMessageHistory && msg->IsLoadGap())
+		{
+			if (oldMsg && oldMsg->m_msg->m_type == MessageType::CANT_VIEW_MSG_HISTORY)
+			{
+				msg = oldMsg->m_msg;
+			}
+			else
+			{
+				msg = MakeMessage(*msg);
+				msg->m_type = MessageType::CANT_VIEW_MSG_HISTORY;
+				msg->m_message = "";
+				msg->m_author = "#" + pChannel->m_name;
+			}
+		}
+
 		if (GetProfileCache()->NeedRequestGuildMember(msg->m_author_snowflake, m_guildID))
 			usersToLoad.insert(msg->m_author_snowflake);
 
@@ -1022,6 +1028,9 @@ void MessageList::RefetchMessages(Snowflake gapCulprit, bool causedByLoad)
 		if (!oldMsg) {
 			bNeedInsertNew = true;
 		}
+		else if (haveChanges) {
+			bNeedInsertNew = oldMsg->m_msg != msg || changedMessages.count(msg->m_snowflake) != 0;
+		}
 		else if (oldMsg->m_msg->m_message != msg->m_message ||
 			oldMsg->m_msg->m_dateTime != msg->m_dateTime) {
 			bNeedInsertNew = true;
@@ -1166,8 +1175,10 @@ void MessageList::RefetchMessages(Snowflake gapCulprit, bool causedByLoad)
 		InvalidateRect(m_hwnd, haveUpdateRect ? &updateRect : NULL, eraseWhenUpdating);
 	}
 
-	// send request to discord if needed
-	GetDiscordInstance()->RequestGuildMembers(m_guildID, usersToLoad);
+	// send request to discord if needed.  The scheduler batches the members
+	// with the others on screen
+	for (Snowflake user : usersToLoad)
+		GetProfileCache()->RequestProfile(user, m_guildID, DEMAND_VISIBLE);
 }
 
 // Thanks Raymond!
@@ -1379,7 +1390,7 @@ void MessageList::HitTestInteractables(POINT pt, BOOL& hit)
 void MessageList::OpenAttachment(AttachmentItem* pItem)
 {
 	std::string fileName, url;
-	Attachment* pAttach = pItem->m_pAttachment;
+	const Attachment* pAttach = pItem->m_pAttachment;
 	fileName = pAttach->m_fileName;
 	url = pAttach->m_actualUrl;
 
@@ -1482,7 +1493,7 @@ void MessageList::OpenInteractable(InteractableItem* pItem, MessageItem* pMsg)
 
 void MessageList::DrawImageAttachment(HDC hdc, RECT& paintRect, AttachmentItem& attachItem, RECT& attachRect)
 {
-	Attachment* pAttach = attachItem.m_pAttachment;
+	const Attachment* pAttach = attachItem.m_pAttachment;
 	std::string url = pAttach->m_proxyUrl;
 
 	RECT childAttachRect = attachRect;
@@ -1690,7 +1701,7 @@ void MessageList::DetermineMessageData(
 	Snowflake refMsgGuildID,          /* IN */
 	Snowflake refMsgChannelID,        /* IN */
 	Snowflake refMsgMessageID,        /* IN */
-	const std::set<Snowflake>& ments, /* IN */
+	const SmallSnowflakeSet& ments, /* IN */
 	const std::string& content,	      /* IN */
 	LPCTSTR& messagePart1,		      /* OUT */
 	LPCTSTR& messagePart2,		      /* OUT */
@@ -2101,7 +2112,7 @@ int MessageList::DrawMessageReply(HDC hdc, MessageItem& item, RECT& rc)
 	LPTSTR  strFreed = NULL;
 	std::string link = "";
 	Snowflake mention = 0;
-	std::set<Snowflake> emptyMentions;
+	SmallSnowflakeSet emptyMentions;
 	int icon = 0;
 
 	if (isActionMessage)
@@ -2913,7 +2924,7 @@ void MessageList::DrawMessage(HDC hdc, MessageItem& item, RECT& msgRect, RECT& c
 
 	// draw available attachments, if any:
 	RECT attachRect = pollRect;
-	auto& attachVec = item.m_msg->m_attachments;
+	auto& attachVec = item.m_msg->GetAttachments();
 	auto& attachItemVec = item.m_attachmentData;
 	sz = attachVec.size();
 
@@ -3250,6 +3261,9 @@ void MessageList::Paint(HDC hdc, RECT& paintRect)
 		SelectObject(hdc, gdiObj);
 	}
 
+	if (!m_bManagedByOwner)
+		GetMessageCache()->SetViewedMessage(m_channelID, m_firstShownMessage);
+
 	Channel* pChan = GetDiscordInstance()->GetChannel(m_channelID);
 
 	if (pChan &&
@@ -4631,7 +4645,7 @@ void MessageList::AdjustHeightInfo(
 
 	// also figure out attachment size
 	attachheight = 0;
-	for (auto& att : msg.m_msg->m_attachments)
+	for (auto& att : msg.m_msg->GetAttachments())
 	{
 		// XXX improve?
 		int inc = 0;
@@ -4716,7 +4730,7 @@ void MessageList::EditLastMessage()
 	SendMessage(g_Hwnd, WM_STARTEDITING, 0, (LPARAM) &sf);
 }
 
-bool MessageList::ShouldStartNewChain(Snowflake prevAuthor, time_t prevTime, int prevPlaceInChain, MessageType::eType prevType, const std::string& prevAuthorName, const std::string& prevAuthorAvatar, const MessageItem& item, bool ifChainTooLongToo)
+bool MessageList::ShouldStartNewChain(Snowflake prevAuthor, time_t prevTime, int prevPlaceInChain, MessageType::eType prevType, const InternedString& prevAuthorName, const InternedString& prevAuthorAvatar, const MessageItem& item, bool ifChainTooLongToo)
 {
 	if (m_bManagedByOwner)
 		return true;
@@ -4771,7 +4785,7 @@ int MessageList::RecalcMessageSizes(bool update, int& repaintSize, Snowflake add
 	time_t prevTime = 0;
 	Snowflake prevAuthor = Snowflake(-1);
 	MessageType::eType prevType = MessageType::DEFAULT;
-	std::string prevAuthorName = "", prevAuthorAvatar = "";
+	InternedString prevAuthorName, prevAuthorAvatar;
 	int prevPlaceInChain = 0;
 	int subScroll = 0;
 
@@ -5238,7 +5252,7 @@ void MessageList::AddMessageInternal(MessagePtr msg, bool toStart, bool updateLa
 	time_t prevDate = 0;
 	int prevPlaceInChain = -1;
 	MessageType::eType prevType = MessageType::DEFAULT;
-	std::string prevAuthorName = "", prevAuthorAvatar = "";
+	InternedString prevAuthorName, prevAuthorAvatar;
 	if (!m_messages.empty())
 	{
 		MessageItem* item = nullptr;
@@ -74,7 +74,7 @@ public:
 	}
 
 public:
-	Attachment* m_pAttachment = nullptr;
+	const Attachment* m_pAttachment = nullptr;
 	LPTSTR m_nameText = nullptr;
 	LPTSTR m_sizeText = nullptr;
 	std::string m_resourceID = "";
@@ -100,7 +100,7 @@ class MessageList;
 class RichEmbedItem
 {
 public:
-	RichEmbed* m_pEmbed = nullptr;
+	const RichEmbed* m_pEmbed = nullptr;
 	// Rects are laid out by Draw().
 	RECT m_rect{};
 	RECT m_imageRect{};
@@ -152,7 +152,7 @@ public:
 
 public:
 	MessagePollData() {}
-	MessagePollData(std::shared_ptr<MessagePoll>& mp) {
+	MessagePollData(const std::shared_ptr<MessagePoll>& mp) {
 		m_pMessagePoll = mp;
 	}
 	MessagePollData(const MessagePollData& oth) {
@@ -259,13 +259,13 @@ public:
 
 		// Update pointers to the attachment data
 		for (size_t i = 0; i < m_attachmentData.size(); i++) {
-			ptrdiff_t offs = m_attachmentData[i].m_pAttachment - other.m_msg->m_attachments.data();
-			m_attachmentData[i].m_pAttachment = (m_msg->m_attachments.data() + offs);
+			ptrdiff_t offs = m_attachmentData[i].m_pAttachment - other.m_msg->GetAttachments().data();
+			m_attachmentData[i].m_pAttachment = (m_msg->GetAttachments().data() + offs);
 		}
 		// Update pointers to the embed data
 		for (size_t i = 0; i < m_embedData.size(); i++) {
-			ptrdiff_t offs = m_embedData[i].m_pEmbed - other.m_msg->m_embeds.data();
-			m_embedData[i].m_pEmbed = (m_msg->m_embeds.data() + offs);
+			ptrdiff_t offs = m_embedData[i].m_pEmbed - other.m_msg->GetEmbeds().data();
+			m_embedData[i].m_pEmbed = (m_msg->GetEmbeds().data() + offs);
 		}
 	}
 	MessageItem(MessageItem&& other) noexcept { // move
@@ -309,13 +309,13 @@ public:
 
 		// Update pointers to the attachment data
 		for (size_t i = 0; i < m_attachmentData.size(); i++) {
-			ptrdiff_t offs = m_attachmentData[i].m_pAttachment - other.m_msg->m_attachments.data();
-			m_attachmentData[i].m_pAttachment = (m_msg->m_attachments.data() + offs);
+			ptrdiff_t offs = m_attachmentData[i].m_pAttachment - other.m_msg->GetAttachments().data();
+			m_attachmentData[i].m_pAttachment = (m_msg->GetAttachments().data() + offs);
 		}
 		// Update pointers to the embed data
 		for (size_t i = 0; i < m_embedData.size(); i++) {
-			ptrdiff_t offs = m_embedData[i].m_pEmbed - other.m_msg->m_embeds.data();
-			m_embedData[i].m_pEmbed = (m_msg->m_embeds.data() + offs);
+			ptrdiff_t offs = m_embedData[i].m_pEmbed - other.m_msg->GetEmbeds().data();
+			m_embedData[i].m_pEmbed = (m_msg->GetEmbeds().data() + offs);
 		}
 	}
 	void ClearAttachmentDataRects() {
@@ -367,6 +367,9 @@ private:
 	Snowflake m_guildID   = 0;
 	Snowflake m_channelID = 0;
 
+	// Version of the message cache's list the last refetch was based on.
+	uint64_t m_cacheVersion = 0;
+
 	std::list<MessageItem> m_messages;
 
 	Snowflake m_rightClickedMessage = 0;
@@ -485,6 +488,7 @@ public:
 
 	void SetChannel(Snowflake sf) {
 		m_channelID = sf;
+		m_cacheVersion = 0;
 		m_bAcknowledgeNow = true;
 	}
 
@@ -527,7 +531,7 @@ public:
 	void EditLastMessage();
 
 	// TODO: Wouldn't it be more sane to have a pointer to the last message item, or something?
-	bool ShouldStartNewChain(Snowflake prevAuthor, time_t prevTime, int prevPlaceInChain, MessageType::eType prevType, const std::string& prevAuthorName, const std::string& prevAuthorAvatar, const MessageItem& item, bool ifChainTooLongToo);
+	bool ShouldStartNewChain(Snowflake prevAuthor, time_t prevTime, int prevPlaceInChain, MessageType::eType prevType, const InternedString& prevAuthorName, const InternedString& prevAuthorAvatar, const MessageItem& item, bool ifChainTooLongToo);
 
 public:
 	static WNDCLASS g_MsgListClass;
@@ -594,7 +598,7 @@ private:
 		Snowflake refMsgGuildID,          /* IN */
 		Snowflake refMsgChannelID,        /* IN */
 		Snowflake refMsgMessageID,        /* IN */
-		const std::set<Snowflake>& ments, /* IN */
+		const SmallSnowflakeSet& ments, /* IN */
 		const std::string& content,	      /* IN */
 		LPCTSTR& messagePart1,		      /* OUT */
 		LPCTSTR& messagePart2,		      /* OUT */
@@ -1,7 +1,10 @@
+#include <algorithm>
+#include <climits>
 #include "NetworkerThread.hpp"
 #include "WinUtils.hpp"
 #include "WindowMessages.hpp"
 #include "network/DiscordRequest.hpp"
+#include "network/HTTPCache.hpp"
 #include "config/LocalSettings.hpp"
 #include "Frontend.hpp"
 #include "config/DiscordClientConfig.hpp"
@@ -82,7 +85,35 @@ int NetRequest::Priority() const
 	return prio;
 }
 
-bool NetworkerThread::ProcessResult(NetRequest& req, const httplib::Result& res)
+// Heap order of queued requests: highest priority first, then oldest first.
+struct NetRequestOrder
+{
+	bool operator()(const NetRequest* a, const NetRequest* b) const
+	{
+		if (a->m_priority != b->m_priority)
+			return a->m_priority < b->m_priority;
+
+		return a->m_sequence > b->m_sequence;
+	}
+};
+
+// Keeps track of the TLS handshake of new connections, see GetConnection.
+static void SSLInfoCallback(const SSL* ssl, int where, int ret)
+{
+	NetworkerThread* pThread = (NetworkerThread*) SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+	if (!pThread)
+		return;
+
+	NetworkerThread::RequestTiming& timing = pThread->GetTiming();
+
+	if ((where & SSL_CB_HANDSHAKE_START) && !timing.m_handshakeStart)
+		timing.m_handshakeStart = GetTimeMs();
+
+	if ((where & SSL_CB_HANDSHAKE_DONE) && !timing.m_handshakeDone)
+		timing.m_handshakeDone = GetTimeMs();
+}
+
+bool NetworkerThread::ProcessResult(NetRequest& req, httplib::Result& res, NetworkSample& sample)
 {
 	using namespace httplib;
 
@@ -115,7 +146,7 @@ bool NetworkerThread::ProcessResult(NetRequest& req, const httplib::Result& res)
 		else if (isSSLError && (result == IDCONTINUE || result == IDIGNORE))
 		{
 			GetLocalSettings()->SetEnableTLSVerification(false);
-			PrepareQuit();
+			GetHTTPClient()->PrepareQuit();
 
 			g_bQuittingFromSSLError = true;
 			SendMessage(g_Hwnd, WM_FORCERESTART, 0, 0);
@@ -137,9 +168,16 @@ bool NetworkerThread::ProcessResult(NetRequest& req, const httplib::Result& res)
 	else
 	{
 		req.result = res->status;
-		req.response = res->body;
+		req.response = std::move(res->body);
+		sample.m_bytesIn = req.response.size();
 	}
 
+	// The handler may take the request's contents, so record them first.
+	RecordStats(req, sample);
+
+	if (!m_cacheKey.empty() && res)
+		UpdateCache(req, res);
+
 	// Call the handler function.
 	// N.B.  Don't return unless you're absolutely done with the request!
 	req.pFunc(&req);
@@ -154,11 +192,6 @@ std::string NetworkerThreadManager::ErrorMessage(int code) const
 	return std::string(httplib::detail::status_message(code));
 }
 
-void NetworkerThread::IdleWait()
-{
-	Sleep(100);
-}
-
 // Custom Content Provider to track progress
 class ProgressContentProvider {
 public:
@@ -208,16 +241,7 @@ void NetworkerThread::FulfillRequest(NetRequest& req)
 	}
 
 	using namespace httplib;
-	Client client(hostName);
-
-	// on Windows XP, enabling this doesn't actually work for some reason.
-	// Probably outdated certs. I mean, this would allow attackers to host
-	// a self-instance of Discord to intercept packets, but this is fine
-	// for now.....
-	client.enable_server_certificate_verification(GetLocalSettings()->EnableTLSVerification());
-
-	// Follow redirects.  Used by GitHub auto-update service
-	client.set_follow_location(true);
+	Client& client = GetConnection(hostName);
 
 	Headers headers;
 	headers.insert(std::make_pair("User-Agent", GetClientConfig()->GetUserAgent()));
@@ -241,40 +265,74 @@ void NetworkerThread::FulfillRequest(NetRequest& req)
 		headers.insert(std::make_pair("Authorization", req.authorization));
 	}
 
+	m_cacheKey.clear();
+	if (HTTPCache::IsCacheable(req))
+	{
+		m_cacheKey = HTTPCache::MakeKey(req);
+
+		// If a recent enough response is around, don't bother the server at all.
+		if (GetHTTPCache()->GetFresh(m_cacheKey, req.response))
+		{
+			DbgPrintF("Serving %s from the HTTP cache", url.c_str());
+			req.result = HTTP_OK;
+			req.pFunc(&req);
+			return;
+		}
+
+		std::string etag, lastModified;
+		if (GetHTTPCache()->GetValidators(m_cacheKey, etag, lastModified))
+		{
+			if (!etag.empty())
+				headers.insert(std::make_pair("If-None-Match", etag));
+			if (!lastModified.empty())
+				headers.insert(std::make_pair("If-Modified-Since", lastModified));
+		}
+	}
+
+	NetworkSample sample;
+	sample.m_itype = req.itype;
+	sample.m_host = hostName;
+	sample.m_bytesOut = req.params.size() + req.params_bytes.size();
+	if (req.m_enqueueTime)
+		sample.m_queueWaitMs = int64_t(GetTimeMs() - req.m_enqueueTime);
+
 	bool retry = false;
 	do
 	{
+		m_timing = RequestTiming();
+		m_timing.m_start = GetTimeMs();
+
 		switch (req.type)
 		{
 			// no default constructor for httplib::Result?? this SUCKS!
 			case NetRequest::POST:
 			{
-				const Result res = client.Post(path, headers, req.params, "application/x-www-form-urlencoded");
-				retry = ProcessResult(req, res);
+				Result res = client.Post(path, headers, req.params, "application/x-www-form-urlencoded");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::POST_JSON:
 			{
-				const Result res = client.Post(path, headers, req.params, "application/json");
-				retry = ProcessResult(req, res);
+				Result res = client.Post(path, headers, req.params, "application/json");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::PUT:
 			{
-				const Result res = client.Put(path, headers, req.params, "application/x-www-form-urlencoded");
-				retry = ProcessResult(req, res);
+				Result res = client.Put(path, headers, req.params, "application/x-www-form-urlencoded");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::PUT_JSON:
 			{
-				const Result res = client.Put(path, headers, req.params, "application/json");
-				retry = ProcessResult(req, res);
+				Result res = client.Put(path, headers, req.params, "application/json");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::PUT_OCTETS:
 			{
-				const Result res = client.Put(path, headers, (const char*) req.params_bytes.data(), req.params_bytes.size(), "application/octet-stream");
-				retry = ProcessResult(req, res);
+				Result res = client.Put(path, headers, (const char*) req.params_bytes.data(), req.params_bytes.size(), "application/octet-stream");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::PUT_OCTETS_PROGRESS:
@@ -282,117 +340,195 @@ void NetworkerThread::FulfillRequest(NetRequest& req)
 				using namespace std::placeholders;
 				ProgressContentProvider provider(req.params_bytes.data(), req.params_bytes.size(), std::bind(&NetworkerThread::ProgressFunction, this, &req, _1, _2));
 				req.result = HTTP_PROGRESS;
-				const Result res = client.Put(path, headers, provider, "application/octet-stream");
-				retry = ProcessResult(req, res);
+				Result res = client.Put(path, headers, provider, "application/octet-stream");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::GET:
 			{
-				const Result res = client.Get(path, headers);
-				retry = ProcessResult(req, res);
+				Result res = client.Get(path, headers, Progress([this](uint64_t, uint64_t) {
+					if (!m_timing.m_firstByte)
+						m_timing.m_firstByte = GetTimeMs();
+					return true;
+				}));
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::GET_PROGRESS:
 			{
 				using namespace std::placeholders;
-				const Result res = client.Get(path, headers, std::bind(&NetworkerThread::ProgressFunction, this, &req, _1, _2));
-				retry = ProcessResult(req, res);
+				Result res = client.Get(path, headers, std::bind(&NetworkerThread::ProgressFunction, this, &req, _1, _2));
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::PATCH:
 			{
-				const Result res = client.Patch(path, headers, req.params, "application/json");
-				retry = ProcessResult(req, res);
+				Result res = client.Patch(path, headers, req.params, "application/json");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			case NetRequest::DELETE_:
 			{
-				const Result res = client.Delete(path, headers, req.params, "application/json");
-				retry = ProcessResult(req, res);
+				Result res = client.Delete(path, headers, req.params, "application/json");
+				retry = ProcessResult(req, res, sample);
 				break;
 			}
 			default:
 				assert(!"Don't know how to handle that type of request!");
 				break;
 		}
+
+		if (retry)
+			sample.m_retries++;
 	}
 	while (retry);
 }
 
-void NetworkerThread::Run()
+void NetworkerThread::UpdateCache(NetRequest& req, httplib::Result& res)
 {
-	while (true)
+	if (req.result == HTTP_NOTMODIFIED)
 	{
-		// lock the mutex
-		m_requestLock.lock();
-		if (m_requests.empty())
-		{
-			m_requestLock.unlock();
-			IdleWait();
-			continue;
-		}
+		// Serve the cached response as if the server sent it again.
+		if (GetHTTPCache()->GetRevalidated(m_cacheKey, req.response))
+			req.result = HTTP_OK;
+	}
+	else if (req.result == HTTP_OK)
+	{
+		GetHTTPCache()->Store(
+			m_cacheKey,
+			req.response,
+			res->get_header_value("ETag"),
+			res->get_header_value("Last-Modified")
+		);
+	}
+}
 
-		DbgPrintW("Thread %u processing request", m_ThreadID);
-		NetRequest request = std::move(m_requests.top());
-		m_requests.pop();
-		m_requestLock.unlock();
+void NetworkerThread::RecordStats(NetRequest& req, NetworkSample& sample)
+{
+	uint64_t now = GetTimeMs();
 
-		// Service the request.
-		if (request.type == NetRequest::QUIT)
-			break;
+	sample.m_status = req.result;
+	sample.m_totalMs = int64_t(now - m_timing.m_start);
 
-		FulfillRequest(request);
+	if (m_timing.m_socketCreated)
+	{
+		// A new connection was opened.  Name resolution and the TCP connect are
+		// over by the time the TLS handshake starts.
+		uint64_t connected = m_timing.m_handshakeStart ? m_timing.m_handshakeStart : m_timing.m_socketCreated;
+
+		sample.m_bNewConnection = true;
+		sample.m_connectMs = int64_t(connected - m_timing.m_start);
+
+		if (m_timing.m_handshakeStart && m_timing.m_handshakeDone)
+			sample.m_tlsMs = int64_t(m_timing.m_handshakeDone - m_timing.m_handshakeStart);
 	}
 
-	m_ThreadHandle = NULL;
-	m_ThreadID = 0;
-}
+	if (m_timing.m_firstByte)
+		sample.m_ttfbMs = int64_t(m_timing.m_firstByte - m_timing.m_start);
 
-DWORD WINAPI NetworkerThread::Init(LPVOID that)
-{
-	NetworkerThread* pThrd = (NetworkerThread*)that;
-	pThrd->Run();
-	return 0;
+	GetNetworkStats()->Record(sample);
+	GetNetworkStats()->DumpPeriodically();
 }
 
-void NetworkerThread::AddRequest(
-	NetRequest::eType type,
-	const std::string& url,
-	int itype,
-	uint64_t requestKey,
-	std::string params,
-	std::string authorization,
-	std::string additional_data,
-	NetRequest::NetworkResponseFunc pRespFunc,
-	uint8_t* stream_bytes,
-	size_t stream_size)
+httplib::Client& NetworkerThread::GetConnection(const std::string& hostName)
 {
-	NetRequest rq(0, itype, requestKey, type, url, "", params, authorization, additional_data, pRespFunc, stream_bytes, stream_size);
+	CachedConnection& conn = m_connections[hostName];
+	conn.m_lastUsed = GetTimeMs();
 
-	m_requestLock.lock();
-	m_requests.push(rq);
-	m_requestLock.unlock();
+	if (!conn.m_pClient)
+	{
+		// Make room for the new connection by closing the least recently used one.
+		if (m_connections.size() > C_MAX_CACHED_CONNECTIONS)
+		{
+			auto oldest = m_connections.end();
+			for (auto iter = m_connections.begin(); iter != m_connections.end(); ++iter)
+			{
+				if (iter->first == hostName)
+					continue;
+
+				if (oldest == m_connections.end() || oldest->second.m_lastUsed > iter->second.m_lastUsed)
+					oldest = iter;
+			}
+
+			if (oldest != m_connections.end())
+				m_connections.erase(oldest);
+		}
+
+		DbgPrintF("Opening new connection to %s", hostName.c_str());
+		conn.m_pClient.reset(new httplib::Client(hostName));
+
+		// Keep the connection open after the request, so that later requests to
+		// the same host can skip the TCP and TLS handshakes.  If the server closes
+		// it in the meantime, httplib reconnects transparently.
+		conn.m_pClient->set_keep_alive(true);
+
+		// Follow redirects.  Used by GitHub auto-update service
+		conn.m_pClient->set_follow_location(true);
+
+		// Keep track of how long it takes to set up new connections.
+		conn.m_pClient->set_socket_options([this](socket_t) {
+			if (!m_timing.m_socketCreated)
+				m_timing.m_socketCreated = GetTimeMs();
+		});
+
+		SSL_CTX* ctx = conn.m_pClient->ssl_context();
+		if (ctx)
+		{
+			SSL_CTX_set_app_data(ctx, this);
+			SSL_CTX_set_info_callback(ctx, &SSLInfoCallback);
+		}
+	}
+
+	// on Windows XP, enabling this doesn't actually work for some reason.
+	// Probably outdated certs. I mean, this would allow attackers to host
+	// a self-instance of Discord to intercept packets, but this is fine
+	// for now.....
+	conn.m_pClient->enable_server_certificate_verification(GetLocalSettings()->EnableTLSVerification());
+
+	return *conn.m_pClient;
 }
 
-void NetworkerThread::StopAllRequests()
+void NetworkerThread::DropIdleConnections()
 {
-	m_requestLock.lock();
-	while (!m_requests.empty())
-		m_requests.pop();
-	m_requestLock.unlock();
+	uint64_t now = GetTimeMs();
+
+	for (auto iter = m_connections.begin(); iter != m_connections.end(); )
+	{
+		if (iter->second.m_lastUsed + C_CONNECTION_IDLE_TIMEOUT_MS < now)
+			iter = m_connections.erase(iter);
+		else
+			++iter;
+	}
 }
 
-void NetworkerThread::PrepareQuit()
+void NetworkerThread::Run()
 {
-	m_requestLock.lock();
+	NetRequest* pRequest = nullptr;
+
+	while (m_pPool->TakeRequest(this, pRequest))
+	{
+		DbgPrintW("Thread %u processing request", m_ThreadID);
 
-	while (!m_requests.empty())
-		m_requests.pop();
+		// Service the request.
+		if (pRequest->type == NetRequest::QUIT) {
+			NetRequest::Release(pRequest);
+			break;
+		}
 
-	for (int i = 0; i < C_AMT_NETWORKER_THREADS; i++)
-		m_requests.push(NetRequest(0, 0, 0, NetRequest::QUIT));
+		FulfillRequest(*pRequest);
+		NetRequest::Release(pRequest);
+		DropIdleConnections();
+	}
 
-	m_requestLock.unlock();
+	// Close the connections from the thread that used them.
+	m_connections.clear();
+}
+
+DWORD WINAPI NetworkerThread::Init(LPVOID that)
+{
+	NetworkerThread* pThrd = (NetworkerThread*)that;
+	pThrd->Run();
+	return 0;
 }
 
 bool NetworkerThread::ProgressFunction(NetRequest* pRequest, uint64_t offset, uint64_t length)
@@ -400,6 +536,9 @@ bool NetworkerThread::ProgressFunction(NetRequest* pRequest, uint64_t offset, ui
 	if (pRequest->type == NetRequest::PUT_OCTETS_PROGRESS)
 		assert(length == pRequest->params_bytes.size());
 
+	if (pRequest->type == NetRequest::GET_PROGRESS && !m_timing.m_firstByte)
+		m_timing.m_firstByte = GetTimeMs();
+
 	pRequest->m_bCancelOp = false;
 	pRequest->m_offset = offset;
 	pRequest->m_length = length;
@@ -410,7 +549,7 @@ bool NetworkerThread::ProgressFunction(NetRequest* pRequest, uint64_t offset, ui
 	return !pRequest->m_bCancelOp;
 }
 
-NetworkerThread::NetworkerThread()
+NetworkerThread::NetworkerThread(NetworkerThreadPool* pPool) : m_pPool(pPool)
 {
 	m_ThreadHandle = CreateThread(
 		NULL,
@@ -434,69 +573,273 @@ NetworkerThread::NetworkerThread()
 
 NetworkerThread::~NetworkerThread()
 {
-	PrepareQuit();
-
 	// wait for the thread to go away
 	WaitForSingleObject(m_ThreadHandle, INFINITE);
+	CloseHandle(m_ThreadHandle);
 }
 
-NetworkerThreadManager::~NetworkerThreadManager()
+NetworkerThreadPool::NetworkerThreadPool()
+{
+}
+
+NetworkerThreadPool::~NetworkerThreadPool()
 {
-	assert(m_bKilled && "Ideally you wouldn't kill now");
 	Kill();
 }
 
-void NetworkerThreadManager::Init()
+void NetworkerThreadPool::Init(const char* name, int minThreads, int maxThreads, int idleTimeoutMs)
 {
-	m_bKilled = false;
-	for (int i = 0; i < C_AMT_NETWORKER_THREADS; i++)
-		m_pNetworkThreads[i] = new NetworkerThread();
+	m_name = name;
+	m_minThreads = std::max(minThreads, 1);
+	m_maxThreads = std::max(maxThreads, m_minThreads);
+	m_idleTimeoutMs = idleTimeoutMs;
+	m_idleThreads = 0;
+	m_avgQueueWaitMs = 0;
+	m_bQuitting = false;
+
+	if (!m_hSemaphore)
+		m_hSemaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+
+	// Reserve room for the queue up front, so that queueing requests doesn't
+	// normally need to allocate.
+	m_requests.reserve(C_MAX_POOLED_REQUESTS);
+
+	m_lock.lock();
+	for (int i = 0; i < m_minThreads; i++)
+		SpawnThread();
+	m_lock.unlock();
 }
 
-void NetworkerThreadManager::StopAllRequests()
+void NetworkerThreadPool::SpawnThread()
 {
-	for (int i = 0; i < C_AMT_NETWORKER_THREADS; i++) {
-		if (m_pNetworkThreads[i])
-			m_pNetworkThreads[i]->StopAllRequests();
-	}
+	// N.B. Called with m_lock held.  The new thread will block on it until
+	// the caller is done.
+	m_threads.push_back(new NetworkerThread(this));
+
+	DbgPrintF("Networker pool %s grew to %d threads (queue depth %d, avg wait %d ms)",
+		m_name, int(m_threads.size()), int(m_requests.size()), m_avgQueueWaitMs);
 }
 
-void NetworkerThreadManager::PrepareQuit()
+void NetworkerThreadPool::ReapDeadThreads()
 {
-	for (int i = 0; i < C_AMT_NETWORKER_THREADS; i++) {
-		if (m_pNetworkThreads[i])
-			m_pNetworkThreads[i]->PrepareQuit();
-	}
+	m_lock.lock();
+	std::vector<NetworkerThread*> deadThreads;
+	deadThreads.swap(m_deadThreads);
+	m_lock.unlock();
+
+	// These threads have already left their run loop, so this doesn't wait long.
+	for (auto pThread : deadThreads)
+		delete pThread;
 }
 
-void NetworkerThreadManager::Kill()
+void NetworkerThreadPool::ClearRequests()
 {
-	PrepareQuit();
+	// N.B. Called with m_lock held.
+	for (auto pRequest : m_requests)
+		NetRequest::Release(pRequest);
 
-	// Wait for all networker threads to quit
-	HANDLE threads[C_AMT_NETWORKER_THREADS];
-	int nthreads = 0;
+	m_requests.clear();
+}
+
+bool NetworkerThreadPool::TakeRequest(NetworkerThread* pThread, NetRequest*& pOut)
+{
+	uint64_t idleSince = GetTimeMs();
 
-	for (int i = 0; i < C_AMT_NETWORKER_THREADS; i++)
+	m_lock.lock();
+
+	while (m_requests.empty())
 	{
-		if (!m_pNetworkThreads[i])
+		m_idleThreads++;
+		m_lock.unlock();
+
+		// Wake up every so often to check the idle timeouts, of the thread and
+		// of its connections.
+		if (WaitForSingleObject(m_hSemaphore, 1000) == WAIT_TIMEOUT)
+			pThread->DropIdleConnections();
+
+		m_lock.lock();
+		m_idleThreads--;
+
+		if (!m_requests.empty() || m_bQuitting)
+			continue;
+
+		if (GetTimeMs() - idleSince < uint64_t(m_idleTimeoutMs) || int(m_threads.size()) <= m_minThreads)
 			continue;
 
-		HANDLE h = m_pNetworkThreads[i]->GetThreadHandle();
-		if (h)
-			threads[nthreads++] = h;
+		// This thread was idle for too long, retire it.
+		auto iter = std::find(m_threads.begin(), m_threads.end(), pThread);
+		if (iter != m_threads.end())
+			m_threads.erase(iter);
+
+		m_deadThreads.push_back(pThread);
+
+		DbgPrintF("Networker pool %s shrank to %d threads", m_name, int(m_threads.size()));
+		m_lock.unlock();
+		return false;
 	}
 
-	if (nthreads > 0)
-		WaitForMultipleObjects(nthreads, threads, true, INFINITE);
+	std::pop_heap(m_requests.begin(), m_requests.end(), NetRequestOrder());
+	pOut = m_requests.back();
+	m_requests.pop_back();
+
+	// Keep a running average of how long requests wait in the queue.
+	int waitMs = int(GetTimeMs() - pOut->m_enqueueTime);
+	m_avgQueueWaitMs = (m_avgQueueWaitMs * 7 + waitMs) / 8;
+
+	m_lock.unlock();
+	return true;
+}
+
+void NetworkerThreadPool::AddRequest(NetRequest* pRequest)
+{
+	ReapDeadThreads();
+
+	pRequest->m_priority = pRequest->Priority();
+
+	m_lock.lock();
+
+	if (m_bQuitting) {
+		m_lock.unlock();
+		NetRequest::Release(pRequest);
+		return;
+	}
+
+	pRequest->m_sequence = m_nextSequence++;
+	m_requests.push_back(pRequest);
+	std::push_heap(m_requests.begin(), m_requests.end(), NetRequestOrder());
+
+	// Grow if there are more queued requests than threads to pick them up, or
+	// if requests have been waiting in the queue for too long.
+	int queueDepth = int(m_requests.size());
+	bool backlogged = queueDepth > m_idleThreads;
+	bool slow = m_avgQueueWaitMs > C_NETWORKER_GROW_LATENCY_MS && m_idleThreads == 0;
 
-	for (int i = 0; i < C_AMT_NETWORKER_THREADS; i++)
+	if ((backlogged || slow) && int(m_threads.size()) < m_maxThreads)
+		SpawnThread();
+
+	m_lock.unlock();
+
+	ReleaseSemaphore(m_hSemaphore, 1, NULL);
+}
+
+void NetworkerThreadPool::StopAllRequests()
+{
+	m_lock.lock();
+	ClearRequests();
+	m_lock.unlock();
+}
+
+void NetworkerThreadPool::PrepareQuit()
+{
+	m_lock.lock();
+
+	ClearRequests();
+
+	m_bQuitting = true;
+
+	int threadCount = int(m_threads.size());
+	for (int i = 0; i < threadCount; i++)
 	{
-		if (m_pNetworkThreads[i])
-			delete m_pNetworkThreads[i];
+		NetRequest* pRequest = NetRequest::Acquire();
+		pRequest->type = NetRequest::QUIT;
+		pRequest->m_priority = pRequest->Priority();
+		pRequest->m_sequence = m_nextSequence++;
+		m_requests.push_back(pRequest);
+		std::push_heap(m_requests.begin(), m_requests.end(), NetRequestOrder());
+	}
+
+	m_lock.unlock();
 
-		m_pNetworkThreads[i] = NULL;
+	if (threadCount && m_hSemaphore)
+		ReleaseSemaphore(m_hSemaphore, threadCount, NULL);
+}
+
+void NetworkerThreadPool::Kill()
+{
+	PrepareQuit();
+
+	m_lock.lock();
+	std::vector<NetworkerThread*> threads;
+	threads.swap(m_threads);
+	m_lock.unlock();
+
+	// Wait for all networker threads to quit
+	for (auto pThread : threads)
+		delete pThread;
+
+	ReapDeadThreads();
+
+	m_lock.lock();
+	ClearRequests();
+	m_lock.unlock();
+
+	if (m_hSemaphore) {
+		CloseHandle(m_hSemaphore);
+		m_hSemaphore = NULL;
 	}
+}
+
+void NetworkerThreadPool::GetStats(HTTPClient::PoolStats& stats)
+{
+	m_lock.lock();
+	stats.m_threads = int(m_threads.size());
+	stats.m_idleThreads = m_idleThreads;
+	stats.m_maxThreads = m_maxThreads;
+	stats.m_queueDepth = int(m_requests.size());
+	stats.m_avgQueueWaitMs = m_avgQueueWaitMs;
+	m_lock.unlock();
+}
+
+NetworkerThreadManager::~NetworkerThreadManager()
+{
+	assert(m_bKilled && "Ideally you wouldn't kill now");
+	Kill();
+}
+
+void NetworkerThreadManager::Init()
+{
+	m_bKilled = false;
+
+	LocalSettings* pSettings = GetLocalSettings();
+	int idleTimeoutMs = pSettings->GetNetworkerIdleTimeout() * 1000;
+
+	m_interactivePool.Init(
+		"interactive",
+		C_MIN_INTERACTIVE_NETWORKER_THREADS,
+		pSettings->GetMaxInteractiveNetworkerThreads(),
+		idleTimeoutMs
+	);
+
+	m_backgroundPool.Init(
+		"background",
+		C_MIN_BACKGROUND_NETWORKER_THREADS,
+		pSettings->GetMaxBackgroundNetworkerThreads(),
+		idleTimeoutMs
+	);
+}
+
+void NetworkerThreadManager::StopAllRequests()
+{
+	m_interactivePool.StopAllRequests();
+	m_backgroundPool.StopAllRequests();
+}
+
+void NetworkerThreadManager::PrepareQuit()
+{
+	m_interactivePool.PrepareQuit();
+	m_backgroundPool.PrepareQuit();
+}
+
+void NetworkerThreadManager::Kill()
+{
+	if (!m_bKilled)
+		GetNetworkStats()->DumpToCache();
+
+	PrepareQuit();
+
+	// Wait for all networker threads to quit
+	m_interactivePool.Kill();
+	m_backgroundPool.Kill();
 
 	m_bKilled = true;
 }
@@ -514,15 +857,31 @@ void NetworkerThreadManager::PerformRequest(
 	uint8_t* stream_bytes,
 	size_t stream_size)
 {
-	int idx;
-	if (interactive) {
-		m_nextInteractiveId = (m_nextInteractiveId + 1) % C_INTERACTIVE_NETWORKER_THREADS;
-		idx = m_nextInteractiveId;
-	}
-	else {
-		m_nextBackgroundId = C_INTERACTIVE_NETWORKER_THREADS + (m_nextBackgroundId + 1) % (C_AMT_NETWORKER_THREADS - C_INTERACTIVE_NETWORKER_THREADS);
-		idx = m_nextBackgroundId;
-	}
+	NetRequest* pRequest = NetRequest::Acquire();
+	pRequest->Set(
+		itype,
+		requestKey,
+		type,
+		url,
+		std::move(params),
+		std::move(authorization),
+		std::move(additional_data),
+		pRespFunc,
+		stream_bytes,
+		stream_size
+	);
+	pRequest->m_enqueueTime = GetTimeMs();
+
+	if (interactive)
+		m_interactivePool.AddRequest(pRequest);
+	else
+		m_backgroundPool.AddRequest(pRequest);
+}
 
-	m_pNetworkThreads[idx]->AddRequest(type, url, itype, requestKey, params, authorization, additional_data, pRespFunc, stream_bytes, stream_size);
+void NetworkerThreadManager::GetPoolStats(bool interactive, PoolStats& stats)
+{
+	if (interactive)
+		m_interactivePool.GetStats(stats);
+	else
+		m_backgroundPool.GetStats(stats);
 }
@@ -10,7 +10,9 @@
 
 #endif
 
-#include <queue>
+#include <map>
+#include <vector>
+#include <memory>
 #include <cassert>
 
 #ifdef MINGW_SPECIFIC_HACKS
@@ -20,14 +22,32 @@
 #endif
 
 #include "network/HTTPClient.hpp"
+#include "network/NetworkStats.hpp"
 
 struct NetworkResponse
 {
 	int m_code; // 200 = OK, 404 = Not Found, 403 = Forbidden, 401 = Unauthorized
 };
 
-#define C_AMT_NETWORKER_THREADS (4)
-#define C_INTERACTIVE_NETWORKER_THREADS (2)
+// Minimum amount of threads each pool keeps alive, even when idle.
+#define C_MIN_INTERACTIVE_NETWORKER_THREADS (1)
+#define C_MIN_BACKGROUND_NETWORKER_THREADS (1)
+
+// If requests wait in the queue for longer than this on average, the pool
+// grows even if there are fewer requests than idle threads.
+#define C_NETWORKER_GROW_LATENCY_MS (250)
+
+// Maximum amount of hosts that a networker thread keeps a connection open to.
+#define C_MAX_CACHED_CONNECTIONS (4)
+
+// Time after which an unused kept-alive connection is closed, in milliseconds.
+#define C_CONNECTION_IDLE_TIMEOUT_MS (60000)
+
+namespace httplib {
+	class Client;
+}
+
+class NetworkerThreadPool;
 
 class NetworkerThread
 {
@@ -39,54 +59,125 @@ public:
 #endif
 
 private:
-	std::priority_queue<NetRequest> m_requests;
-	nmutex m_requestLock;
+	NetworkerThreadPool* m_pPool;
 
 	HANDLE m_ThreadHandle;
 	DWORD  m_ThreadID;
 
-	bool ProcessResult(NetRequest& req, const httplib::Result& res);
+	// Kept-alive connections, keyed by scheme and host name.  Only ever touched
+	// by the networker thread itself.
+	struct CachedConnection
+	{
+		std::unique_ptr<httplib::Client> m_pClient;
+		uint64_t m_lastUsed = 0;
+	};
+	std::map<std::string, CachedConnection> m_connections;
 
-	void IdleWait();
-	
-protected:
-	friend class NetworkerThreadManager;
+	httplib::Client& GetConnection(const std::string& hostName);
+
+	bool ProcessResult(NetRequest& req, httplib::Result& res, NetworkSample& sample);
+	void RecordStats(NetRequest& req, NetworkSample& sample);
+	void UpdateCache(NetRequest& req, httplib::Result& res);
+
+	// HTTP cache key of the request being serviced.  Empty if its response
+	// isn't cached.
+	std::string m_cacheKey;
 
-	HANDLE GetThreadHandle() const {
-		return m_ThreadHandle;
+public:
+	// Points in time during the current attempt at servicing a request.  Zero
+	// if they weren't reached.  Used for the network statistics.
+	struct RequestTiming
+	{
+		uint64_t m_start = 0;
+		uint64_t m_socketCreated = 0;
+		uint64_t m_handshakeStart = 0;
+		uint64_t m_handshakeDone = 0;
+		uint64_t m_firstByte = 0;
+	};
+
+	RequestTiming& GetTiming() {
+		return m_timing;
 	}
 
+private:
+	RequestTiming m_timing;
+
 public:
 	static DWORD WINAPI Init(LPVOID that);
 
 	void FulfillRequest(NetRequest& request);
 	void Run();
 
-	NetworkerThread();
+	// Closes the kept-alive connections that weren't used for a while.  Only
+	// called by the networker thread itself.
+	void DropIdleConnections();
+
+	DWORD GetThreadID() const {
+		return m_ThreadID;
+	}
+
+	NetworkerThread(NetworkerThreadPool* pPool);
+
+	// Waits for the thread to exit.  Make sure it was told to quit first.
 	~NetworkerThread();
 
-	// Safely adds a request to the network worker thread's queue.
-	// * The requestKey is an identifier for what type of request was made. It can be a pointer, enum etc.
-	// * Note: The response function will be run within the context of the networker thread, so
-	//   that's where you send messages back to the main thread.
-	// * Note: The stream_bytes array is owned by the HTTP client after being passed in.
-	void AddRequest(
-		NetRequest::eType type,
-		const std::string& url,
-		int itype,
-		uint64_t requestKey,
-		std::string params = "",
-		std::string authorization = "",
-		std::string additional_data = "",
-		NetRequest::NetworkResponseFunc pRespFunc = nullptr,
-		uint8_t* stream_bytes = nullptr,
-		size_t stream_size = 0
-	);
+	bool ProgressFunction(NetRequest* pRequest, uint64_t offset, uint64_t length);
+};
+
+// A set of networker threads sharing a single request queue.  The amount of
+// threads grows while requests pile up, and shrinks again when threads stay
+// idle for long enough.
+class NetworkerThreadPool
+{
+public:
+	using nmutex = NetworkerThread::nmutex;
 
+	NetworkerThreadPool();
+	~NetworkerThreadPool();
+
+	void Init(const char* name, int minThreads, int maxThreads, int idleTimeoutMs);
+	void Kill();
 	void StopAllRequests();
 	void PrepareQuit();
 
-	bool ProgressFunction(NetRequest* pRequest, uint64_t offset, uint64_t length);
+	// Safely adds a request to the queue, spawning another thread if needed.
+	// The pool takes ownership of the request, which must come from
+	// NetRequest::Acquire().
+	void AddRequest(NetRequest* pRequest);
+
+	void GetStats(HTTPClient::PoolStats& stats);
+
+protected:
+	friend class NetworkerThread;
+
+	// Called by the networker threads.  Blocks until there is a request to
+	// service.  Returns false if the calling thread should exit instead.
+	// The caller hands the request back via NetRequest::Release().
+	bool TakeRequest(NetworkerThread* pThread, NetRequest*& pOut);
+
+private:
+	void SpawnThread();
+	void ReapDeadThreads();
+	void ClearRequests();
+
+	// Binary heap of pending requests, see NetRequestOrder.
+	std::vector<NetRequest*> m_requests;
+	uint64_t m_nextSequence = 0;
+	nmutex m_lock;
+
+	// Signalled once for every request added to the queue.
+	HANDLE m_hSemaphore = NULL;
+
+	std::vector<NetworkerThread*> m_threads;
+	std::vector<NetworkerThread*> m_deadThreads;
+
+	const char* m_name = "";
+	int m_minThreads = 1;
+	int m_maxThreads = 1;
+	int m_idleTimeoutMs = 0;
+	int m_idleThreads = 0;
+	int m_avgQueueWaitMs = 0;
+	bool m_bQuitting = false;
 };
 
 class NetworkerThreadManager : public HTTPClient
@@ -115,13 +206,14 @@ public:
 		size_t stream_size = 0
 	) override;
 
+	void GetPoolStats(bool interactive, PoolStats& stats) override;
+
 	std::string ErrorMessage(int errorCode) const;
 
 private:
-	NetworkerThread* m_pNetworkThreads[C_AMT_NETWORKER_THREADS] = { nullptr };
+	NetworkerThreadPool m_interactivePool;
+	NetworkerThreadPool m_backgroundPool;
 
-	int m_nextInteractiveId = 0;
-	int m_nextBackgroundId  = 0;
 	bool m_bKilled = true;
 };
 
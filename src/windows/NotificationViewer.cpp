@@ -72,8 +72,8 @@ void NotificationViewer::Initialize(HWND hWnd)
 	{
 		MessagePtr msg = MakeMessage();
 		msg->m_type      = MessageType::DEFAULT;
-		msg->m_avatar    = notif.m_avatarLnk;
-		msg->m_message   = notif.m_contents;
+		msg->m_avatar    = notif.m_pMessage->m_avatar;
+		msg->m_message   = notif.m_pMessage->m_message;
 		msg->m_snowflake = notif.m_sourceMessage;
 		msg->m_anchor    = notif.m_sourceChannel;
 		msg->m_bRead     = notif.m_bRead;
@@ -97,7 +97,7 @@ void NotificationViewer::Initialize(HWND hWnd)
 
 		std::string details = "";
 
-		msg->m_author = notif.m_author;
+		msg->m_author = notif.m_pMessage->m_author;
 		
 		details = notif.m_bIsReply ? "replied " : "";
 		if (!channelName.empty()) {
@@ -3,6 +3,7 @@
 #include "ShellNotification.hpp"
 #include "Main.hpp"
 #include "config/LocalSettings.hpp"
+#include "utils/TimeFormatCache.hpp"
 
 #ifdef NEW_WINDOWS
 #include <uxtheme.h>
@@ -519,6 +520,7 @@ INT_PTR OptionsHandleCommand(HWND hwndParent, HWND hWnd, int pageNum, UINT uMsg,
 					break;
 				case IDC_USE_12HR_TIME:
 					GetLocalSettings()->SetUse12HourTime(IsDlgButtonChecked(hWnd, IDC_USE_12HR_TIME));
+					GetTimeFormatCache()->Clear();
 					SendMessage(g_Hwnd, WM_RECALCMSGLIST, 0, 0);
 					break;
 				case IDC_SHOW_BLOCKED_MESSAGES:
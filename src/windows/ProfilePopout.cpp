@@ -35,14 +35,14 @@ Snowflake ProfilePopout::GetUser()
 
 bool ProfilePopout::Layout(HWND hWnd, SIZE& fullSize)
 {
-	Profile* pProf = GetProfileCache()->LookupProfile(m_user, "...", "...", "");
+	Profile* pProf = GetProfileCache()->LookupProfile(m_user, "...", "...", "", false);
 	if (!pProf) {
 		EndDialog(hWnd, 0);
 		return TRUE;
 	}
 
 	if (!pProf->m_bExtraDataFetched) {
-		GetProfileCache()->RequestExtraData(m_user, m_guild);
+		GetProfileCache()->RequestProfile(m_user, m_guild, DEMAND_POPOUT);
 		pProf->m_bExtraDataFetched = true;
 	}
 
@@ -58,9 +58,7 @@ bool ProfilePopout::Layout(HWND hWnd, SIZE& fullSize)
 	std::string pfx = NT31SimplifiedInterface() ? "DC: " : "";
 
 	Guild* gld = GetDiscordInstance()->GetGuild(m_guild);
-	GuildMember* gm = nullptr;
-	if (pProf->HasGuildMemberProfile(m_guild))
-		gm = &pProf->m_guildMembers[m_guild];
+	GuildMember gm = pProf->GetGuildMember(m_guild);
 
 	// Gather data about the user profile.
 	LPTSTR name        = ConvertCppStringToTString(pProf->GetName(m_guild));
@@ -70,7 +68,7 @@ bool ProfilePopout::Layout(HWND hWnd, SIZE& fullSize)
 	LPTSTR bio         = ConvertToTStringAddCR(pProf->m_bio);
 	LPTSTR note        = ConvertToTStringAddCR(pProf->m_note);
 	LPTSTR dscJoinedAt = ConvertCppStringToTString(pfx + (pProf->m_snowflake ? FormatDate(ExtractTimestamp(pProf->m_snowflake) / 1000) : ""));
-	LPTSTR gldJoinedAt = ConvertCppStringToTString((gm && gm->m_joinedAt) ? FormatDate(gm->m_joinedAt) : "");
+	LPTSTR gldJoinedAt = ConvertCppStringToTString((gm.IsValid() && gm.GetJoinedAt()) ? FormatDate(gm.GetJoinedAt()) : "");
 
 	// Get a HDC to measure the user information.
 	HDC hdc = GetDC(hWnd);
@@ -180,7 +178,7 @@ bool ProfilePopout::Layout(HWND hWnd, SIZE& fullSize)
 	fullSize.cx += windowBorder * 2;
 
 	// Now that we know the final width of the window, calculate the role stuff
-	if (gm && !gm->m_roles.empty() && gld)
+	if (gm.IsValid() && !gm.GetRoles().empty() && gld)
 	{
 		RoleList::InitializeClass();
 		RECT rcRolePos{};
@@ -189,7 +187,7 @@ bool ProfilePopout::Layout(HWND hWnd, SIZE& fullSize)
 		m_pRoleList = RoleList::Create(hWnd, &rcRolePos, IDC_ROLE_STATIC, false, false);
 
 		std::vector<GuildRole> grs;
-		for (Snowflake role : gm->m_roles) {
+		for (Snowflake role : gm.GetRoles()) {
 			grs.push_back(gld->m_roles[role]);
 		}
 		std::sort(grs.begin(), grs.end());
@@ -396,7 +394,7 @@ bool ProfilePopout::Layout(HWND hWnd, SIZE& fullSize)
 	}
 
 	// Add role list.
-	if (gm && !gm->m_roles.empty() && gld)
+	if (gm.IsValid() && !gm.GetRoles().empty() && gld)
 	{
 		hChild = GetDlgItem(hWnd, IDC_ROLE_GROUP);
 		ShowWindow(hChild, SW_SHOW);
@@ -470,7 +468,7 @@ void ProfilePopout::Paint(HWND hWnd, HDC hdc)
 
 void ProfilePopout::FlushNote()
 {
-	Profile* pProf = GetProfileCache()->LookupProfile(m_user, "...", "...", "");
+	Profile* pProf = GetProfileCache()->LookupProfile(m_user, "...", "...", "", false);
 	if (!pProf)
 		return;
 	if (!pProf->m_bNoteFetched) // note: might be redundant
@@ -535,6 +533,7 @@ INT_PTR CALLBACK ProfilePopout::Proc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
 				DeleteBitmap(hbm);
 
 			m_hwnd = NULL;
+			GetProfileCache()->UnpinProfile(m_user);
 			SAFE_DELETE(m_pRoleList);
 			SAFE_DELETE(m_pProfileView);
 
@@ -594,7 +593,12 @@ void ProfilePopout::DeferredShow(const ShowProfilePopoutParams& params)
 	m_user = user;
 	m_guild = guild;
 	m_size = { 10, 10 };
+	GetProfileCache()->PinProfile(user);
 	m_hwnd = CreateDialog(g_hInstance, MAKEINTRESOURCE(DMDI(IDD_DIALOG_PROFILE_POPOUT)), g_Hwnd, &Proc);
+	if (!m_hwnd) {
+		GetProfileCache()->UnpinProfile(user);
+		return;
+	}
 
 	// calculated in WM_CREATE
 	int wndWidth = m_size.cx;
@@ -122,12 +122,12 @@ void ShellNotification::ShowBalloonForOneNotification(Notification* pNotif)
 			channelName = pChan->GetTypeSymbol() + pChan->m_name;
 	}
 
-	std::string titleString = pNotif->m_author + (pNotif->m_bIsReply ? " replied" : " wrote");
+	std::string titleString = pNotif->m_pMessage->m_author + (pNotif->m_bIsReply ? " replied" : " wrote");
 	if (!channelName.empty())
 		titleString += " in " + channelName;
 	titleString += ":";
 
-	std::string contents = GetDiscordInstance()->ReverseMentions(pNotif->m_contents, pNotif->m_sourceGuild), contents2;
+	std::string contents = GetDiscordInstance()->ReverseMentions(pNotif->m_pMessage->m_message, pNotif->m_sourceGuild), contents2;
 	contents2.reserve(contents.size() * 2);
 
 	for (char c : contents) {
@@ -157,7 +157,7 @@ void ShellNotification::ShowBalloonForNotifications(const std::vector<Notificati
 	for (size_t i = 0; i < 5 && i < pNotifs.size(); i++)
 	{
 		Notification* pNotif = pNotifs[i];
-		std::string line = pNotif->m_author + ": " + GetDiscordInstance()->ReverseMentions(pNotif->m_contents, pNotif->m_sourceGuild);
+		std::string line = pNotif->m_pMessage->m_author + ": " + GetDiscordInstance()->ReverseMentions(pNotif->m_pMessage->m_message, pNotif->m_sourceGuild);
 
 		// remove new lines here
 		for (char& c : line) {
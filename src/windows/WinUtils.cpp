@@ -792,8 +792,12 @@ COLORREF GetNameColor(Profile* pf, Snowflake guild)
 	int winnerPos = -1;
 	COLORREF winnerCol = CLR_NONE;
 
+	GuildMember member = GetProfileCache()->FindGuildMember(pf->m_snowflake, guild);
+	if (!member.IsValid())
+		return CLR_NONE;
+
 	auto& gldroles = pGuild->m_roles;
-	auto& memroles = pf->m_guildMembers[guild].m_roles;
+	auto& memroles = member.GetRoles();
 	for (auto& role : memroles)
 	{
 		auto& gldrole = gldroles[role];
@@ -1657,40 +1661,6 @@ HBITMAP ResizeWithBackgroundColor(HDC hdc, HBITMAP hBitmap, HBRUSH backgroundCol
 	return newBitmap;
 }
 
-static time_t FileTimeToTimeT(LPFILETIME ft)
-{
-	ULARGE_INTEGER uli {};
-	uli.LowPart = ft->dwLowDateTime;
-	uli.HighPart = ft->dwHighDateTime;
-	auto lt = (uli.QuadPart - 116444736000000000LL) / 10000000LL;
-
-	assert(lt < 2000000000);
-	if (lt > 2147483647)
-		lt = 2147483647;
-
-	return (time_t) lt;
-}
-
-time_t MakeGMTime(const tm* ptime)
-{
-	SYSTEMTIME st { };
-	st.wYear      = ptime->tm_year ? (1900 + ptime->tm_year) : 0;
-	st.wMonth     = 1 + ptime->tm_mon;
-	st.wDay       = ptime->tm_mday;
-	st.wDayOfWeek = ptime->tm_wday;
-	st.wHour      = ptime->tm_hour;
-	st.wMinute    = ptime->tm_min;
-	st.wSecond    = ptime->tm_sec;
-
-	FILETIME ft { };
-	SystemTimeToFileTime(&st, &ft);
-
-	if (ft.dwHighDateTime == 0 && ft.dwLowDateTime == 0)
-		return 0;
-
-	return FileTimeToTimeT(&ft);
-}
-
 // N.B. WINVER<=0x0500 doesn't define it. We'll force it
 #ifndef IDC_HAND
 #define IDC_HAND            MAKEINTRESOURCE(32649)
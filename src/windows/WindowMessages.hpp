@@ -25,7 +25,7 @@ enum eWmUserMsgs
 	WM_IMAGESAVING,
 	WM_IMAGESAVED, // LPCTSTR in lParam
 	WM_IMAGECLEARSAVE,
-	WM_UPDATEMEMBERLIST,
+	WM_UPDATEMEMBERLIST, // UpdateMemberListParams, or NULL to rebuild
 	WM_LOGINAGAIN,
 	WM_LOGGEDOUT2,
 	WM_RECALCMSGLIST,
@@ -68,6 +68,7 @@ enum eWmUserMsgs
 	WM_CLOSEBYPASSTRAY,
 	WM_SETBROWSINGPAST,
 	WM_UPDATEAVAILABLE, // wparam=string*, lparam=string*
+	WM_SPLICEMEMBERLIST, // SpliceMemberListParams
 
 	WM_UPDATETEXTSIZE = WM_APP, // used by the MessageEditor
 	WM_RESTOREAPP,